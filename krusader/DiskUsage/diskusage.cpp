@@ -70,6 +70,7 @@
 #include "dulines.h"
 #include "dulistview.h"
 #include "dufilelight.h"
+#include "duscanner.h"
 
 // these are the values that will exist in the menu
 #define DELETE_ID            90
@@ -88,6 +89,7 @@
 #define ADDITIONAL_POPUP_ID 103
 
 #define MAX_FILENUM         100
+#define SCAN_POLL_TIME      100
 
 LoaderWidget::LoaderWidget(QWidget *parent) : QScrollArea(parent), cancelled(false)
 {
@@ -204,7 +206,7 @@ void LoaderWidget::slotCancelled()
 
 DiskUsage::DiskUsage(QString confGroup, QWidget *parent) : QStackedWidget(parent),
         currentDirectory(0), root(0), configGroup(confGroup), loading(false),
-        abortLoading(false), clearAfterAbort(false), deleting(false), searchVfs(0)
+        abortLoading(false), clearAfterAbort(false), deleting(false), scanner(0), searchVfs(0)
 {
     listView = new DUListView(this);
     lineView = new DULines(this);
@@ -232,6 +234,10 @@ DiskUsage::~DiskUsage()
     if (filelightView)
         delete filelightView;
 
+    // the threads of the scanner build into the tree
+    if (scanner)
+        delete scanner;
+
     if (root)
         delete root;
 
@@ -248,6 +254,11 @@ void DiskUsage::load(const QUrl &baseDir)
 
     emit status(i18n("Loading the disk usage information..."));
 
+    if (scanner) {
+        delete scanner;
+        scanner = 0;
+    }
+
     clear();
 
     baseURL = baseDir.adjusted(QUrl::StripTrailingSlash);
@@ -264,8 +275,12 @@ void DiskUsage::load(const QUrl &baseDir)
         delete searchVfs;
         searchVfs = 0;
     }
-    searchVfs = KrVfsHandler::instance().getVfs(baseDir);
-    if (searchVfs == 0) {
+    // local folders are read by the threads of the scanner, the others through the vfs
+    if (baseDir.isLocalFile())
+        scanner = new DUScanner(baseDir.toLocalFile(), root);
+    else
+        searchVfs = KrVfsHandler::instance().getVfs(baseDir);
+    if (scanner == 0 && searchVfs == 0) {
         krOut << "diskusage could not get VFS for directory " << baseDir;
         loading = abortLoading = clearAfterAbort = false;
         emit loadFinished(false);
@@ -285,13 +300,25 @@ void DiskUsage::load(const QUrl &baseDir)
     loaderView->setCurrentURL(baseURL);
     loaderView->setValues(fileNum, dirNum, currentSize);
 
+    if (scanner)
+        scanner->start();
+
     loadingTimer.setSingleShot(true);
     loadingTimer.start(0);
 }
 
 void DiskUsage::slotLoadDirectory()
 {
-    if ((currentVfile == 0 && directoryStack.isEmpty()) || loaderView->wasCancelled() || abortLoading) {
+    bool finished = scanner ? scanner->isFinished() : (currentVfile == 0 && directoryStack.isEmpty());
+    if (finished || loaderView->wasCancelled() || abortLoading) {
+        if (scanner) {
+            scanner->stop();
+            contentMap = scanner->contents();
+            fileNum = scanner->fileNum();
+            dirNum = scanner->dirNum();
+            delete scanner;
+            scanner = 0;
+        }
         if (searchVfs)
             delete searchVfs;
 
@@ -303,6 +330,7 @@ void DiskUsage::slotLoadDirectory()
         if (clearAfterAbort)
             clear();
         else {
+            root->countFiles();
             calculateSizes();
             changeDirectory(root);
         }
@@ -310,6 +338,11 @@ void DiskUsage::slotLoadDirectory()
         emit loadFinished(!(loaderView->wasCancelled() || abortLoading));
 
         loading = abortLoading = clearAfterAbort = false;
+    } else if (scanner) {
+        loaderView->setCurrentURL(QUrl::fromLocalFile(scanner->currentPath()));
+        loaderView->setValues(scanner->fileNum(), scanner->dirNum(), scanner->totalSize());
+        loadingTimer.setSingleShot(true);
+        loadingTimer.start(SCAN_POLL_TIME);
     } else if (loading) {
         for (int counter = 0; counter != MAX_FILENUM; counter ++) {
             if (currentVfile == 0) {
@@ -350,19 +383,21 @@ void DiskUsage::slotLoadDirectory()
                 File *newItem = 0;
 
                 QString mime = currentVfile->vfile_getMime(); // fast == not using mimetype magic
+                FileArena *arena = root->arena();
 
+                // the strings repeating in the tree share their data
                 if (currentVfile->vfile_isDir() && !currentVfile->vfile_isSymLink()) {
-                    newItem = new Directory(currentParent, currentVfile->vfile_getName(), dirToCheck, currentVfile->vfile_getSize(),
-                                            currentVfile->vfile_getMode(), currentVfile->vfile_getOwner(), currentVfile->vfile_getGroup(),
-                                            currentVfile->vfile_getPerm(), currentVfile->vfile_getTime_t(), currentVfile->vfile_isSymLink(),
-                                            mime);
+                    newItem = new(arena) Directory(currentParent, currentVfile->vfile_getName(), dirToCheck, currentVfile->vfile_getSize(),
+                                                   currentVfile->vfile_getMode(), arena->intern(currentVfile->vfile_getOwner()),
+                                                   arena->intern(currentVfile->vfile_getGroup()), arena->intern(currentVfile->vfile_getPerm()),
+                                                   currentVfile->vfile_getTime_t(), currentVfile->vfile_isSymLink(), arena->intern(mime));
                     directoryStack.push((dirToCheck.isEmpty() ? "" : dirToCheck + '/') + currentVfile->vfile_getName());
                     parentStack.push(dynamic_cast<Directory *>(newItem));
                 } else {
-                    newItem = new File(currentParent, currentVfile->vfile_getName(), dirToCheck, currentVfile->vfile_getSize(),
-                                       currentVfile->vfile_getMode(), currentVfile->vfile_getOwner(), currentVfile->vfile_getGroup(),
-                                       currentVfile->vfile_getPerm(), currentVfile->vfile_getTime_t(), currentVfile->vfile_isSymLink(),
-                                       mime);
+                    newItem = new(arena) File(currentParent, currentVfile->vfile_getName(), dirToCheck, currentVfile->vfile_getSize(),
+                                              currentVfile->vfile_getMode(), arena->intern(currentVfile->vfile_getOwner()),
+                                              arena->intern(currentVfile->vfile_getGroup()), arena->intern(currentVfile->vfile_getPerm()),
+                                              currentVfile->vfile_getTime_t(), currentVfile->vfile_isSymLink(), arena->intern(mime));
                     currentSize += currentVfile->vfile_getSize();
                 }
                 currentParent->append(newItem);
@@ -450,6 +485,11 @@ File * DiskUsage::getFile(QString path)
 
 void DiskUsage::clear()
 {
+    if (scanner) {
+        delete scanner;
+        scanner = 0;
+    }
+
     baseURL = QUrl();
     emit clearing();
 
@@ -606,9 +646,9 @@ int DiskUsage::del(File *file, bool calcPercents, int depth)
     if (file->isDir()) {
         Directory *dir = dynamic_cast<Directory *>(file);
 
-        Iterator<File> it;
-        while ((it = dir->iterator()) != dir->end())
-            deleteNr += del(*it, false, depth + 1);
+        // from the end, the children are stored in an array
+        while (!dir->isEmpty())
+            deleteNr += del(dir->last(), false, depth + 1);
 
         QString path;
         for (const Directory *d = (Directory*)file; d != root && d && d->parent() != 0; d = d->parent()) {
@@ -643,8 +683,7 @@ int DiskUsage::del(File *file, bool calcPercents, int depth)
     releaseKeyboard();
     deleting = false;
 
-    ((Directory *)(file->parent()))->remove(file);
-    delete file;
+    ((Directory *)(file->parent()))->erase(file);
 
     if (depth == 0)
         createStatus();
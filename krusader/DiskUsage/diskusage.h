@@ -64,6 +64,7 @@ class DULines;
 class DUFilelight;
 class QMenu;
 class LoaderWidget;
+class DUScanner;
 
 class DiskUsage : public QStackedWidget
 {
@@ -173,6 +174,7 @@ protected:
     QStack<QString> directoryStack;
     QStack<Directory *> parentStack;
 
+    DUScanner * scanner;
     vfs       * searchVfs;
     vfile     * currentVfile;
     QList<vfile *> vfiles;
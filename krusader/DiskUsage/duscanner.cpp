@@ -0,0 +1,385 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "duscanner.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+#include <qplatformdefs.h>
+// QtCore
+#include <QFile>
+#include <QMutexLocker>
+#include <QPair>
+
+#include "../VFS/krpermhandler.h"
+
+#define MAX_SCAN_THREADS    8
+// deeper folders are queued instead of being opened relative to their parents
+#define MAX_SCAN_DEPTH      64
+#define DIRENT_BUFFER_SIZE  65536
+
+#if defined(Q_OS_LINUX) && defined(SYS_getdents64)
+struct DirEntry64 {
+    quint64        d_ino;
+    qint64         d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1];
+};
+#endif
+
+static QByteArray childPath(const QByteArray &dir, const QByteArray &name)
+{
+    QByteArray path = dir;
+    if (!path.endsWith('/'))
+        path += '/';
+    return path + name;
+}
+
+// ------------------------------- DUScanner::Worker -------------------------------
+
+class DUScanner::Worker : public QThread
+{
+public:
+    explicit Worker(DUScanner *scanner) : _scanner(scanner) {}
+
+protected:
+    virtual void run() Q_DECL_OVERRIDE;
+
+private:
+    struct Listing {
+        Directory                             *dir;
+        QString                                relative;
+        QList<File *>                          items;
+        QList<QPair<QByteArray, Directory *> > subdirs;
+        KIO::filesize_t                        size;
+    };
+
+    void            scan(int parentFd, const QByteArray &name, const QByteArray &path, const QString &relative,
+                         Directory *dir, int depth);
+    void            readDirectory(int fd, Listing &listing);
+    void            addEntry(int fd, const char *name, Listing &listing);
+    const QString & ownerName(uid_t uid);
+    const QString & groupName(gid_t gid);
+    const QString & permString(mode_t mode);
+
+    DUScanner              *_scanner;
+    QByteArray              _buffer;
+    // the items are allocated without locking, the blocks are given to the tree at the end
+    FileArena               _arena;
+    // the names are shared by the items instead of being created for every file
+    QHash<uid_t, QString>   _owners;
+    QHash<gid_t, QString>   _groups;
+    QHash<mode_t, QString>  _perms;
+};
+
+void DUScanner::Worker::run()
+{
+    Task task;
+    while (_scanner->takeTask(task)) {
+        scan(AT_FDCWD, task.path, task.path, task.relative, task.dir, 0);
+        _scanner->taskDone();
+    }
+    _scanner->adoptArena(_arena);
+}
+
+void DUScanner::Worker::scan(int parentFd, const QByteArray &name, const QByteArray &path, const QString &relative,
+                             Directory *dir, int depth)
+{
+    if (_scanner->_stopped)
+        return;
+
+#ifdef BSD
+    if (path == "/procfs" || path.startsWith("/procfs/"))
+        return;
+#else
+    if (path == "/proc" || path.startsWith("/proc/"))
+        return;
+#endif
+
+    // the symbolic link of the loaded folder is followed, the links inside are not
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (parentFd != AT_FDCWD)
+        flags |= O_NOFOLLOW;
+    int fd = ::openat(parentFd, name.constData(), flags);
+    if (fd < 0)
+        return;
+
+    Listing listing;
+    listing.dir = dir;
+    listing.relative = relative;
+    listing.size = 0;
+    readDirectory(fd, listing);
+    _scanner->addContent(dir, relative, path, listing.items, listing.size);
+
+    for (int i = 0; i != listing.subdirs.count() && !_scanner->_stopped; i++) {
+        Task task;
+        task.path = childPath(path, listing.subdirs[ i ].first);
+        task.dir = listing.subdirs[ i ].second;
+        task.relative = relative.isEmpty() ? task.dir->name() : relative + '/' + task.dir->name();
+
+        if (_scanner->offerTask(task))
+            continue;
+        if (depth < MAX_SCAN_DEPTH)
+            scan(fd, listing.subdirs[ i ].first, task.path, task.relative, task.dir, depth + 1);
+        else
+            _scanner->addTask(task);
+    }
+
+    QT_CLOSE(fd);
+}
+
+void DUScanner::Worker::readDirectory(int fd, Listing &listing)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_getdents64)
+    if (_buffer.isEmpty())
+        _buffer.resize(DIRENT_BUFFER_SIZE);
+
+    while (!_scanner->_stopped) {
+        long bytes = syscall(SYS_getdents64, fd, _buffer.data(), _buffer.size());
+        if (bytes <= 0)
+            break;
+        for (long pos = 0; pos < bytes;) {
+            const DirEntry64 *entry = (const DirEntry64 *)(_buffer.constData() + pos);
+            addEntry(fd, entry->d_name, listing);
+            pos += entry->d_reclen;
+        }
+    }
+#else
+    int dirFd = dup(fd);
+    if (dirFd < 0)
+        return;
+    DIR *dir = fdopendir(dirFd);
+    if (!dir) {
+        QT_CLOSE(dirFd);
+        return;
+    }
+    struct dirent *entry;
+    while (!_scanner->_stopped && (entry = readdir(dir)) != 0)
+        addEntry(fd, entry->d_name, listing);
+    closedir(dir);
+#endif
+}
+
+void DUScanner::Worker::addEntry(int fd, const char *name, Listing &listing)
+{
+    if (name[ 0 ] == '.' && (name[ 1 ] == 0 || (name[ 1 ] == '.' && name[ 2 ] == 0)))
+        return;
+
+    struct stat stat_p;
+    if (::fstatat(fd, name, &stat_p, AT_SYMLINK_NOFOLLOW) != 0)
+        return;
+
+    QString fileName = QFile::decodeName(name);
+    if (S_ISDIR(stat_p.st_mode)) {
+        Directory *dir = new(&_arena) Directory(listing.dir, fileName, listing.relative, stat_p.st_size, stat_p.st_mode,
+                                                ownerName(stat_p.st_uid), groupName(stat_p.st_gid),
+                                                permString(stat_p.st_mode), stat_p.st_mtime, false,
+                                                QStringLiteral("inode/directory"));
+        listing.items.append(dir);
+        listing.subdirs.append(qMakePair(QByteArray(name), dir));
+    } else {
+        listing.items.append(new(&_arena) File(listing.dir, fileName, listing.relative, stat_p.st_size, stat_p.st_mode,
+                                               ownerName(stat_p.st_uid), groupName(stat_p.st_gid),
+                                               permString(stat_p.st_mode), stat_p.st_mtime, S_ISLNK(stat_p.st_mode),
+                                               QString()));
+        listing.size += stat_p.st_size;
+    }
+}
+
+const QString & DUScanner::Worker::ownerName(uid_t uid)
+{
+    QHash<uid_t, QString>::iterator it = _owners.find(uid);
+    if (it == _owners.end())
+        it = _owners.insert(uid, _scanner->ownerName(uid));
+    return *it;
+}
+
+const QString & DUScanner::Worker::groupName(gid_t gid)
+{
+    QHash<gid_t, QString>::iterator it = _groups.find(gid);
+    if (it == _groups.end())
+        it = _groups.insert(gid, _scanner->groupName(gid));
+    return *it;
+}
+
+const QString & DUScanner::Worker::permString(mode_t mode)
+{
+    QHash<mode_t, QString>::iterator it = _perms.find(mode);
+    if (it == _perms.end())
+        it = _perms.insert(mode, KRpermHandler::mode2QString(mode));
+    return *it;
+}
+
+// ------------------------------- DUScanner -------------------------------
+
+DUScanner::DUScanner(const QString &path, Directory *root) : _path(QFile::encodeName(path)), _root(root),
+        _idle(0), _active(0), _stopped(false), _fileNum(0), _dirNum(0), _totalSize(0)
+{
+}
+
+DUScanner::~DUScanner()
+{
+    stop();
+    qDeleteAll(_workers);
+}
+
+void DUScanner::start()
+{
+    Task task;
+    task.path = _path;
+    task.dir = _root;
+    _tasks.append(task);
+
+    int threads = qBound(1, QThread::idealThreadCount(), MAX_SCAN_THREADS);
+    for (int i = 0; i != threads; i++) {
+        Worker *worker = new Worker(this);
+        _workers.append(worker);
+        worker->start();
+    }
+}
+
+void DUScanner::stop()
+{
+    _stopped = true;
+    {
+        QMutexLocker locker(&_lock);
+        _wakeUp.wakeAll();
+    }
+    foreach(Worker *worker, _workers)
+        worker->wait();
+}
+
+bool DUScanner::isFinished()
+{
+    foreach(Worker *worker, _workers)
+        if (!worker->isFinished())
+            return false;
+    return true;
+}
+
+int DUScanner::fileNum()
+{
+    QMutexLocker locker(&_lock);
+    return _fileNum;
+}
+
+int DUScanner::dirNum()
+{
+    QMutexLocker locker(&_lock);
+    return _dirNum;
+}
+
+KIO::filesize_t DUScanner::totalSize()
+{
+    QMutexLocker locker(&_lock);
+    return _totalSize;
+}
+
+QString DUScanner::currentPath()
+{
+    QMutexLocker locker(&_lock);
+    return QFile::decodeName(_current);
+}
+
+QHash<QString, Directory *> DUScanner::contents()
+{
+    QMutexLocker locker(&_lock);
+    return _contents;
+}
+
+bool DUScanner::takeTask(Task &task)
+{
+    QMutexLocker locker(&_lock);
+    while (_tasks.isEmpty() && _active && !_stopped) {
+        _idle++;
+        _wakeUp.wait(&_lock);
+        _idle--;
+    }
+    if (_stopped || _tasks.isEmpty()) {
+        _wakeUp.wakeAll();
+        return false;
+    }
+    task = _tasks.takeLast();
+    _active++;
+    return true;
+}
+
+void DUScanner::taskDone()
+{
+    QMutexLocker locker(&_lock);
+    // the scan is over when no thread can produce new tasks
+    if (--_active == 0 && _tasks.isEmpty())
+        _wakeUp.wakeAll();
+}
+
+bool DUScanner::offerTask(const Task &task)
+{
+    QMutexLocker locker(&_lock);
+    if (_idle <= _tasks.count())
+        return false;
+    _tasks.append(task);
+    _wakeUp.wakeOne();
+    return true;
+}
+
+void DUScanner::addTask(const Task &task)
+{
+    QMutexLocker locker(&_lock);
+    _tasks.append(task);
+    _wakeUp.wakeOne();
+}
+
+void DUScanner::addContent(Directory *dir, const QString &relative, const QByteArray &path,
+                           const QList<File *> &items, KIO::filesize_t size)
+{
+    QMutexLocker locker(&_lock);
+    foreach(File *item, items)
+        dir->append(item);
+
+    _fileNum += items.count();
+    _dirNum++;
+    _totalSize += size;
+    _current = path;
+    _contents.insert(relative, dir);
+}
+
+void DUScanner::adoptArena(FileArena &arena)
+{
+    QMutexLocker locker(&_lock);
+    _root->arena()->adopt(arena);
+}
+
+QString DUScanner::ownerName(uid_t uid)
+{
+    // the caches of the permission handler are not meant for concurrent use
+    QMutexLocker locker(&_lock);
+    return KRpermHandler::uid2user(uid);
+}
+
+QString DUScanner::groupName(gid_t gid)
+{
+    QMutexLocker locker(&_lock);
+    return KRpermHandler::gid2group(gid);
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef DUSCANNER_H
+#define DUSCANNER_H
+
+// QtCore
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <sys/types.h>
+
+#include "filelightParts/fileTree.h"
+
+/**
+ * Reads the tree of a local folder for the disk usage with several threads.
+ *
+ * The folders are opened relative to their parents and listed with getdents64() where it is
+ * available, the entries are examined with fstatat(). The MIME types are not determined, the
+ * views guess them from the names when the files are shown. A thread descends into the
+ * subfolders of its folder itself until another thread becomes idle; then the subfolders are
+ * handed over to the idle threads.
+ *
+ * The Directory / File tree is built under the lock of the scanner, the GUI polls the progress
+ * and may only use the tree after isFinished() returned true or stop() returned.
+ */
+class DUScanner
+{
+public:
+    DUScanner(const QString &path, Directory *root);
+    ~DUScanner();
+
+    void            start();
+    void            stop();
+    bool            isFinished();
+
+    int             fileNum();
+    int             dirNum();
+    KIO::filesize_t totalSize();
+    QString         currentPath();
+    /// the folders of the tree by their path relative to the root
+    QHash<QString, Directory *> contents();
+
+private:
+    struct Task {
+        QByteArray  path;
+        QString     relative;
+        Directory  *dir;
+    };
+
+    class Worker;
+    friend class Worker;
+
+    bool            takeTask(Task &task);
+    void            taskDone();
+    bool            offerTask(const Task &task);
+    void            addTask(const Task &task);
+    void            adoptArena(FileArena &arena);
+    void            addContent(Directory *dir, const QString &relative, const QByteArray &path,
+                               const QList<File *> &items, KIO::filesize_t size);
+    QString         ownerName(uid_t uid);
+    QString         groupName(gid_t gid);
+
+    QByteArray      _path;
+    Directory      *_root;
+    QList<Worker *> _workers;
+
+    QMutex          _lock;
+    QWaitCondition  _wakeUp;
+    QList<Task>     _tasks;
+    int             _idle;
+    int             _active;
+    volatile bool   _stopped;
+
+    int             _fileNum;
+    int             _dirNum;
+    KIO::filesize_t _totalSize;
+    QByteArray      _current;
+    QHash<QString, Directory *> _contents;
+};
+
+#endif /* DUSCANNER_H */
@@ -20,6 +20,7 @@
 
 // QtCore
 #include <QLocale>
+#include <QMimeDatabase>
 #include <QString>
 
 //static definitions
@@ -54,6 +55,61 @@ File::fullPath(const Directory *root /*= 0*/) const
         return path;
 }
 
+Directory::~Directory()
+{
+    // the items live in the arena of the root, only their destructors are called
+    foreach(File *item, m_children)
+        item->~File();
+    delete m_arena;
+}
+
+void
+Directory::remove(File *p)
+{
+    // the items are usually removed from the end (see DiskUsage::del())
+    for (int i = m_children.count() - 1; i >= 0; --i)
+        if (m_children[ i ] == p) {
+            m_children.remove(i);
+
+            uint removed = p->isDir() ? static_cast<Directory *>(p)->m_fileCount + 1 : 1;
+            for (Directory *dir = this; dir; dir = dir->m_parent)
+                dir->m_fileCount -= removed;
+            break;
+        }
+}
+
+void
+Directory::erase(File *p)
+{
+    remove(p);
+    p->~File();
+}
+
+uint
+Directory::countFiles()
+{
+    uint count = 0;
+    foreach(File *item, m_children) {
+        count++;
+        if (item->isDir())
+            count += static_cast<Directory *>(item)->countFiles();
+    }
+    m_children.squeeze();
+    return m_fileCount = count;
+}
+
+QString
+File::mimeFromName() const
+{
+    // the disk usage scanner doesn't look into the files
+    if (isDir())
+        return QString("inode/directory");
+
+    QMimeDatabase db;
+    QList<QMimeType> types = db.mimeTypesForFileName(m_name);
+    return types.isEmpty() ? QString("application/octet-stream") : types.first().name();
+}
+
 QString
 File::humanReadableSize(UnitPrefix key /*= mega*/) const   //FIXME inline
 {
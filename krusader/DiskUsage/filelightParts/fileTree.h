@@ -19,7 +19,10 @@
 #ifndef FILETREE_H
 #define FILETREE_H
 
+#include <QList>
+#include <QSet>
 #include <QString>
+#include <QVector>
 
 #include <KIO/Global>
 
@@ -209,6 +212,63 @@ private:
 
 class Directory;
 
+/**
+ * Allocates the items of a tree in large blocks and shares their equal strings.
+ * The memory is only released with the arena, which belongs to the root directory;
+ * the items are destructed by their directories.
+ */
+class FileArena
+{
+public:
+    FileArena() : m_used(BLOCK_SIZE) {}
+    ~FileArena() {
+        foreach(char *block, m_blocks)
+            ::operator delete(block);
+    }
+
+    inline void *allocate(size_t size) {
+        size = (size + 7) & ~(size_t)7;
+        if (m_used + size > BLOCK_SIZE) {
+            m_blocks.append((char *)::operator new(BLOCK_SIZE));
+            m_used = 0;
+        }
+        void *item = m_blocks.last() + m_used;
+        m_used += size;
+        return item;
+    }
+
+    /// takes over the blocks of an arena filled by another thread
+    void adopt(FileArena &other) {
+        if (other.m_blocks.isEmpty())
+            return;
+        // the adopted blocks go before the current one, allocate() keeps filling the last block
+        char *current = m_blocks.isEmpty() ? 0 : m_blocks.takeLast();
+        m_blocks += other.m_blocks;
+        if (current)
+            m_blocks.append(current);
+        else
+            m_used = BLOCK_SIZE;
+        Q_ASSERT(m_used == BLOCK_SIZE || m_blocks.last() == current);
+        other.m_blocks.clear();
+        other.m_used = BLOCK_SIZE;
+    }
+
+    /// returns a string sharing the data of an equal one interned before
+    QString intern(const QString &str) {
+        return *m_strings.insert(str);
+    }
+
+private:
+    FileArena(const FileArena &);
+    FileArena &operator=(const FileArena &);
+
+    enum { BLOCK_SIZE = 65536 };
+
+    QList<char *>     m_blocks;
+    size_t            m_used;
+    QSet<QString>     m_strings;
+};
+
 class File
 {
 protected:
@@ -217,32 +277,44 @@ protected:
     QString           m_directory;//< the directory of the file
     FileSize          m_size;     //< size with subdirectories
     FileSize          m_ownSize;  //< size without subdirectories
-    mode_t            m_mode;     //< file mode
     QString           m_owner;    //< file owner name
     QString           m_group;    //< file group name
     QString           m_perm;     //< file permissions string
+    mutable QString   m_mimeType; //< file mimetype, guessed from the name when it is null
     time_t            m_time;     //< file modification in time_t format
+    mode_t            m_mode;     //< file mode
+    int               m_percent;  //< percent flag
     bool              m_symLink;  //< true if the file is a symlink
-    QString           m_mimeType; //< file mimetype
     bool              m_excluded; //< flag if the file is excluded from du
-    int               m_percent;  //< percent flag
 
 public:
     File(Directory *parentIn, const QString &nameIn, const QString &dir, FileSize sizeIn, mode_t modeIn,
          const QString &ownerIn, const QString &groupIn, const QString &permIn, time_t timeIn, bool symLinkIn,
          const QString &mimeTypeIn)
-            : m_parent(parentIn), m_name(nameIn), m_directory(dir), m_size(sizeIn), m_ownSize(sizeIn), m_mode(modeIn),
-            m_owner(ownerIn), m_group(groupIn), m_perm(permIn), m_time(timeIn), m_symLink(symLinkIn),
-            m_mimeType(mimeTypeIn), m_excluded(false), m_percent(-1) {}
+            : m_parent(parentIn), m_name(nameIn), m_directory(dir), m_size(sizeIn), m_ownSize(sizeIn),
+            m_owner(ownerIn), m_group(groupIn), m_perm(permIn), m_mimeType(mimeTypeIn), m_time(timeIn),
+            m_mode(modeIn), m_percent(-1), m_symLink(symLinkIn), m_excluded(false) {}
 
     File(const QString &nameIn, FileSize sizeIn)
-            : m_parent(0), m_name(nameIn), m_directory(QString()), m_size(sizeIn), m_ownSize(sizeIn), m_mode(0),
-            m_owner(QString()), m_group(QString()), m_perm(QString()), m_time(-1),
-            m_symLink(false), m_mimeType(QString()), m_excluded(false), m_percent(-1) {
+            : m_parent(0), m_name(nameIn), m_directory(QString()), m_size(sizeIn), m_ownSize(sizeIn),
+            m_owner(QString()), m_group(QString()), m_perm(QString()), m_mimeType(QString()), m_time(-1),
+            m_mode(0), m_percent(-1), m_symLink(false), m_excluded(false) {
     }
 
     virtual ~File() {}
 
+    // the items of a directory tree are placed into its arena: new (arena) File(...)
+    static void *operator new(size_t size, FileArena *arena) {
+        return arena->allocate(size);
+    }
+    static void operator delete(void *, FileArena *) {}
+    static void *operator new(size_t size) {
+        return ::operator new(size);
+    }
+    static void operator delete(void *item) {
+        ::operator delete(item);
+    }
+
     inline const QString &  name()                const  {
         return m_name;
     }
@@ -271,6 +343,8 @@ public:
         return m_time;
     }
     inline const QString &  mime()                const  {
+        if (m_mimeType.isNull())
+            m_mimeType = mimeFromName();
         return m_mimeType;
     }
     inline bool             isSymLink()           const  {
@@ -313,6 +387,7 @@ public:
     static const char PREFIX[5][2];
 
     QString fullPath(const Directory* = 0) const;
+    QString mimeFromName() const;
     QString humanReadableSize(UnitPrefix key = mega) const;
 
     static QString humanReadableSize(FileSize size, UnitPrefix Key = mega);
@@ -321,63 +396,122 @@ public:
 };
 
 
-//TODO when you modify this to take into account hardlinks you should make the Chain layered not inherited
-class Directory : public Chain<File>, public File
+// the children of a directory are stored in an array, these iterators walk it
+template <>
+class Iterator<File>
+{
+public:
+    Iterator() : pos(0) { }
+    Iterator(File * const *p) : pos(p) { }
+
+    bool operator==(const Iterator<File>& it) const {
+        return pos == it.pos;
+    }
+    bool operator!=(const Iterator<File>& it) const {
+        return pos != it.pos;
+    }
+    bool operator!=(File * const *p) const {
+        return pos != p;
+    }
+
+    File* operator*() const {
+        return *pos;
+    }
+
+    Iterator<File>& operator++() {
+        ++pos; return *this;
+    }
+
+private:
+    File * const *pos;
+};
+
+template <>
+class ConstIterator<File>
+{
+public:
+    ConstIterator(File * const *p) : pos(p) { }
+
+    bool operator!=(File * const *p) const {
+        return pos != p;
+    }
+
+    const File* operator*() const {
+        return *pos;
+    }
+
+    ConstIterator<File>& operator++() {
+        ++pos; return *this;
+    }
+
+private:
+    File * const *pos;
+};
+
+
+class Directory : public File
 {
 public:
     Directory(Directory *parentIn, const QString &nameIn, const QString &dir, FileSize sizeIn, mode_t modeIn,
               const QString &ownerIn, const QString &groupIn, const QString &permIn, time_t timeIn, bool symLinkIn,
               const QString &mimeTypeIn)
             : File(parentIn, nameIn, dir, sizeIn, modeIn, ownerIn, groupIn, permIn, timeIn, symLinkIn, mimeTypeIn),
-            m_fileCount(0) {}
+            m_fileCount(0), m_arena(0) {}
 
-    Directory(const QString &name, QString url) : File(name, 0), m_fileCount(0) {
+    // the root of a tree, it owns the arena of the items
+    Directory(const QString &name, QString url) : File(name, 0), m_fileCount(0), m_arena(new FileArena) {
         m_directory = url;
     }
 
-    virtual ~Directory() {}
+    virtual ~Directory();
     virtual bool            isDir()               const  {
         return true;
     }
 
-    void append(File *p) {
-        ++m_fileCount;
-
-        Directory *parent = m_parent;
-        while (parent) {
-            parent->m_fileCount++;
-            parent = parent->m_parent;
-        }
+    Iterator<File>      iterator() const {
+        return Iterator<File>(m_children.constData());
+    }
+    ConstIterator<File> constIterator() const {
+        return ConstIterator<File>(m_children.constData());
+    }
+    File * const       *end() const {
+        return m_children.constData() + m_children.count();
+    }
+    bool                isEmpty() const {
+        return m_children.isEmpty();
+    }
+    File               *last() const {
+        return m_children.last();
+    }
 
-        Chain<File>::append(p);
+    /// the file counts are summed by countFiles() when the tree is complete
+    void append(File *p) {
+        m_children.append(p);
         p->m_parent = this;
     }
 
-    void remove(File *p) {
-        for (Iterator<File> it = Chain<File>::iterator(); it != Chain<File>::end(); ++it)
-            if ((*it) == p) {
-                --m_fileCount;
-
-                Directory *parent = m_parent;
-                while (parent) {
-                    parent->m_fileCount--;
-                    parent = parent->m_parent;
-                }
-
-                it.remove();
-                break;
-            }
-    }
+    /// takes the item out of the directory, it is not destructed
+    void remove(File *p);
+    /// removes the item and destructs it
+    void erase(File *p);
 
+    /// sums the file counts of the subtree in one post-order pass
+    uint countFiles();
     uint fileCount() const {
         return m_fileCount;
     }
 
+    FileArena *arena() const {
+        return m_arena;
+    }
+
 private:
     Directory(const Directory&);
     void operator=(const Directory&);
 
+    QVector<File *> m_children;
     uint m_fileCount;
+    FileArena *m_arena;
 };
 
 #endif
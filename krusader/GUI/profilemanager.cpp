@@ -191,3 +191,16 @@ QStringList ProfileManager::availableProfiles(QString profileType)
     return profileNames;
 }
 
+QString ProfileManager::profileGroup(QString profileType, QString name)
+{
+    KConfigGroup group(krConfig, "Private");
+    QStringList profiles = group.readEntry(profileType, QStringList());
+
+    for (int i = 0; i != profiles.count() ; i++) {
+        KConfigGroup pg(krConfig, profileType + " - " + profiles[ i ]);
+        if (pg.readEntry("Name") == name)
+            return profileType + " - " + profiles[ i ];
+    }
+
+    return QString();
+}
@@ -49,6 +49,13 @@ public:
      */
     static QStringList availableProfiles(QString profileType);
 
+    /**
+     * @param profileType Type of the profile (sync, search, ...)
+     * @param name The name of the profile
+     * @return The config group of the profile or a null string if there is no such profile
+     */
+    static QString profileGroup(QString profileType, QString name);
+
     QStringList getNames();
 
 public slots:
@@ -30,8 +30,11 @@
 
 #include "lister.h"
 
+#include <string.h>
+
 // QtCore
 #include <QFile>
+#include <QFileInfo>
 #include <QRect>
 #include <QDate>
 #include <QTemporaryFile>
@@ -61,7 +64,9 @@
 #include <QPrinter>
 
 #include <KCodecs/KCharsets>
+#include <KCodecs/KEncodingProber>
 #include <KConfigCore/KSharedConfig>
+#include <KCoreAddons/KDirWatch>
 #include <KCoreAddons/KJobTrackerInterface>
 #include <KI18n/KLocalizedString>
 #include <KIO/CopyJob>
@@ -70,17 +75,80 @@
 #include <KWidgetsAddons/KMessageBox>
 #include <KXmlGui/KActionCollection>
 
+#include "listercopyjob.h"
 #include "../krglobal.h"
 #include "../kractions.h"
 #include "../GUI/krremoteencodingmenu.h"
 
 #define  SEARCH_CACHE_CHARS 100000
 #define  SEARCH_MAX_ROW_LEN 4000
+#define  SEARCH_POLL_TIME   100
 #define  CONTROL_CHAR       752
-#define  CACHE_SIZE         100000
+#define  ENCODING_SAMPLE    65536
+
+// the length of the encoded character at data, code is its value if it is an ASCII character
+static inline int encodedCharLength(Lister::ByteLayout layout, const unsigned char * data, int size, int &code)
+{
+    switch (layout) {
+    case Lister::LayoutUtf8: {
+        unsigned char c = data[ 0 ];
+        code = c < 0x80 ? c : -1;
+        int length = c < 0xC2 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF5 ? 4 : 1;
+        if (length > size)
+            return 1;
+        for (int i = 1; i < length; i++)
+            if ((data[ i ] & 0xC0) != 0x80)
+                return 1;   // invalid sequences are shown byte by byte, like the decoder does
+        return length;
+    }
+    case Lister::LayoutUtf16LE:
+    case Lister::LayoutUtf16BE: {
+        code = -1;
+        if (size < 2)
+            return size;
+        bool le = (layout == Lister::LayoutUtf16LE);
+        ushort unit = le ? (data[ 0 ] | (data[ 1 ] << 8)) : ((data[ 0 ] << 8) | data[ 1 ]);
+        if (unit < 0x80)
+            code = unit;
+        else if (unit >= 0xD800 && unit < 0xDC00 && size >= 4) {
+            ushort low = le ? (data[ 2 ] | (data[ 3 ] << 8)) : ((data[ 2 ] << 8) | data[ 3 ]);
+            if (low >= 0xDC00 && low < 0xE000)
+                return 4;
+        }
+        return 2;
+    }
+    default:
+        code = data[ 0 ] < 0x80 ? data[ 0 ] : -1;
+        return 1;
+    }
+}
+
+// the decoder drops the byte order mark at the beginning of the file
+static int byteOrderMarkLength(Lister::ByteLayout layout, const unsigned char * data, int size)
+{
+    if (layout == Lister::LayoutUtf8 && size >= 3 && data[ 0 ] == 0xEF && data[ 1 ] == 0xBB && data[ 2 ] == 0xBF)
+        return 3;
+    if (layout == Lister::LayoutUtf16LE && size >= 2 && data[ 0 ] == 0xFF && data[ 1 ] == 0xFE)
+        return 2;
+    if (layout == Lister::LayoutUtf16BE && size >= 2 && data[ 0 ] == 0xFE && data[ 1 ] == 0xFF)
+        return 2;
+    return 0;
+}
+
+static QString decodeRow(QTextCodec * codec, const char * data, int size, QChar control)
+{
+    QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+    QString row = codec->toUnicode(data, size, &state);
+    QChar * chars = row.data();
+    for (int i = 0; i != row.length(); i++)
+        if (chars[ i ].unicode() < 32 && chars[ i ] != QChar('\t'))
+            chars[ i ] = control;
+    return row;
+}
 
 ListerTextArea::ListerTextArea(Lister *lister, QWidget *parent) : KTextEdit(parent), _lister(lister),
-        _sizeX(-1), _sizeY(-1), _cursorAnchorPos(-1), _inSliderOp(false), _inCursorUpdate(false), _hexMode(false)
+        _lastPageStartPos(0), _lastPageUnits(0), _scrollByLines(false), _sizeX(-1), _sizeY(-1), _cursorAnchorPos(-1),
+        _inSliderOp(false), _inCursorUpdate(false), _hexMode(false)
 {
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(slotCursorPositionChanged()));
     _tabWidth = 4;
@@ -121,10 +189,25 @@ void ListerTextArea::sizeChanged()
         _cursorAnchorPos = -1;
     if (_cursorPos > _lister->fileSize())
         _cursorPos = _lister->fileSize();
+    if (_screenStartPos > _lister->fileSize())
+        _screenStartPos = 0;
 
     redrawTextArea(true);
 }
 
+void ListerTextArea::lineIndexChanged()
+{
+    setUpScrollBar();
+    slotActionTriggered(QAbstractSlider::SliderNoAction);
+}
+
+void ListerTextArea::scrollToEnd()
+{
+    _cursorAnchorPos = -1;
+    slotActionTriggered(QAbstractSlider::SliderToMaximum);
+    setCursorPosition(_lister->fileSize(), true);
+}
+
 void ListerTextArea::resizeEvent(QResizeEvent * event)
 {
     KTextEdit::resizeEvent(event);
@@ -199,7 +282,7 @@ qint64 ListerTextArea::textToFilePosition(int x, int y, bool &isfirst)
 
     // we can't use fromUnicode because of the invalid encoded chars
     int maxBytes = 2 * _sizeX * MAX_CHAR_LENGTH;
-    char * cache = _lister->cacheRef(rowStart, maxBytes);
+    const char * cache = _lister->cacheRef(rowStart, maxBytes);
     QByteArray cachedBuffer(cache, maxBytes);
 
     QTextStream stream(&cachedBuffer);
@@ -234,7 +317,7 @@ void ListerTextArea::fileToTextPosition(qint64 p, bool isfirst, int &x, int &y)
         if (rowStart >= p) {
             if ((rowStart == p) && !isfirst && y > 0) {
                 qint64 previousRow = _rowStarts[ y - 1 ];
-                char * cache = _lister->cacheRef(previousRow, maxBytes);
+                const char * cache = _lister->cacheRef(previousRow, maxBytes);
                 QByteArray cachedBuffer(cache, p - previousRow);
 
                 QTextStream stream(&cachedBuffer);
@@ -248,7 +331,7 @@ void ListerTextArea::fileToTextPosition(qint64 p, bool isfirst, int &x, int &y)
             return;
         }
 
-        char * cache = _lister->cacheRef(rowStart, maxBytes);
+        const char * cache = _lister->cacheRef(rowStart, maxBytes);
         QByteArray cachedBuffer(cache, p - rowStart);
 
         QString res = codec()->toUnicode(cachedBuffer);
@@ -416,7 +499,7 @@ QString ListerTextArea::readSection(qint64 p1, qint64 p2)
         int maxBytes = _sizeX * _sizeY * MAX_CHAR_LENGTH;
         if (maxBytes > (p2 - pos))
             maxBytes = (int)(p2 - pos);
-        char * cache = _lister->cacheRef(pos, maxBytes);
+        const char * cache = _lister->cacheRef(pos, maxBytes);
         if (cache == 0 || maxBytes == 0)
             break;
         section += decoder->toUnicode(cache, maxBytes);
@@ -451,11 +534,14 @@ QStringList ListerTextArea::readLines(qint64 filePos, qint64 &endPos, int lines,
     }
 
     int maxBytes = _sizeX * _sizeY * MAX_CHAR_LENGTH;
-    char * cache = _lister->cacheRef(filePos, maxBytes);
+    const char * cache = _lister->cacheRef(filePos, maxBytes);
     if (cache == 0 || maxBytes == 0)
         return list;
 
     QTextCodec * textCodec = codec();
+    if (_lister->byteLayout(textCodec) != Lister::LayoutNone)
+        return readEncodedLines(textCodec, cache, maxBytes, filePos, endPos, lines, locs);
+
     QTextDecoder * decoder = textCodec->makeDecoder();
 
     int cnt = 0;
@@ -524,11 +610,79 @@ QStringList ListerTextArea::readLines(qint64 filePos, qint64 &endPos, int lines,
     return list;
 }
 
+QStringList ListerTextArea::readEncodedLines(QTextCodec * textCodec, const char * cache, int maxBytes, qint64 filePos,
+                                             qint64 &endPos, int lines, QList<qint64> * locs)
+{
+    // the line breaks are found in the encoded bytes, every row is decoded at once
+    Lister::ByteLayout layout = _lister->byteLayout(textCodec);
+    const unsigned char * data = (const unsigned char *)cache;
+    QStringList list;
+
+    int cnt = (filePos == 0) ? byteOrderMarkLength(layout, data, maxBytes) : 0;
+    int rowStart = cnt;
+    int y = 0;
+    int effLength = 0;
+    if (locs)
+        (*locs) << filePos;
+    bool isLastLongLine = false;
+    while (cnt < maxBytes && y < lines) {
+        int lastCnt = cnt;
+        int code;
+        cnt += encodedCharLength(layout, data + cnt, maxBytes - cnt, code);
+        if (code == '\n') {
+            if (!isLastLongLine) {
+                list << decodeRow(textCodec, cache + rowStart, lastCnt - rowStart, QChar(CONTROL_CHAR));
+                effLength = 0;
+                y++;
+                if (locs)
+                    (*locs) << filePos + cnt;
+            }
+            rowStart = cnt;
+            isLastLongLine = false;
+        } else {
+            isLastLongLine = false;
+            if (code == '\t') {
+                effLength += _tabWidth - (effLength % _tabWidth) - 1;
+                if (effLength > _sizeX) {
+                    list << decodeRow(textCodec, cache + rowStart, lastCnt - rowStart, QChar(CONTROL_CHAR));
+                    rowStart = lastCnt;
+                    effLength = 0;
+                    y++;
+                    if (locs)
+                        (*locs) << filePos + lastCnt;
+                }
+            }
+            effLength++;
+            if (effLength >= _sizeX) {
+                list << decodeRow(textCodec, cache + rowStart, cnt - rowStart, QChar(CONTROL_CHAR));
+                rowStart = cnt;
+                effLength = 0;
+                y++;
+                if (locs)
+                    (*locs) << filePos + cnt;
+                isLastLongLine = true;
+            }
+        }
+    }
+
+    if (y < lines)
+        list << decodeRow(textCodec, cache + rowStart, cnt - rowStart, QChar(CONTROL_CHAR));
+
+    if (locs) {
+        while (locs->count() > lines) {
+            locs->removeLast();
+        }
+    }
+
+    endPos = filePos + cnt;
+    return list;
+}
+
 QTextCodec * ListerTextArea::codec()
 {
     QString cs = _lister->characterSet();
     if (cs.isEmpty())
-        return QTextCodec::codecForLocale();
+        return _lister->detectedCodec();
     else
         return KCharsets::charsets()->codecForName(cs);
 }
@@ -540,6 +694,8 @@ void ListerTextArea::setUpScrollBar()
         _lister->scrollBar()->setMaximum(0);
         _lister->scrollBar()->hide();
         _lastPageStartPos = 0;
+        _lastPageUnits = 0;
+        _scrollByLines = false;
     } else {
         int maxPage = MAX_CHAR_LENGTH * _sizeX * _sizeY;
         qint64 pageStartPos = _lister->fileSize() - maxPage;
@@ -553,8 +709,13 @@ void ListerTextArea::setUpScrollBar()
             readLines(pageStartPos, _lastPageStartPos, list.count() - _sizeY);
         }
 
-        int maximum = (_lastPageStartPos > SLIDER_MAX) ? SLIDER_MAX : _lastPageStartPos;
-        int pageSize = (_lastPageStartPos > SLIDER_MAX) ? SLIDER_MAX * _averagePageSize / _lastPageStartPos : _averagePageSize;
+        // once every line is indexed the slider moves by lines instead of bytes
+        _scrollByLines = _lister->isLineIndexComplete();
+        _lastPageUnits = scrollUnits(_lastPageStartPos);
+        qint64 pageUnits = _scrollByLines ? _sizeY : _averagePageSize;
+
+        int maximum = (_lastPageUnits > SLIDER_MAX) ? SLIDER_MAX : _lastPageUnits;
+        int pageSize = (_lastPageUnits > SLIDER_MAX) ? SLIDER_MAX * pageUnits / _lastPageUnits : pageUnits;
         if (pageSize == 0)
             pageSize++;
 
@@ -564,6 +725,16 @@ void ListerTextArea::setUpScrollBar()
     }
 }
 
+qint64 ListerTextArea::scrollUnits(qint64 pos)
+{
+    if (_scrollByLines) {
+        qint64 line = _lister->lineOfPosition(pos);
+        if (line >= 0)
+            return line;
+    }
+    return pos;
+}
+
 void ListerTextArea::keyPressEvent(QKeyEvent * ke)
 {
     if (KrGlobal::copyShortcut == QKeySequence(ke->key() | ke->modifiers())) {
@@ -669,6 +840,10 @@ void ListerTextArea::keyPressEvent(QKeyEvent * ke)
             ke->accept();
             _lister->jumpToPosition();
             return;
+        case Qt::Key_L:
+            ke->accept();
+            _lister->jumpToLine();
+            return;
         case Qt::Key_F:
             ke->accept();
             _lister->enableSearch(true);
@@ -804,7 +979,7 @@ void ListerTextArea::slotActionTriggered(int action)
                 readPos = 0;
             maxSize = _screenStartPos - readPos;
 
-            char * cache = _lister->cacheRef(readPos, maxSize);
+            const char * cache = _lister->cacheRef(readPos, maxSize);
             QByteArray backBuffer(cache, maxSize);
 
             int from = maxSize;
@@ -877,7 +1052,7 @@ void ListerTextArea::slotActionTriggered(int action)
                 readPos = 0;
             maxSize = _screenStartPos - readPos;
 
-            char * cache = _lister->cacheRef(readPos, maxSize);
+            const char * cache = _lister->cacheRef(readPos, maxSize);
             QByteArray backBuffer(cache, maxSize);
 
             int sizeY = _sizeY + 1;
@@ -949,10 +1124,14 @@ void ListerTextArea::slotActionTriggered(int action)
             break;
         }
 
-        if (_lastPageStartPos > SLIDER_MAX)
-            pos = _lastPageStartPos * pos / SLIDER_MAX;
+        if (_lastPageUnits > SLIDER_MAX)
+            pos = _lastPageUnits * pos / SLIDER_MAX;
 
-        if (pos != 0) {
+        if (_scrollByLines) {
+            pos = _lister->positionOfLine(pos);
+            if (pos < 0 || pos > _lastPageStartPos)
+                pos = _lastPageStartPos;
+        } else if (pos != 0) {
             if (_hexMode) {
                 int bytesPerRow = _lister->hexBytesPerLine(_sizeX);
                 pos = (pos / bytesPerRow) * bytesPerRow;
@@ -980,7 +1159,8 @@ void ListerTextArea::slotActionTriggered(int action)
     };
 
     _inSliderOp = true;
-    int value = (_lastPageStartPos > SLIDER_MAX) ? SLIDER_MAX * _screenStartPos / _lastPageStartPos : _screenStartPos;
+    qint64 units = scrollUnits(_screenStartPos);
+    int value = (_lastPageUnits > SLIDER_MAX) ? SLIDER_MAX * units / _lastPageUnits : units;
     _lister->scrollBar()->setSliderPosition(value);
     _inSliderOp = false;
 
@@ -1176,8 +1356,10 @@ protected:
     Lister * _lister;
 };
 
-Lister::Lister(QWidget *parent) : KParts::ReadOnlyPart(parent), _searchInProgress(false), _cache(0), _active(false), _searchLastFailedPosition(-1),
-        _searchProgressCounter(0), _tempFile(0), _downloading(false)
+Lister::Lister(QWidget *parent) : KParts::ReadOnlyPart(parent), _searchInProgress(false), _lineIndexComplete(false), _active(false),
+        _searchLastFailedPosition(-1), _searchProgressCounter(0), _tempFile(0), _downloading(false),
+        _hexDigitsFileSize(-1), _hexPositionDigits(8), _hexColumns(-1), _hexColumnsDigits(0), _hexBytesPerRow(8),
+        _detectedCodec(0), _detectedSampleSize(-1), _layoutCodec(0), _layout(LayoutNone)
 {
     setXMLFile("krusaderlisterui.rc");
 
@@ -1214,11 +1396,26 @@ Lister::Lister(QWidget *parent) : KParts::ReadOnlyPart(parent), _searchInProgres
     actionCollection()->addAction("jump_to_position", _actionJumpToPosition);
     actionCollection()->setDefaultShortcut(_actionJumpToPosition, Qt::CTRL + Qt::Key_G);
 
+    _actionJumpToLine = new QAction(QIcon::fromTheme("go-jump"), i18n("Jump to line"), this);
+    connect(_actionJumpToLine, SIGNAL(triggered(bool)), SLOT(jumpToLine()));
+    actionCollection()->addAction("jump_to_line", _actionJumpToLine);
+    actionCollection()->setDefaultShortcut(_actionJumpToLine, Qt::CTRL + Qt::Key_L);
+
     _actionHexMode = new QAction(QIcon::fromTheme("document-preview"), i18n("Hex mode"), this);
     connect(_actionHexMode, SIGNAL(triggered(bool)), SLOT(toggleHexMode()));
     actionCollection()->addAction("hex_mode", _actionHexMode);
     actionCollection()->setDefaultShortcut(_actionHexMode, Qt::CTRL + Qt::Key_H);
 
+    _actionFollow = new QAction(QIcon::fromTheme("go-bottom"), i18n("Follow file end"), this);
+    _actionFollow->setCheckable(true);
+    connect(_actionFollow, SIGNAL(triggered(bool)), SLOT(toggleFollow()));
+    actionCollection()->addAction("follow", _actionFollow);
+    actionCollection()->setDefaultShortcut(_actionFollow, Qt::CTRL + Qt::Key_T);
+
+    _watcher = new KDirWatch(this);
+    connect(_watcher, SIGNAL(dirty(const QString &)), this, SLOT(slotFileChanged(const QString &)));
+    connect(_watcher, SIGNAL(created(const QString &)), this, SLOT(slotFileChanged(const QString &)));
+
     _actionEncoding = new ListerEncodingMenu(this, i18n("Select charset"), "character-set", actionCollection());
 
     QWidget * widget = new ListerPane(this, parent);
@@ -1301,6 +1498,8 @@ Lister::Lister(QWidget *parent) : KParts::ReadOnlyPart(parent), _searchInProgres
 
     connect(_scrollBar, SIGNAL(actionTriggered(int)), _textArea, SLOT(slotActionTriggered(int)));
     connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(slotUpdate()));
+    connect(&_content, SIGNAL(dataReceived()), this, SLOT(slotContentReceived()));
+    connect(&_content, SIGNAL(remoteFailed(bool, const QString &)), this, SLOT(slotRemoteFailed(bool, const QString &)));
 
     _updateTimer.setSingleShot(false);
 
@@ -1310,10 +1509,7 @@ Lister::Lister(QWidget *parent) : KParts::ReadOnlyPart(parent), _searchInProgres
 
 Lister::~Lister()
 {
-    if (_cache != 0) {
-        delete []_cache;
-        _cache = 0;
-    }
+    _content.close();
     if (_tempFile != 0) {
         delete _tempFile;
         _tempFile = 0;
@@ -1325,42 +1521,78 @@ bool Lister::openUrl(const QUrl &listerUrl)
     _downloading = false;
     setUrl(listerUrl);
 
+    if (!_filePath.isEmpty() && _watcher->contains(_filePath))
+        _watcher->removeFile(_filePath);
+
     if (_tempFile) {
         delete _tempFile;
         _tempFile = 0;
     }
     _fileSize = 0;
+    _detectedCodec = 0;
 
     if (listerUrl.isLocalFile()) {
         _filePath = listerUrl.path();
         if (!QFile::exists(_filePath))
             return false;
         _fileSize = getFileSize();
-    } else {
-        _tempFile = new QTemporaryFile(QDir::tempPath() + QLatin1String("/krusader_XXXXXX_") + listerUrl.fileName());
-        _tempFile->open();
-
-        _filePath = _tempFile->fileName();
-
-        KIO::Job * downloadJob = KIO::get(listerUrl, KIO::NoReload, KIO::HideProgressInfo);
-
-        connect(downloadJob, SIGNAL(data(KIO::Job *, const QByteArray &)),
-                this, SLOT(slotFileDataReceived(KIO::Job *, const QByteArray &)));
-        connect(downloadJob, SIGNAL(result(KJob*)),
-                this, SLOT(slotFileFinished(KJob *)));
-        _downloading = false;
-    }
-    if (_cache) {
-        delete []_cache;
-        _cache = 0;
-    }
+        _content.open(_filePath, true);
+    } else if (_content.openRemote(listerUrl)) {
+        _filePath.clear();
+    } else
+        download(listerUrl);
+
+    _lineIndex.reset(_filePath, _fileSize);
+    _lineIndexComplete = false;
     _textArea->reset();
+    if (_actionFollow->isChecked())
+        toggleFollow();
     emit started(0);
     emit setWindowCaption(listerUrl.toDisplayString());
     emit completed();
     return true;
 }
 
+void Lister::download(const QUrl &listerUrl)
+{
+    _tempFile = new QTemporaryFile(QDir::tempPath() + QLatin1String("/krusader_XXXXXX_") + listerUrl.fileName());
+    _tempFile->open();
+
+    _filePath = _tempFile->fileName();
+
+    KIO::Job * downloadJob = KIO::get(listerUrl, KIO::NoReload, KIO::HideProgressInfo);
+
+    connect(downloadJob, SIGNAL(data(KIO::Job *, const QByteArray &)),
+            this, SLOT(slotFileDataReceived(KIO::Job *, const QByteArray &)));
+    connect(downloadJob, SIGNAL(result(KJob*)),
+            this, SLOT(slotFileFinished(KJob *)));
+    _downloading = false;
+
+    _content.open(_filePath, false);
+}
+
+void Lister::slotContentReceived()
+{
+    _fileSize = getFileSize();
+    _textArea->sizeChanged();
+}
+
+void Lister::slotRemoteFailed(bool opened, const QString &error)
+{
+    if (opened) {
+        KMessageBox::error(_textArea, i18n("Error reading file %1.", url().toDisplayString(QUrl::PreferLocalFile))
+                           + '\n' + error);
+        return;
+    }
+
+    // the protocol can't read at random positions, the whole file is downloaded instead
+    download(url());
+    _fileSize = 0;
+    _lineIndex.reset(_filePath, _fileSize);
+    _lineIndexComplete = false;
+    _textArea->reset();
+}
+
 void Lister::slotFileDataReceived(KIO::Job *, const QByteArray &array)
 {
     if (array.size() != 0)
@@ -1378,55 +1610,86 @@ void Lister::slotFileFinished(KJob *job)
 }
 
 
-char * Lister::cacheRef(qint64 filePos, int &size)
+const char * Lister::cacheRef(qint64 filePos, int &size)
 {
     if (filePos >= _fileSize)
         return 0;
     if (_fileSize - filePos < size)
         size = _fileSize - filePos;
-    if ((_cache != 0) && (filePos >= _cachePos) && (filePos + size <= _cachePos + _cacheSize))
-        return _cache + (filePos - _cachePos);
-
-    int cacheSize = CACHE_SIZE;
-    int negativeOffset = CACHE_SIZE * 2 / 5;
-    qint64 cachePos = filePos - negativeOffset;
-    if (cachePos < 0)
-        cachePos = 0;
-
-    QFile myfile(_filePath);
-    if (!myfile.open(QIODevice::ReadOnly)) {
-        myfile.close();
-        return 0;
-    }
+    return _content.data(filePos, size);
+}
 
-    if (!myfile.seek(cachePos)) {
-        myfile.close();
-        return 0;
-    }
+bool Lister::hasLineIndex()
+{
+    return !_content.isRemote() && !_textArea->hexMode() && _textArea->codec()->fromUnicode(QString("\n")) == "\n";
+}
 
-    char * newCache = new char [ cacheSize ];
+bool Lister::isLineIndexComplete()
+{
+    return hasLineIndex() && _lineIndex.isComplete(_fileSize);
+}
 
-    qint64 bytes = myfile.read(newCache, cacheSize);
-    if (bytes == -1) {
-        delete []newCache;
-        myfile.close();
-        return 0;
+qint64 Lister::lineOfPosition(qint64 pos)
+{
+    if (!hasLineIndex() || pos > _lineIndex.indexedSize())
+        return -1;
+
+    qint64 line;
+    qint64 readPos = _lineIndex.checkpointBefore(pos, line);
+    while (readPos < pos) {
+        int size = (pos - readPos > ListerFile::WINDOW_SIZE / 2) ? ListerFile::WINDOW_SIZE / 2 : (int)(pos - readPos);
+        const char * cache = cacheRef(readPos, size);
+        if (cache == 0 || size == 0)
+            return -1;
+
+        const char * p = cache;
+        const char * end = cache + size;
+        while ((p = (const char *)memchr(p, '\n', end - p)) != 0) {
+            ++p;
+            ++line;
+        }
+        readPos += size;
     }
-    if (_cache)
-        delete []_cache;
+    return line;
+}
 
-    _cache = newCache;
-    _cacheSize = bytes;
-    _cachePos = cachePos;
-    int newSize = _cacheSize - (filePos - _cachePos);
-    if (newSize < size)
-        size = newSize;
+qint64 Lister::positionOfLine(qint64 line)
+{
+    if (!hasLineIndex())
+        return -1;
+
+    qint64 currentLine;
+    qint64 readPos = _lineIndex.checkpointOfLine(line, currentLine);
+    if (readPos < 0)
+        return -1;
 
-    return _cache + (filePos - _cachePos);
+    qint64 endPos = _lineIndex.indexedSize();
+    while (currentLine < line) {
+        if (readPos >= endPos)
+            return -1;
+        int size = (endPos - readPos > ListerFile::WINDOW_SIZE / 2) ? ListerFile::WINDOW_SIZE / 2 : (int)(endPos - readPos);
+        const char * cache = cacheRef(readPos, size);
+        if (cache == 0 || size == 0)
+            return -1;
+
+        const char * p = cache;
+        const char * end = cache + size;
+        while (currentLine < line && (p = (const char *)memchr(p, '\n', end - p)) != 0) {
+            ++p;
+            ++currentLine;
+        }
+        if (currentLine == line)
+            return readPos + (p - cache);
+        readPos += size;
+    }
+    return readPos;
 }
 
 qint64 Lister::getFileSize()
 {
+    // while a rotated log is missing, the opened file is still shown
+    if (_content.isRemote() || !QFile::exists(_filePath))
+        return _content.size();
     return QFile(_filePath).size();
 }
 
@@ -1436,6 +1699,8 @@ void Lister::guiActivateEvent(KParts::GUIActivateEvent * event)
         _active = true;
         _updateTimer.setInterval(150);
         _updateTimer.start();
+        // the file may have been truncated while the timer was stopped: the mapping must follow
+        // before anything is drawn from it
         slotUpdate();
         _textArea->redrawTextArea(true);
     } else {
@@ -1450,8 +1715,29 @@ void Lister::slotUpdate()
 {
     qint64 oldSize = _fileSize;
     _fileSize = getFileSize();
-    if (oldSize != _fileSize)
+
+    bool replaced = _tempFile == 0 && !_content.isRemote() && _content.isReplaced(_filePath);
+    if (replaced) {
+        // the log was rotated, the new file is shown from now on
+        _content.open(_filePath, true);
+        _lineIndex.reset(_filePath, _fileSize);
+        _lineIndexComplete = false;
+    }
+
+    if (replaced || oldSize != _fileSize) {
+        _content.resize(_fileSize);
         _textArea->sizeChanged();
+        if (_actionFollow->isChecked())
+            _textArea->scrollToEnd();
+    }
+
+    if (!_lineIndex.isComplete(_fileSize)) {
+        _lineIndex.update(_fileSize);
+        _lineIndexComplete = false;
+    } else if (!_lineIndexComplete) {
+        _lineIndexComplete = true;
+        _textArea->lineIndexChanged();
+    }
 
     int cursorX = 0, cursorY = 0;
     _textArea->getCursorPosition(cursorX, cursorY);
@@ -1460,8 +1746,15 @@ void Lister::slotUpdate()
 
     int percent = (_fileSize == 0) ? 0 : (int)((201 * cursor) / _fileSize / 2);
 
-    QString status = i18n("Column: %1, Position: %2 (%3, %4%)",
-                     cursorX, cursor, _fileSize, percent);
+    qint64 line = lineOfPosition(cursor);
+
+    QString status;
+    if (line >= 0)
+        status = i18n("Line: %1, Column: %2, Position: %3 (%4, %5%)",
+                      line + 1, cursorX, cursor, _fileSize, percent);
+    else
+        status = i18n("Column: %1, Position: %2 (%3, %4%)",
+                      cursorX, cursor, _fileSize, percent);
     _statusLabel->setText(status);
 
     if (_searchProgressCounter)
@@ -1563,7 +1856,13 @@ void Lister::search(bool forward, bool restart)
     _searchIsForward = forward;
     _searchHexadecimal = hex;
 
-    QTimer::singleShot(0, this, SLOT(slotSearchMore()));
+    _searchBytes = byteSearchPattern();
+    if (!_searchBytes.isEmpty()) {
+        _searchLimit = _searchPosition;
+        startSearchWorker(_searchPosition);
+        QTimer::singleShot(0, this, SLOT(slotSearchWorker()));
+    } else
+        QTimer::singleShot(0, this, SLOT(slotSearchMore()));
     _searchInProgress = true;
     _searchProgressCounter = 3;
 
@@ -1576,6 +1875,125 @@ void Lister::enableActions(bool state)
     _actionSearchNext->setEnabled(state);
     _actionSearchPrev->setEnabled(state);
     _actionJumpToPosition->setEnabled(state);
+    _actionJumpToLine->setEnabled(state);
+}
+
+QByteArray Lister::byteSearchPattern()
+{
+    // the worker reads the file itself, the pages of remote files are only read by the lister
+    if (_content.isRemote())
+        return QByteArray();
+    if (_searchHexadecimal)
+        return _searchHexQuery;
+    if (_regExpAction->isChecked())
+        return QByteArray();
+
+    QString text = _searchLineEdit->text();
+    if (!_caseSensitiveAction->isChecked()) {
+        // only ASCII letters are folded bytewise
+        for (int i = 0; i != text.length(); i++)
+            if (text[ i ].unicode() >= 128)
+                return QByteArray();
+    }
+
+    // the pattern can be searched bytewise if every byte of the encoding is a character
+    // (single byte encodings), or if its bytes can't appear inside another character (UTF-8)
+    QTextCodec * textCodec = _textArea->codec();
+    ByteLayout layout = byteLayout(textCodec);
+    if (layout != LayoutSingleByte && layout != LayoutUtf8)
+        return QByteArray();
+
+    QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+    return textCodec->fromUnicode(text.constData(), text.length(), &state);
+}
+
+void Lister::startSearchWorker(qint64 from)
+{
+    bool caseSensitive = _searchHexadecimal || _caseSensitiveAction->isChecked();
+    bool matchWholeWord = !_searchHexadecimal && _matchWholeWordsOnlyAction->isChecked();
+    _searchWorker.search(_filePath, _fileSize, _searchBytes, caseSensitive, matchWholeWord, _searchIsForward, from);
+}
+
+bool Lister::checkSearchHit(qint64 hit, qint64 &anchor, qint64 &cursor)
+{
+    // the row around the hit is decoded and matched by the query, the rest of the file is never decoded
+    qint64 lowerLimit = _searchIsForward ? _searchLimit : 0;
+    qint64 upperLimit = _searchIsForward ? _fileSize : _searchLimit;
+
+    qint64 readPos = hit - SEARCH_MAX_ROW_LEN;
+    if (readPos < lowerLimit)
+        readPos = lowerLimit;
+    qint64 readEnd = hit + _searchBytes.size() + SEARCH_MAX_ROW_LEN;
+    if (readEnd > upperLimit)
+        readEnd = upperLimit;
+
+    int size = (int)(readEnd - readPos);
+    const char * cache = cacheRef(readPos, size);
+    int hitIndex = (int)(hit - readPos);
+    if (cache == 0 || hitIndex + _searchBytes.size() > size)
+        return false;
+
+    int rowStart = hitIndex;
+    while (rowStart > 0 && cache[ rowStart - 1 ] != '\n')
+        rowStart--;
+    int rowEnd = hitIndex + _searchBytes.size();
+    while (rowEnd < size && cache[ rowEnd ] != '\n')
+        rowEnd++;
+
+    QTextCodec * textCodec = _textArea->codec();
+    QString row = textCodec->toUnicode(cache + rowStart, rowEnd - rowStart);
+    if (!_searchQuery.checkLine(row, !_searchIsForward))
+        return false;
+
+    QByteArray cachedBuffer(cache + rowStart, rowEnd - rowStart);
+
+    QTextStream stream(&cachedBuffer);
+    stream.setCodec(textCodec);
+
+    stream.read(_searchQuery.matchIndex());
+    anchor = readPos + rowStart + stream.pos();
+
+    stream.read(_searchQuery.matchLength());
+    cursor = readPos + rowStart + stream.pos();
+    return true;
+}
+
+void Lister::slotSearchWorker()
+{
+    if (!_searchInProgress)
+        return;
+
+    if (_searchWorker.isRunning()) {
+        _searchPosition = _searchWorker.position();
+        updateProgressBar();
+        QTimer::singleShot(SEARCH_POLL_TIME, this, SLOT(slotSearchWorker()));
+        return;
+    }
+
+    qint64 hit = _searchWorker.result();
+    if (hit == -1) {
+        if (!_restartFromBeginning) {
+            searchFailed();
+            return;
+        }
+        _restartFromBeginning = false;
+        _searchLimit = _searchIsForward ? 0 : _fileSize;
+        startSearchWorker(_searchLimit);
+        QTimer::singleShot(0, this, SLOT(slotSearchWorker()));
+        return;
+    }
+
+    qint64 foundAnchor = hit;
+    qint64 foundCursor = hit + _searchBytes.size();
+    if (_searchHexadecimal || checkSearchHit(hit, foundAnchor, foundCursor)) {
+        _textArea->setAnchorAndCursor(foundAnchor, foundCursor);
+        searchSucceeded();
+        return;
+    }
+
+    // continue behind the rejected hit
+    startSearchWorker(_searchIsForward ? hit + 1 : hit + _searchBytes.size() - 1);
+    QTimer::singleShot(0, this, SLOT(slotSearchWorker()));
 }
 
 void Lister::slotSearchMore()
@@ -1597,6 +2015,7 @@ void Lister::slotSearchMore()
     }
 
     int maxCacheSize = SEARCH_CACHE_CHARS;
+    qint64 origPosition = _searchPosition + (_searchIsForward ? 0 : 1);
     qint64 searchPos = _searchPosition;
     bool setPosition = true;
     if (!_searchIsForward) {
@@ -1612,7 +2031,15 @@ void Lister::slotSearchMore()
             maxCacheSize = diff;
     }
 
-    char * cache = cacheRef(searchPos, maxCacheSize);
+    int expectedSize = (_fileSize - searchPos < maxCacheSize) ? (int)(_fileSize - searchPos) : maxCacheSize;
+    const char * cache = cacheRef(searchPos, maxCacheSize);
+    if ((cache == 0 || maxCacheSize < expectedSize) && _content.isPending()) {
+        // the pages of the remote file are being read, try again when they are here
+        if (!_searchIsForward)
+            _searchPosition = origPosition;
+        QTimer::singleShot(SEARCH_POLL_TIME, this, SLOT(slotSearchMore()));
+        return;
+    }
     if (cache == 0 || maxCacheSize == 0) {
         searchFailed();
         return;
@@ -1745,6 +2172,7 @@ void Lister::searchFailed()
 void Lister::searchDelete()
 {
     _searchInProgress = false;
+    _searchWorker.stop();
     setColor(false, true);
     hideProgressBar();
     _searchLastFailedPosition = -1;
@@ -1886,13 +2314,51 @@ void Lister::jumpToPosition()
     _textArea->ensureVisibleCursor();
 }
 
+void Lister::jumpToLine()
+{
+    if (!hasLineIndex()) {
+        KMessageBox::error(_textArea, i18n("Lines are not counted in hex mode and in this encoding."), i18n("Jump to line"));
+        return;
+    }
+
+    bool ok = true;
+    QString res = QInputDialog::getText(_textArea, i18n("Jump to line"), i18n("Line number:"),
+                                        QLineEdit::Normal, "1", &ok);
+    if (!ok)
+        return;
+
+    qulonglong line = res.trimmed().toULongLong(&ok);
+    if (!ok || line == 0) {
+        KMessageBox::error(_textArea, i18n("Invalid number."), i18n("Jump to line"));
+        return;
+    }
+
+    qint64 pos = positionOfLine((qint64)line - 1);
+    if (pos < 0) {
+        if (_lineIndex.isComplete(_fileSize))
+            KMessageBox::error(_textArea, i18n("Number out of range."), i18n("Jump to line"));
+        else
+            KMessageBox::error(_textArea, i18n("The line is not indexed yet, please try again later."), i18n("Jump to line"));
+        return;
+    }
+
+    _textArea->deleteAnchor();
+    _textArea->setCursorPosition(pos, true);
+    _textArea->ensureVisibleCursor();
+}
+
 void Lister::saveAs()
 {
     QUrl url = QFileDialog::getSaveFileUrl(_textArea, i18n("Lister"));
     if (url.isEmpty())
         return;
+    if (url.isLocalFile() && isLocalSource()) {
+        startLocalCopy(0, QFileInfo(_filePath).size(), url, true);
+        return;
+    }
+
     QUrl sourceUrl;
-    if (!_downloading)
+    if (!_downloading && !_content.isRemote())
         sourceUrl = QUrl::fromLocalFile(_filePath);
     else
         sourceUrl = this->url();
@@ -1927,6 +2393,15 @@ void Lister::saveSelected()
     if (url.isEmpty())
         return;
 
+    _actionSaveSelected->setEnabled(false);
+
+    if (url.isLocalFile() && isLocalSource()) {
+        KJob *copyJob = startLocalCopy(_savePosition, _saveEnd, url);
+        connect(copyJob, SIGNAL(result(KJob*)),
+                this, SLOT(slotSendFinished(KJob *)));
+        return;
+    }
+
     KIO::Job *saveJob = KIO::put(url, -1, KIO::Overwrite);
     connect(saveJob, SIGNAL(dataReq(KIO::Job *, QByteArray &)),
             this, SLOT(slotDataSend(KIO::Job *, QByteArray &)));
@@ -1936,8 +2411,23 @@ void Lister::saveSelected()
     saveJob->setUiDelegate(new KIO::JobUiDelegate());
     KIO::getJobTracker()->registerJob(saveJob);
     saveJob->ui()->setAutoErrorHandlingEnabled(true);
+}
 
-    _actionSaveSelected->setEnabled(false);
+bool Lister::isLocalSource()
+{
+    return !_downloading && !_content.isRemote() && !_filePath.isEmpty();
+}
+
+KJob * Lister::startLocalCopy(qint64 start, qint64 end, const QUrl &destination, bool copyAttributes)
+{
+    // local saves bypass KIO, the kernel copies the data between the files
+    ListerCopyJob *job = new ListerCopyJob(_filePath, start, end, destination.toLocalFile(),
+                                               copyAttributes);
+    job->setUiDelegate(new KIO::JobUiDelegate());
+    KIO::getJobTracker()->registerJob(job);
+    job->uiDelegate()->setAutoErrorHandlingEnabled(true);
+    job->start();
+    return job;
 }
 
 void Lister::slotDataSend(KIO::Job *, QByteArray &array)
@@ -1950,7 +2440,13 @@ void Lister::slotDataSend(KIO::Job *, QByteArray &array)
     if (max > 1000)
         max = 1000;
     int maxBytes = (int)max;
-    char * cache = cacheRef(_savePosition, maxBytes);
+    const char * cache = cacheRef(_savePosition, maxBytes);
+    while (cache == 0 && _content.isPending()) {
+        // the pages of a remote file are read asynchronously
+        qApp->processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::WaitForMoreEvents);
+        maxBytes = (int)max;
+        cache = cacheRef(_savePosition, maxBytes);
+    }
     _savePosition += maxBytes;
 
     array = QByteArray(cache, maxBytes);
@@ -1967,6 +2463,103 @@ void Lister::setCharacterSet(QString set)
     _textArea->redrawTextArea(true);
 }
 
+QTextCodec * Lister::detectedCodec()
+{
+    int sampleSize = (_fileSize < ENCODING_SAMPLE) ? (int)_fileSize : ENCODING_SAMPLE;
+    if (_detectedCodec && _detectedSampleSize == sampleSize)
+        return _detectedCodec;
+
+    // a short sample is examined again when the file grows
+    const char * sample = sampleSize ? cacheRef(0, sampleSize) : 0;
+    if (sample == 0 || sampleSize == 0)
+        return _detectedCodec ? _detectedCodec : QTextCodec::codecForLocale();
+
+    const unsigned char * data = (const unsigned char *)sample;
+    _detectedSampleSize = sampleSize;
+    _detectedCodec = 0;
+
+    if (sampleSize >= 3 && data[ 0 ] == 0xEF && data[ 1 ] == 0xBB && data[ 2 ] == 0xBF)
+        _detectedCodec = QTextCodec::codecForMib(106);
+    else if (sampleSize >= 2 && data[ 0 ] == 0xFF && data[ 1 ] == 0xFE)
+        _detectedCodec = QTextCodec::codecForMib(1014);
+    else if (sampleSize >= 2 && data[ 0 ] == 0xFE && data[ 1 ] == 0xFF)
+        _detectedCodec = QTextCodec::codecForMib(1013);
+    if (_detectedCodec)
+        return _detectedCodec;
+
+    // UTF-16 text without byte order mark has zeros in the high bytes of its ASCII characters
+    int zeros[ 2 ] = { 0, 0 };
+    for (int i = 0; i != sampleSize; i++)
+        if (data[ i ] == 0)
+            zeros[ i & 1 ]++;
+    int pairs = sampleSize / 2;
+    if (pairs >= 2 && zeros[ 1 ] > pairs / 4 && zeros[ 0 ] < zeros[ 1 ] / 16)
+        return _detectedCodec = QTextCodec::codecForMib(1014);
+    if (pairs >= 2 && zeros[ 0 ] > pairs / 4 && zeros[ 1 ] < zeros[ 0 ] / 16)
+        return _detectedCodec = QTextCodec::codecForMib(1013);
+
+    bool ascii = true;
+    bool utf8 = true;
+    for (int i = 0; i < sampleSize;) {
+        int code;
+        int length = encodedCharLength(LayoutUtf8, data + i, sampleSize - i, code);
+        if (code < 0) {
+            ascii = false;
+            // a sequence cut by the end of the sample is not an error
+            if (length == 1 && (data[ i ] < 0xC2 || data[ i ] >= 0xF5 || i + 4 <= sampleSize)) {
+                utf8 = false;
+                break;
+            }
+        }
+        i += length;
+    }
+
+    QTextCodec * locale = QTextCodec::codecForLocale();
+    if (ascii)
+        _detectedCodec = locale;
+    else if (utf8)
+        _detectedCodec = QTextCodec::codecForMib(106);
+    else {
+        KEncodingProber prober(KEncodingProber::Universal);
+        prober.feed(sample, sampleSize);
+        if (prober.confidence() >= 0.5)
+            _detectedCodec = QTextCodec::codecForName(prober.encoding());
+        if (_detectedCodec == 0 || _detectedCodec->mibEnum() == 106)
+            _detectedCodec = (locale->mibEnum() == 106) ? QTextCodec::codecForMib(4) : locale;
+    }
+    return _detectedCodec;
+}
+
+Lister::ByteLayout Lister::byteLayout(QTextCodec * codec)
+{
+    if (codec == _layoutCodec)
+        return _layout;
+
+    _layoutCodec = codec;
+    switch (codec->mibEnum()) {
+    case 106:
+        return _layout = LayoutUtf8;
+    case 1014:
+        return _layout = LayoutUtf16LE;
+    case 1013:
+        return _layout = LayoutUtf16BE;
+    }
+
+    // single byte encodings qualify if every byte is one character and only the ASCII bytes are line breaks and tabs
+    _layout = LayoutSingleByte;
+    for (int c = 0; c != 256; c++) {
+        char byte = (char)c;
+        QTextDecoder * decoder = codec->makeDecoder();
+        QString chr = decoder->toUnicode(&byte, 1);
+        delete decoder;
+        if (chr.length() != 1 || ((chr[ 0 ] == QChar('\n') || chr[ 0 ] == QChar('\t')) != (c == '\n' || c == '\t'))) {
+            _layout = LayoutNone;
+            break;
+        }
+    }
+    return _layout;
+}
+
 void Lister::print()
 {
     bool isfirst;
@@ -2082,11 +2675,14 @@ QStringList Lister::readLines(qint64 &filePos, qint64 endPos, int columns, int l
         maxBytes = (int)(endPos - filePos);
     if (maxBytes <= 0)
         return list;
-    char * cache = cacheRef(filePos, maxBytes);
+    const char * cache = cacheRef(filePos, maxBytes);
     if (cache == 0 || maxBytes == 0)
         return list;
 
     QTextCodec * textCodec = _textArea->codec();
+    if (byteLayout(textCodec) != LayoutNone)
+        return readEncodedLines(textCodec, cache, maxBytes, filePos, columns, lines);
+
     QTextDecoder * decoder = textCodec->makeDecoder();
 
     int cnt = 0;
@@ -2137,8 +2733,73 @@ QStringList Lister::readLines(qint64 &filePos, qint64 endPos, int columns, int l
     return list;
 }
 
+QStringList Lister::readEncodedLines(QTextCodec * textCodec, const char * cache, int maxBytes, qint64 &filePos,
+                                     int columns, int lines)
+{
+    ByteLayout layout = byteLayout(textCodec);
+    const unsigned char * data = (const unsigned char *)cache;
+    int tabWidth = _textArea->tabWidth();
+    QStringList list;
+
+    int cnt = (filePos == 0) ? byteOrderMarkLength(layout, data, maxBytes) : 0;
+    int rowStart = cnt;
+    int length = 0;
+    int y = 0;
+    QString row = "";
+    bool isLastLongLine = false;
+    while (cnt < maxBytes && y < lines) {
+        int lastCnt = cnt;
+        int code;
+        cnt += encodedCharLength(layout, data + cnt, maxBytes - cnt, code);
+        if (code == '\n') {
+            if (!isLastLongLine) {
+                list << row + decodeRow(textCodec, cache + rowStart, lastCnt - rowStart, QChar(' '));
+                row = "";
+                length = 0;
+                y++;
+            }
+            rowStart = cnt;
+            isLastLongLine = false;
+        } else {
+            isLastLongLine = false;
+            if (code == '\t') {
+                row += decodeRow(textCodec, cache + rowStart, lastCnt - rowStart, QChar(' '));
+                rowStart = cnt;
+                int tabLength = tabWidth - (length % tabWidth);
+                if (length + tabLength > columns) {
+                    list << row;
+                    row = "";
+                    length = 0;
+                    y++;
+                }
+                row += QString(tabLength, QChar(' '));
+                length += tabLength;
+            } else
+                length++;
+
+            if (length >= columns) {
+                list << row + decodeRow(textCodec, cache + rowStart, cnt - rowStart, QChar(' '));
+                row = "";
+                rowStart = cnt;
+                length = 0;
+                y++;
+                isLastLongLine = true;
+            }
+        }
+    }
+
+    if (y < lines)
+        list << row + decodeRow(textCodec, cache + rowStart, cnt - rowStart, QChar(' '));
+
+    filePos += cnt;
+    return list;
+}
+
 int Lister::hexPositionDigits()
 {
+    if (_hexDigitsFileSize == _fileSize)
+        return _hexPositionDigits;
+
     int positionDigits = 0;
     qint64 checker = _fileSize;
     while (checker) {
@@ -2147,23 +2808,51 @@ int Lister::hexPositionDigits()
     }
     if (positionDigits < 8)
         positionDigits = 8;
+
+    _hexDigitsFileSize = _fileSize;
+    _hexPositionDigits = positionDigits;
     return positionDigits;
 }
 
 int Lister::hexBytesPerLine(int columns)
 {
     int positionDigits = hexPositionDigits();
+    if (_hexColumns == columns && _hexColumnsDigits == positionDigits)
+        return _hexBytesPerRow;
+
     int bytesPerRow = 8;
     if (columns >= positionDigits + 5 + 64)
         bytesPerRow = 16;
     if (columns >= positionDigits + 5 + 128)
         bytesPerRow = 32;
 
+    _hexColumns = columns;
+    _hexColumnsDigits = positionDigits;
+    _hexBytesPerRow = bytesPerRow;
     return bytesPerRow;
 }
 
+// the hex digits and the displayed character of every byte value
+struct HexTables {
+    QChar digits[ 16 ];
+    QChar pairs[ 256 ][ 2 ];
+    QChar chars[ 256 ];
+
+    HexTables() {
+        for (int i = 0; i != 16; i++)
+            digits[ i ] = QLatin1Char("0123456789abcdef"[ i ]);
+        for (int c = 0; c != 256; c++) {
+            pairs[ c ][ 0 ] = digits[ c >> 4 ];
+            pairs[ c ][ 1 ] = digits[ c & 15 ];
+            chars[ c ] = (c < 32 || c >= 128) ? QChar('.') : QChar(c);
+        }
+    }
+};
+
 QStringList Lister::readHexLines(qint64 &filePos, qint64 endPos, int columns, int lines)
 {
+    static const HexTables tables;
+
     int positionDigits = hexPositionDigits();
     int bytesPerRow = hexBytesPerLine(columns);
 
@@ -2176,53 +2865,69 @@ QStringList Lister::readHexLines(qint64 &filePos, qint64 endPos, int columns, in
     if (maxBytes <= 0)
         return list;
 
-    char * cache = cacheRef(choppedPos, maxBytes);
+    const char * cache = cacheRef(choppedPos, maxBytes);
 
     if (cache == 0 || maxBytes == 0)
         return list;
 
-    int cnt = 0;
-    for (int l = 0; l < lines; l++) {
-        if (filePos >= endPos)
-            break;
-        qint64 printPos = (filePos / bytesPerRow) * bytesPerRow;
-        QString pos;
-        pos.setNum(printPos, 16);
-        while (pos.length() < positionDigits)
-            pos = QString("0") + pos;
-        pos = QString("0x") + pos;
-        pos += QString(": ");
+    // only whole rows are shown if the cache returned less than asked for
+    qint64 dataEnd = choppedPos + maxBytes;
+    int rows;
+    if (dataEnd < endPos)
+        rows = maxBytes / bytesPerRow;
+    else {
+        dataEnd = endPos;
+        rows = (maxBytes + bytesPerRow - 1) / bytesPerRow;
+    }
+    if (rows > lines)
+        rows = lines;
+    if (rows <= 0)
+        return list;
+
+    // the whole screen is rendered into one reused buffer, row by row:
+    // "0x" + position + ": " + (hex byte + ' ') * bytesPerRow + ' ' + characters
+    const int rowLength = positionDigits + 5 + 4 * bytesPerRow;
+    if (_hexBuffer.size() < rows * rowLength)
+        _hexBuffer.resize(rows * rowLength);
+
+    const uchar * data = (const uchar *)cache;
+    for (int l = 0; l != rows; l++) {
+        QChar * row = _hexBuffer.data() + l * rowLength;
+        qint64 printPos = choppedPos + (qint64)l * bytesPerRow;
+
+        row[ 0 ] = QLatin1Char('0');
+        row[ 1 ] = QLatin1Char('x');
+        qint64 digits = printPos;
+        for (int d = positionDigits + 1; d != 1; d--) {
+            row[ d ] = tables.digits[ digits & 15 ];
+            digits >>= 4;
+        }
+        row[ positionDigits + 2 ] = QLatin1Char(':');
+        row[ positionDigits + 3 ] = QLatin1Char(' ');
 
-        QString charData;
+        QChar * hex = row + positionDigits + 4;
+        QChar * chars = hex + 3 * bytesPerRow + 1;
+        hex[ 3 * bytesPerRow ] = QLatin1Char(' ');
 
-        for (int i = 0; i != bytesPerRow; ++i, ++cnt) {
+        for (int i = 0; i != bytesPerRow; ++i, hex += 3) {
             qint64 currentPos = printPos + i;
-            if (currentPos < filePos || currentPos >= endPos) {
-                pos += QString("   ");
-                charData += QString(" ");
+            hex[ 2 ] = QLatin1Char(' ');
+            if (currentPos < filePos || currentPos >= dataEnd) {
+                hex[ 0 ] = hex[ 1 ] = chars[ i ] = QLatin1Char(' ');
             } else {
-                char c = cache[ cnt ];
-                int charCode = (int)c;
-                if (charCode < 0)
-                    charCode += 256;
-                QString hex;
-                hex.setNum(charCode, 16);
-                if (hex.length() < 2)
-                    hex = QString("0") + hex;
-                pos += hex + QString(" ");
-                if (c < 32)
-                    c = '.';
-                charData += QChar(c);
+                uchar c = data[ currentPos - choppedPos ];
+                hex[ 0 ] = tables.pairs[ c ][ 0 ];
+                hex[ 1 ] = tables.pairs[ c ][ 1 ];
+                chars[ i ] = tables.chars[ c ];
             }
         }
 
-        pos += QString(" ") + charData;
-        list << pos;
-        filePos = printPos + bytesPerRow;
+        list << QString(_hexBuffer.constData() + l * rowLength, rowLength);
     }
 
-    if (filePos > endPos)
-        filePos = endPos;
+    filePos = choppedPos + (qint64)rows * bytesPerRow;
+    if (filePos > dataEnd)
+        filePos = dataEnd;
 
     return list;
 }
@@ -2253,6 +2958,23 @@ int Lister::hexPositionToIndex(int columns, int position)
     return position;
 }
 
+void Lister::toggleFollow()
+{
+    bool watch = _actionFollow->isChecked() && url().isLocalFile();
+    if (watch && !_watcher->contains(_filePath))
+        _watcher->addFile(_filePath);
+    else if (!watch && _watcher->contains(_filePath))
+        _watcher->removeFile(_filePath);
+
+    if (_actionFollow->isChecked())
+        _textArea->scrollToEnd();
+}
+
+void Lister::slotFileChanged(const QString &)
+{
+    slotUpdate();
+}
+
 void Lister::toggleHexMode()
 {
     setHexMode(!_textArea->hexMode());
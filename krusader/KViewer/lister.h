@@ -33,6 +33,7 @@
 
 // QtCore
 #include <QList>
+#include <QVector>
 #include <QTimer>
 // QtGui
 #include <QColor>
@@ -45,6 +46,9 @@
 #include <KParts/Part>
 #include <KTextWidgets/KTextEdit>
 
+#include "listerfile.h"
+#include "listerlineindex.h"
+#include "listersearch.h"
 #include "../VFS/krquery.h"
 
 #define  SLIDER_MAX          10000
@@ -57,6 +61,7 @@ class QPushButton;
 class QToolButton;
 class QAction;
 class QTemporaryFile;
+class KDirWatch;
 class ListerEncodingMenu;
 
 class ListerTextArea : public KTextEdit
@@ -98,6 +103,8 @@ public:
 
     void           setAnchorAndCursor(qint64 anchor, qint64 cursor);
     void           sizeChanged();
+    void           lineIndexChanged();
+    void           scrollToEnd();
 
 protected:
     virtual void   resizeEvent(QResizeEvent * event) Q_DECL_OVERRIDE;
@@ -108,8 +115,11 @@ protected:
     virtual void   wheelEvent(QWheelEvent * event) Q_DECL_OVERRIDE;
 
     QStringList    readLines(qint64 filePos, qint64 &endPos, int lines, QList<qint64> * locs = 0);
+    QStringList    readEncodedLines(QTextCodec * textCodec, const char * cache, int maxBytes, qint64 filePos,
+                                    qint64 &endPos, int lines, QList<qint64> * locs);
     QString        readSection(qint64 p1, qint64 p2);
     void           setUpScrollBar();
+    qint64         scrollUnits(qint64 pos);
     void           setCursorPosition(int x, int y, int anchorX = -1, int anchorY = -1);
     void           handleAnchorChange(int oldAnchor);
     void           performAnchorChange(int anchor);
@@ -130,6 +140,8 @@ protected:
     qint64         _averagePageSize;
 
     qint64         _lastPageStartPos;
+    qint64         _lastPageUnits;
+    bool           _scrollByLines;
 
     int            _sizeX;
     int            _sizeY;
@@ -206,16 +218,32 @@ public:
     inline qint64   fileSize() {
         return _fileSize;
     }
-    char *          cacheRef(qint64 filePos, int &size);
+    const char *    cacheRef(qint64 filePos, int &size);
+
+    bool            hasLineIndex();
+    bool            isLineIndexComplete();
+    qint64          lineOfPosition(qint64 pos);
+    qint64          positionOfLine(qint64 line);
 
     bool            isSearchEnabled();
     void            enableSearch(bool);
     void            enableActions(bool);
 
+    // the encodings whose character boundaries and line breaks can be found in the encoded bytes
+    enum ByteLayout {
+        LayoutNone,
+        LayoutSingleByte,
+        LayoutUtf8,
+        LayoutUtf16LE,
+        LayoutUtf16BE
+    };
+
     QString         characterSet() {
         return _characterSet;
     }
     void            setCharacterSet(QString set);
+    QTextCodec *    detectedCodec();
+    ByteLayout      byteLayout(QTextCodec * codec);
     void            setHexMode(bool);
 
     QStringList     readHexLines(qint64 &filePos, qint64 endPos, int columns, int lines);
@@ -233,19 +261,25 @@ public slots:
     void            searchPrev();
     void            searchDelete();
     void            jumpToPosition();
+    void            jumpToLine();
     void            saveAs();
     void            saveSelected();
     void            print();
     void            toggleHexMode();
+    void            toggleFollow();
 
 protected slots:
     void            slotUpdate();
     void            slotSearchMore();
+    void            slotSearchWorker();
 
     void            searchSucceeded();
     void            searchFailed();
     void            searchTextChanged();
 
+    void            slotContentReceived();
+    void            slotFileChanged(const QString &path);
+    void            slotRemoteFailed(bool opened, const QString &error);
     void            slotFileDataReceived(KIO::Job *, const QByteArray &);
     void            slotFileFinished(KJob *);
 
@@ -267,8 +301,17 @@ protected:
     void            resetSearchPosition();
 
     qint64          getFileSize();
+    void            download(const QUrl &url);
     void            search(bool forward, bool restart = false);
+    QByteArray      byteSearchPattern();
+    void            startSearchWorker(qint64 from);
+    bool            checkSearchHit(qint64 hit, qint64 &anchor, qint64 &cursor);
+    bool            isLocalSource();
+    KJob *          startLocalCopy(qint64 start, qint64 end, const QUrl &destination,
+                                   bool copyAttributes = false);
     QStringList     readLines(qint64 &filePos, qint64 endPos, int columns, int lines);
+    QStringList     readEncodedLines(QTextCodec * textCodec, const char * cache, int maxBytes, qint64 &filePos,
+                                     int columns, int lines);
 
     QTimer          _updateTimer;
     ListerTextArea *_textArea;
@@ -297,15 +340,18 @@ protected:
     QAction *_actionSearchNext;
     QAction *_actionSearchPrev;
     QAction *_actionJumpToPosition;
+    QAction *_actionJumpToLine;
     QAction *_actionHexMode;
+    QAction *_actionFollow;
     ListerEncodingMenu *_actionEncoding;
 
     QString         _filePath;
     qint64          _fileSize;
 
-    char           *_cache;
-    int             _cacheSize;
-    qint64          _cachePos;
+    ListerFile      _content;
+    ListerLineIndex _lineIndex;
+    KDirWatch      *_watcher;
+    bool            _lineIndexComplete;
 
     bool            _active;
 
@@ -315,11 +361,18 @@ protected:
     bool            _searchIsForward;
     qint64          _searchLastFailedPosition;
     int             _searchProgressCounter;
+    ListerSearch    _searchWorker;
+    QByteArray      _searchBytes;
+    qint64          _searchLimit;
 
     QColor          _originalBackground;
     QColor          _originalForeground;
 
     QString         _characterSet;
+    QTextCodec     *_detectedCodec;
+    int             _detectedSampleSize;
+    QTextCodec     *_layoutCodec;
+    ByteLayout      _layout;
 
     QTemporaryFile *_tempFile;
 
@@ -328,6 +381,13 @@ protected:
 
     qint64          _savePosition;
     qint64          _saveEnd;
+
+    QVector<QChar>  _hexBuffer;
+    qint64          _hexDigitsFileSize;
+    int             _hexPositionDigits;
+    int             _hexColumns;
+    int             _hexColumnsDigits;
+    int             _hexBytesPerRow;
 };
 
 #endif // __LISTER_H__
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "listercopyjob.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
+#include <qplatformdefs.h>
+// QtCore
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QTimer>
+
+#include <KI18n/KLocalizedString>
+#include <KIO/Global>
+
+#define COPY_CHUNK_SIZE     (4 * 1024 * 1024)
+#define COPY_BUFFER_SIZE    (1024 * 1024)
+
+ListerCopyJob::ListerCopyJob(const QString &source, qint64 start, qint64 end, const QString &destination,
+                             bool copyAttributes) :
+        _source(source), _destination(destination), _start(start), _end(end), _position(start),
+        _sourceFd(-1), _destFd(-1), _method(CopyFileRange), _copyAttributes(copyAttributes), _killed(false)
+{
+    setCapabilities(KJob::Killable);
+    setTotalAmount(KJob::Bytes, end - start);
+}
+
+ListerCopyJob::~ListerCopyJob()
+{
+    closeFiles();
+}
+
+void ListerCopyJob::start()
+{
+    // the result must not be emitted before the caller could connect to it
+    QTimer::singleShot(0, this, SLOT(slotStart()));
+}
+
+void ListerCopyJob::slotStart()
+{
+    if (_killed)
+        return;
+
+    emit description(this, i18n("Saving"), qMakePair(i18n("Source"), _source),
+                     qMakePair(i18n("Destination"), _destination));
+
+    // truncating the destination would destroy the data to be copied
+    QFileInfo destInfo(_destination);
+    if (destInfo.exists() && destInfo.canonicalFilePath() == QFileInfo(_source).canonicalFilePath()) {
+        finish(KIO::ERR_IDENTICAL_FILES, _destination);
+        return;
+    }
+
+    _sourceFd = QT_OPEN(QFile::encodeName(_source).constData(), O_RDONLY | O_CLOEXEC);
+    if (_sourceFd < 0) {
+        finish(KIO::ERR_CANNOT_OPEN_FOR_READING, _source);
+        return;
+    }
+    _destFd = QT_OPEN(QFile::encodeName(_destination).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (_destFd < 0) {
+        finish(KIO::ERR_CANNOT_OPEN_FOR_WRITING, _destination);
+        return;
+    }
+
+    QTimer::singleShot(0, this, SLOT(slotCopy()));
+}
+
+QString ListerCopyJob::errorString() const
+{
+    return KIO::buildErrorString(error(), errorText());
+}
+
+bool ListerCopyJob::doKill()
+{
+    _killed = true;
+    closeFiles();
+    return true;
+}
+
+void ListerCopyJob::slotCopy()
+{
+    if (_killed)
+        return;
+
+    qint64 size = _end - _position;
+    if (size > COPY_CHUNK_SIZE)
+        size = COPY_CHUNK_SIZE;
+
+    qint64 copied = copyChunk(size);
+    if (copied < 0) {
+        finish(KIO::ERR_COULD_NOT_WRITE, _destination);
+        return;
+    }
+
+    _position += copied;
+    setProcessedAmount(KJob::Bytes, _position - _start);
+
+    // only read() reports the end of a source which became shorter
+    if (copied == 0 || _position >= _end) {
+        if (_copyAttributes)
+            copyAttributes();
+        finish();
+        return;
+    }
+    QTimer::singleShot(0, this, SLOT(slotCopy()));
+}
+
+qint64 ListerCopyJob::copyChunk(qint64 size)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_copy_file_range)
+    if (_method == CopyFileRange) {
+        loff_t sourceOffset = _position;
+        ssize_t copied;
+        do {
+            copied = syscall(SYS_copy_file_range, _sourceFd, &sourceOffset, _destFd, (loff_t *)0, (size_t)size, 0u);
+        } while (copied < 0 && errno == EINTR);
+        if (copied > 0)
+            return copied;
+        // not supported by the kernel or between these file systems; procfs, sysfs and some
+        // network file systems report nothing to copy, only read() can tell the end of the file
+        if (copied < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP)
+            return -1;
+        _method = copied < 0 ? SendFile : ReadWrite;
+    }
+#endif
+#ifdef Q_OS_LINUX
+    if (_method == SendFile) {
+        off_t sourceOffset = _position;
+        ssize_t copied;
+        do {
+            copied = sendfile(_destFd, _sourceFd, &sourceOffset, (size_t)size);
+        } while (copied < 0 && errno == EINTR);
+        if (copied > 0)
+            return copied;
+        if (copied < 0 && errno != ENOSYS && errno != EINVAL)
+            return -1;
+        _method = ReadWrite;
+    }
+#endif
+    _method = ReadWrite;
+
+    if (_buffer.isEmpty())
+        _buffer.resize(COPY_BUFFER_SIZE);
+    if (size > _buffer.size())
+        size = _buffer.size();
+
+    ssize_t bytes;
+    do {
+        bytes = QT_PREAD(_sourceFd, _buffer.data(), (size_t)size, _position);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes <= 0)
+        return bytes;
+
+    ssize_t written = 0;
+    while (written < bytes) {
+        ssize_t len = QT_WRITE(_destFd, _buffer.constData() + written, bytes - written);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        written += len;
+    }
+    return bytes;
+}
+
+void ListerCopyJob::copyAttributes()
+{
+    // like a KIO copy, a saved file keeps the permissions and the modification time
+    QT_STATBUF stat_p;
+    if (QT_FSTAT(_sourceFd, &stat_p) != 0)
+        return;
+    fchmod(_destFd, stat_p.st_mode & 07777);
+
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+#ifdef Q_OS_LINUX
+    times[1] = stat_p.st_mtim;
+#else
+    times[1].tv_sec = stat_p.st_mtime;
+    times[1].tv_nsec = 0;
+#endif
+    futimens(_destFd, times);
+}
+
+void ListerCopyJob::finish(int error, const QString &path)
+{
+    closeFiles();
+    if (error) {
+        setError(error);
+        setErrorText(path);
+    }
+    emitResult();
+}
+
+void ListerCopyJob::closeFiles()
+{
+    if (_sourceFd >= 0)
+        QT_CLOSE(_sourceFd);
+    if (_destFd >= 0)
+        QT_CLOSE(_destFd);
+    _sourceFd = _destFd = -1;
+}
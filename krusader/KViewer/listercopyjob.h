@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef LISTERCOPYJOB_H
+#define LISTERCOPYJOB_H
+
+// QtCore
+#include <QString>
+
+#include <KCoreAddons/KJob>
+
+/**
+ * Copies a byte range of a local file into another local file.
+ *
+ * The data is moved by the kernel with copy_file_range() or sendfile() where they are available,
+ * and through a buffer otherwise. The copy proceeds in chunks from the event loop, reporting the
+ * progress like a KIO job; it can be killed between two chunks.
+ */
+class ListerCopyJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    /// @p copyAttributes gives the destination the permissions and the modification time of the source
+    ListerCopyJob(const QString &source, qint64 start, qint64 end, const QString &destination,
+                  bool copyAttributes = false);
+    virtual ~ListerCopyJob();
+
+    virtual void    start() Q_DECL_OVERRIDE;
+    virtual QString errorString() const Q_DECL_OVERRIDE;
+
+protected:
+    virtual bool    doKill() Q_DECL_OVERRIDE;
+
+protected slots:
+    void            slotStart();
+    void            slotCopy();
+
+private:
+    enum Method {
+        CopyFileRange,
+        SendFile,
+        ReadWrite
+    };
+
+    qint64          copyChunk(qint64 size);
+    void            copyAttributes();
+    void            finish(int error = 0, const QString &path = QString());
+    void            closeFiles();
+
+    QString         _source;
+    QString         _destination;
+    qint64          _start;
+    qint64          _end;
+    qint64          _position;
+    int             _sourceFd;
+    int             _destFd;
+    Method          _method;
+    bool            _copyAttributes;
+    bool            _killed;
+    QByteArray      _buffer;
+};
+
+#endif /* LISTERCOPYJOB_H */
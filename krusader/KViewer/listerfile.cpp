@@ -0,0 +1,398 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "listerfile.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <qplatformdefs.h>
+
+// QtCore
+#include <QFileInfo>
+
+#include <KIO/FileJob>
+#include <KIOCore/KProtocolManager>
+
+ListerFile::ListerFile(QObject *parent) : QObject(parent), _mappable(false), _map(0), _mapSize(0), _size(0),
+        _useCounter(0), _remote(false), _remoteOpened(false), _remoteJob(0), _readingPage(-1), _lastPage(0),
+        _direction(1)
+{
+    for (int i = 0; i != WINDOW_COUNT; i++) {
+        _windows[i].data = 0;
+        _windows[i].pos = 0;
+        _windows[i].size = 0;
+        _windows[i].lastUse = 0;
+    }
+}
+
+ListerFile::~ListerFile()
+{
+    close();
+    for (int i = 0; i != WINDOW_COUNT; i++)
+        delete []_windows[i].data;
+}
+
+bool ListerFile::open(const QString &path, bool mappable)
+{
+    close();
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return false;
+
+    _size = _file.size();
+    _mappable = mappable && QFileInfo(path).isFile();
+    if (_mappable)
+        map(_size);
+    return true;
+}
+
+bool ListerFile::openRemote(const QUrl &url)
+{
+    close();
+
+    if (!KProtocolManager::supportsOpening(url))
+        return false;
+
+    _remote = true;
+    _remoteJob = KIO::open(url, QIODevice::ReadOnly);
+    connect(_remoteJob, SIGNAL(open(KIO::Job *)), this, SLOT(slotRemoteOpen(KIO::Job *)));
+    connect(_remoteJob, SIGNAL(position(KIO::Job *, KIO::filesize_t)),
+            this, SLOT(slotRemotePosition(KIO::Job *, KIO::filesize_t)));
+    connect(_remoteJob, SIGNAL(data(KIO::Job *, const QByteArray &)),
+            this, SLOT(slotRemoteData(KIO::Job *, const QByteArray &)));
+    connect(_remoteJob, SIGNAL(result(KJob *)), this, SLOT(slotRemoteResult(KJob *)));
+    return true;
+}
+
+void ListerFile::close()
+{
+    unmap();
+    dropWindows();
+    if (_file.isOpen())
+        _file.close();
+    _mappable = false;
+    _size = 0;
+
+    if (_remoteJob != 0) {
+        KIO::FileJob *job = _remoteJob;
+        _remoteJob = 0;
+        job->disconnect(this);
+        job->kill();
+    }
+    _remote = false;
+    _remoteOpened = false;
+    _pages.clear();
+    _pendingPages.clear();
+    _demandedPages.clear();
+    _readingPage = -1;
+    _readBuffer.clear();
+    _lastPage = 0;
+    _direction = 1;
+}
+
+void ListerFile::resize(qint64 size)
+{
+    if (!_file.isOpen())
+        return;
+
+    if (_mappable && size != _mapSize) {
+        // a file changing its size is being written, and it may be truncated again while the
+        // lister doesn't watch it: touching mapped pages behind its end would raise SIGBUS,
+        // so it is read through the windows from now on
+        unmap();
+        _mappable = false;
+    }
+    // the windows of a growing file remain valid, the last one is reread when it is needed
+    if (size < _size)
+        dropWindows();
+    _size = size;
+}
+
+const char * ListerFile::data(qint64 pos, int &size)
+{
+    if (_map != 0) {
+        if (pos >= _mapSize)
+            return 0;
+        if (_mapSize - pos < size)
+            size = _mapSize - pos;
+        return (const char *)_map + pos;
+    }
+
+    if (!_file.isOpen() && !_remote)
+        return 0;
+
+    Window *window = 0;
+    for (int i = 0; i != WINDOW_COUNT; i++) {
+        Window &w = _windows[i];
+        if (w.size > 0 && pos >= w.pos && pos + size <= w.pos + w.size) {
+            w.lastUse = ++_useCounter;
+            window = &w;
+            break;
+        }
+    }
+
+    if (_remote)
+        return remoteData(window, pos, size);
+    if (window != 0)
+        return window->data + (pos - window->pos);
+
+    // the window starts a bit before the requested position, as the lister also scrolls backwards
+    qint64 windowPos = pos - WINDOW_SIZE * 2 / 5;
+    if (windowPos < 0)
+        windowPos = 0;
+
+    window = leastRecentlyUsedWindow();
+
+    qint64 bytes = -1;
+    if (_file.seek(windowPos))
+        bytes = _file.read(window->data, WINDOW_SIZE);
+    if (bytes == -1) {
+        window->size = 0;
+        window->lastUse = 0;
+        return 0;
+    }
+
+    window->pos = windowPos;
+    window->size = bytes;
+    window->lastUse = ++_useCounter;
+
+    int available = window->size - (pos - window->pos);
+    if (available <= 0)
+        return 0;
+    if (available < size)
+        size = available;
+    return window->data + (pos - window->pos);
+}
+
+bool ListerFile::isReplaced(const QString &path)
+{
+    if (!_file.isOpen())
+        return false;
+
+    QT_STATBUF opened, current;
+    if (QT_FSTAT(_file.handle(), &opened) != 0 || QT_STAT(QFile::encodeName(path).constData(), &current) != 0)
+        return false;
+    return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+}
+
+ListerFile::Window * ListerFile::leastRecentlyUsedWindow()
+{
+    Window *window = &_windows[ 0 ];
+    for (int i = 1; i != WINDOW_COUNT; i++)
+        if (_windows[ i ].lastUse < window->lastUse)
+            window = &_windows[ i ];
+
+    if (window->data == 0)
+        window->data = new char [ WINDOW_SIZE ];
+    return window;
+}
+
+const char * ListerFile::remoteData(Window *window, qint64 pos, int &size)
+{
+    if (pos >= _size)
+        return 0;
+
+    qint64 page = pos / PAGE_SIZE;
+    if (page != _lastPage)
+        _direction = (page > _lastPage) ? 1 : -1;
+    _lastPage = page;
+
+    // keep reading ahead in the direction the lister moves
+    for (int i = 1; i <= PREFETCH_PAGES; i++)
+        requestPage(page + i * _direction, false);
+
+    if (window != 0)
+        return window->data + (pos - window->pos);
+
+    if (!_pages.contains(page)) {
+        requestPage(page, true);
+        return 0;
+    }
+
+    // the window is assembled from the cached pages around the position
+    qint64 windowPos = pos - WINDOW_SIZE * 2 / 5;
+    if (windowPos < 0)
+        windowPos = 0;
+    qint64 firstPage = page;
+    while (firstPage > windowPos / PAGE_SIZE && _pages.contains(firstPage - 1))
+        firstPage--;
+    if (windowPos < firstPage * PAGE_SIZE)
+        windowPos = firstPage * PAGE_SIZE;
+
+    window = leastRecentlyUsedWindow();
+    window->pos = windowPos;
+    window->size = 0;
+    window->lastUse = ++_useCounter;
+
+    for (qint64 p = firstPage; window->size < WINDOW_SIZE; p++) {
+        QHash<qint64, Page>::iterator it = _pages.find(p);
+        if (it == _pages.end()) {
+            if (p * PAGE_SIZE < pos + size && p * PAGE_SIZE < _size)
+                requestPage(p, true);
+            break;
+        }
+        it->lastUse = ++_useCounter;
+
+        qint64 from = window->pos + window->size - p * PAGE_SIZE;
+        int bytes = qMin((qint64)WINDOW_SIZE - window->size, (qint64)it->data.size() - from);
+        if (bytes <= 0)
+            break;
+        memcpy(window->data + window->size, it->data.constData() + from, bytes);
+        window->size += bytes;
+        if (it->data.size() < PAGE_SIZE)
+            break;
+    }
+
+    int available = window->size - (pos - window->pos);
+    if (available <= 0)
+        return 0;
+    if (available < size)
+        size = available;
+    return window->data + (pos - window->pos);
+}
+
+void ListerFile::requestPage(qint64 page, bool demanded)
+{
+    if (page < 0 || (_remoteOpened && page * PAGE_SIZE >= _size))
+        return;
+
+    QHash<qint64, Page>::iterator it = _pages.find(page);
+    if (it != _pages.end()) {
+        it->lastUse = ++_useCounter;
+        return;
+    }
+
+    if (demanded) {
+        _demandedPages.insert(page);
+        if (page == _readingPage)
+            return;
+        _pendingPages.removeAll(page);
+        _pendingPages.prepend(page);
+    } else if (page != _readingPage && !_pendingPages.contains(page))
+        _pendingPages.append(page);
+
+    // forget the oldest requests if the lister moved on quickly
+    while (_pendingPages.count() > MAX_PENDING)
+        _demandedPages.remove(_pendingPages.takeLast());
+
+    readNextPage();
+}
+
+void ListerFile::readNextPage()
+{
+    if (_remoteJob == 0 || !_remoteOpened || _readingPage != -1 || _pendingPages.isEmpty())
+        return;
+
+    _readingPage = _pendingPages.takeFirst();
+    _readBuffer.clear();
+    _remoteJob->seek((KIO::filesize_t)_readingPage * PAGE_SIZE);
+}
+
+void ListerFile::slotRemoteOpen(KIO::Job *)
+{
+    _remoteOpened = true;
+    _size = _remoteJob->size();
+
+    emit dataReceived();
+    readNextPage();
+}
+
+void ListerFile::slotRemotePosition(KIO::Job *, KIO::filesize_t)
+{
+    if (_readingPage == -1)
+        return;
+    qint64 bytes = qMin((qint64)PAGE_SIZE, _size - _readingPage * PAGE_SIZE);
+    _remoteJob->read(bytes);
+}
+
+void ListerFile::slotRemoteData(KIO::Job *, const QByteArray &data)
+{
+    if (_readingPage == -1)
+        return;
+
+    _readBuffer += data;
+    qint64 expected = qMin((qint64)PAGE_SIZE, _size - _readingPage * PAGE_SIZE);
+    if (!data.isEmpty() && _readBuffer.size() < expected) {
+        _remoteJob->read(expected - _readBuffer.size());
+        return;
+    }
+
+    if (_pages.count() >= PAGE_COUNT) {
+        QHash<qint64, Page>::iterator oldest = _pages.begin();
+        for (QHash<qint64, Page>::iterator it = _pages.begin(); it != _pages.end(); ++it)
+            if (it->lastUse < oldest->lastUse)
+                oldest = it;
+        _pages.erase(oldest);
+    }
+
+    Page &page = _pages[ _readingPage ];
+    page.data = _readBuffer;
+    page.lastUse = ++_useCounter;
+    _readBuffer.clear();
+
+    bool demanded = _demandedPages.remove(_readingPage);
+    _readingPage = -1;
+
+    if (demanded)
+        emit dataReceived();
+    readNextPage();
+}
+
+void ListerFile::slotRemoteResult(KJob *job)
+{
+    if (job != _remoteJob)
+        return;
+
+    bool opened = _remoteOpened;
+    _remoteJob = 0;
+    _readingPage = -1;
+    _pendingPages.clear();
+    _demandedPages.clear();
+
+    if (job->error())
+        emit remoteFailed(opened, job->errorString());
+}
+
+bool ListerFile::map(qint64 size)
+{
+    if (size <= 0)
+        return false;
+    _map = _file.map(0, size);
+    _mapSize = _map ? size : 0;
+    if (_map != 0)
+        dropWindows();
+    return _map != 0;
+}
+
+void ListerFile::unmap()
+{
+    if (_map != 0)
+        _file.unmap(_map);
+    _map = 0;
+    _mapSize = 0;
+}
+
+void ListerFile::dropWindows()
+{
+    for (int i = 0; i != WINDOW_COUNT; i++) {
+        _windows[i].size = 0;
+        _windows[i].lastUse = 0;
+    }
+}
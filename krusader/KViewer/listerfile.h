@@ -0,0 +1,154 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef LISTERFILE_H
+#define LISTERFILE_H
+
+// QtCore
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+
+#include <KIO/Global>
+
+class KJob;
+namespace KIO
+{
+class FileJob;
+class Job;
+}
+
+/**
+ * The content of the file shown by the lister.
+ *
+ * Local regular files are mapped into the memory as a whole, so any part of them can be reached
+ * without reading. The other local files (the temporary copy of a downloaded file, files which
+ * can't be mapped, and mapped files found to change their size) are read through a few cached
+ * windows, using one file descriptor which is kept open until the next file is opened.
+ *
+ * Remote files of protocols supporting random access are not downloaded: only the pages which are
+ * asked for are read, and a few pages ahead in the direction the lister moves. The pages are kept
+ * in a bounded cache. A request for a missing page returns what is available and the page is read
+ * in the background; dataReceived() is emitted when it arrives.
+ *
+ * The pointers returned by data() remain valid until the file is reopened or resized, or - for
+ * unmapped files - until WINDOW_COUNT other windows have been read.
+ */
+class ListerFile : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum {
+        WINDOW_SIZE    = 100000,
+        WINDOW_COUNT   = 8,
+        PAGE_SIZE      = 65536,
+        PAGE_COUNT     = 256,
+        PREFETCH_PAGES = 4,
+        MAX_PENDING    = 16
+    };
+
+    explicit ListerFile(QObject *parent = 0);
+    ~ListerFile();
+
+    /// opens the file, @p mappable allows mapping it if it is a regular file
+    bool          open(const QString &path, bool mappable);
+    /// opens a remote file for random access, returns false if the protocol doesn't support it
+    bool          openRemote(const QUrl &url);
+    void          close();
+    /// adapts to the new size of the file: unmaps it, or drops the windows if it was truncated
+    void          resize(qint64 size);
+    /// returns @p size bytes from @p pos, @p size is reduced to the number of bytes available
+    const char *  data(qint64 pos, int &size);
+    /// true if @p path refers to another file than the opened one (e.g. a rotated log)
+    bool          isReplaced(const QString &path);
+
+    inline qint64 size() {
+        return _size;
+    }
+    inline bool   isMapped() {
+        return _map != 0;
+    }
+    inline bool   isRemote() {
+        return _remote;
+    }
+    /// true while pages of a remote file are waiting to be read
+    inline bool   isPending() {
+        return _remote && _remoteJob != 0 && (!_remoteOpened || _readingPage != -1 || !_pendingPages.isEmpty());
+    }
+
+signals:
+    void          dataReceived();
+    /// the remote file couldn't be read, @p opened tells whether the failure happened after opening it
+    void          remoteFailed(bool opened, const QString &error);
+
+protected slots:
+    void          slotRemoteOpen(KIO::Job *);
+    void          slotRemotePosition(KIO::Job *, KIO::filesize_t);
+    void          slotRemoteData(KIO::Job *, const QByteArray &);
+    void          slotRemoteResult(KJob *);
+
+private:
+    ListerFile(const ListerFile &);
+    ListerFile &operator=(const ListerFile &);
+
+    struct Window {
+        char     *data;
+        qint64    pos;
+        int       size;
+        quint64   lastUse;
+    };
+
+    struct Page {
+        QByteArray data;
+        quint64    lastUse;
+    };
+
+    bool          map(qint64 size);
+    void          unmap();
+    void          dropWindows();
+    Window *      leastRecentlyUsedWindow();
+    const char *  remoteData(Window *window, qint64 pos, int &size);
+    void          requestPage(qint64 page, bool demanded);
+    void          readNextPage();
+
+    QFile         _file;
+    bool          _mappable;
+    uchar        *_map;
+    qint64        _mapSize;
+    qint64        _size;
+    Window        _windows[WINDOW_COUNT];
+    quint64       _useCounter;
+
+    bool          _remote;
+    bool          _remoteOpened;
+    KIO::FileJob *_remoteJob;
+    QHash<qint64, Page> _pages;
+    QList<qint64> _pendingPages;    // demanded pages first, then the prefetched ones
+    QSet<qint64>  _demandedPages;
+    qint64        _readingPage;
+    QByteArray    _readBuffer;
+    qint64        _lastPage;
+    int           _direction;
+};
+
+#endif /* LISTERFILE_H */
@@ -0,0 +1,164 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "listerlineindex.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// QtCore
+#include <QFile>
+#include <QMutexLocker>
+
+#define  INDEX_READ_SIZE    (1024 * 1024)
+
+ListerLineIndex::ListerLineIndex() : _indexedSize(0), _lineCount(0), _targetSize(0), _stop(0)
+{
+    _checkpoints << 0;
+}
+
+ListerLineIndex::~ListerLineIndex()
+{
+    stop();
+}
+
+void ListerLineIndex::reset(const QString &path, qint64 fileSize)
+{
+    stop();
+
+    _path = path;
+    _checkpoints.clear();
+    _checkpoints << 0;
+    _indexedSize = 0;
+    _lineCount = 0;
+    _targetSize = fileSize;
+
+    if (fileSize > 0)
+        start(QThread::LowPriority);
+}
+
+void ListerLineIndex::update(qint64 fileSize)
+{
+    if (_path.isEmpty())
+        return;
+
+    if (fileSize < indexedSize()) {
+        reset(_path, fileSize);
+        return;
+    }
+
+    {
+        QMutexLocker locker(&_mutex);
+        _targetSize = fileSize;
+    }
+    // a finished thread is restarted, a running one reads the new target before each block
+    if (fileSize > indexedSize() && !isRunning())
+        start(QThread::LowPriority);
+}
+
+void ListerLineIndex::stop()
+{
+    _stop.store(1);
+    wait();
+    _stop.store(0);
+}
+
+qint64 ListerLineIndex::indexedSize() const
+{
+    QMutexLocker locker(&_mutex);
+    return _indexedSize;
+}
+
+qint64 ListerLineIndex::lineCount() const
+{
+    QMutexLocker locker(&_mutex);
+    return _lineCount;
+}
+
+bool ListerLineIndex::isComplete(qint64 fileSize) const
+{
+    QMutexLocker locker(&_mutex);
+    return _indexedSize >= fileSize;
+}
+
+qint64 ListerLineIndex::checkpointBefore(qint64 pos, qint64 &line) const
+{
+    QMutexLocker locker(&_mutex);
+    int ndx = std::upper_bound(_checkpoints.constBegin(), _checkpoints.constEnd(), pos) - _checkpoints.constBegin() - 1;
+    if (ndx < 0)
+        ndx = 0;
+    line = (qint64)ndx * LINES_PER_CHECKPOINT;
+    return _checkpoints[ ndx ];
+}
+
+qint64 ListerLineIndex::checkpointOfLine(qint64 line, qint64 &checkpointLine) const
+{
+    QMutexLocker locker(&_mutex);
+    if (line < 0 || line > _lineCount)
+        return -1;
+    qint64 ndx = line / LINES_PER_CHECKPOINT;
+    if (ndx >= _checkpoints.count())
+        ndx = _checkpoints.count() - 1;
+    checkpointLine = ndx * LINES_PER_CHECKPOINT;
+    return _checkpoints[ ndx ];
+}
+
+void ListerLineIndex::run()
+{
+    QFile file(_path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return;
+
+    qint64 pos, lines, target;
+    {
+        QMutexLocker locker(&_mutex);
+        pos = _indexedSize;
+        lines = _lineCount;
+        target = _targetSize;
+    }
+    if (!file.seek(pos))
+        return;
+
+    QByteArray buffer(INDEX_READ_SIZE, 0);
+    QVector<qint64> checkpoints;
+
+    while (pos < target && !_stop.load()) {
+        qint64 bytes = file.read(buffer.data(), qMin((qint64)INDEX_READ_SIZE, target - pos));
+        if (bytes <= 0)
+            break;
+
+        // memchr is vectorized by the C library, it is much faster than comparing byte by byte
+        const char *begin = buffer.constData();
+        const char *end = begin + bytes;
+        const char *p = begin;
+        while ((p = (const char *)memchr(p, '\n', end - p)) != 0) {
+            ++p;
+            if (++lines % LINES_PER_CHECKPOINT == 0)
+                checkpoints << pos + (p - begin);
+        }
+        pos += bytes;
+
+        QMutexLocker locker(&_mutex);
+        _checkpoints += checkpoints;
+        _indexedSize = pos;
+        _lineCount = lines;
+        target = _targetSize;
+        checkpoints.clear();
+    }
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef LISTERLINEINDEX_H
+#define LISTERLINEINDEX_H
+
+// QtCore
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+/**
+ * Sparse index of the line starts of the file shown by the lister, built in the background.
+ *
+ * The thread counts the '\n' bytes of the file and remembers where every LINES_PER_CHECKPOINT-th
+ * line starts, so any line can be found by scanning at most LINES_PER_CHECKPOINT lines from the
+ * nearest checkpoint. The index grows with the file; it is only meaningful for the encodings
+ * which store the newline as a single '\n' byte.
+ */
+class ListerLineIndex : public QThread
+{
+public:
+    enum {
+        LINES_PER_CHECKPOINT = 1024
+    };
+
+    ListerLineIndex();
+    ~ListerLineIndex();
+
+    /// drops the index and starts indexing the file at @p path
+    void            reset(const QString &path, qint64 fileSize);
+    /// continues indexing the grown file, or indexes it again if it was truncated
+    void            update(qint64 fileSize);
+    void            stop();
+
+    qint64          indexedSize() const;
+    /// the number of newlines in the indexed part of the file
+    qint64          lineCount() const;
+    bool            isComplete(qint64 fileSize) const;
+
+    /// returns the start of the last checkpoint at or before @p pos, @p line receives its line number
+    qint64          checkpointBefore(qint64 pos, qint64 &line) const;
+    /// returns the start of the last checkpoint before @p line, or -1 if the line isn't indexed yet
+    qint64          checkpointOfLine(qint64 line, qint64 &checkpointLine) const;
+
+protected:
+    virtual void    run() Q_DECL_OVERRIDE;
+
+private:
+    mutable QMutex  _mutex;
+    QString         _path;
+    QVector<qint64> _checkpoints;   // the start of the line (i * LINES_PER_CHECKPOINT)
+    qint64          _indexedSize;
+    qint64          _lineCount;
+    qint64          _targetSize;
+    QAtomicInt      _stop;
+};
+
+#endif /* LISTERLINEINDEX_H */
@@ -0,0 +1,231 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "listersearch.h"
+
+#include <string.h>
+
+// QtCore
+#include <QFile>
+#include <QMutexLocker>
+
+#define  SEARCH_BLOCK_SIZE  (1024 * 1024)
+
+ListerSearch::ListerSearch() : _fileSize(0), _caseSensitive(true), _wholeWord(false), _forward(true), _from(0),
+        _position(0), _result(-1), _stop(0)
+{
+}
+
+ListerSearch::~ListerSearch()
+{
+    stop();
+}
+
+void ListerSearch::search(const QString &path, qint64 fileSize, const QByteArray &pattern, bool caseSensitive,
+                          bool wholeWord, bool forward, qint64 from)
+{
+    stop();
+
+    _path = path;
+    _fileSize = fileSize;
+    _caseSensitive = caseSensitive;
+    _wholeWord = wholeWord;
+    _forward = forward;
+    _from = from;
+    _position = from;
+    _result = -1;
+
+    for (int c = 0; c != 256; c++)
+        _fold[ c ] = (!caseSensitive && c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+
+    _pattern = pattern;
+    for (int i = 0; i != _pattern.size(); i++)
+        _pattern[ i ] = _fold[(uchar)_pattern[ i ] ];
+
+    const int len = _pattern.size();
+    for (int c = 0; c != 256; c++)
+        _skip[ c ] = _backSkip[ c ] = len;
+    for (int i = 0; i < len - 1; i++)
+        _skip[(uchar)_pattern[ i ] ] = len - 1 - i;
+    for (int i = len - 1; i > 0; i--)
+        _backSkip[(uchar)_pattern[ i ] ] = i;
+
+    if (len > 0)
+        start(QThread::LowPriority);
+}
+
+void ListerSearch::stop()
+{
+    _stop.store(1);
+    wait();
+    _stop.store(0);
+}
+
+qint64 ListerSearch::position() const
+{
+    QMutexLocker locker(&_mutex);
+    return _position;
+}
+
+qint64 ListerSearch::result() const
+{
+    QMutexLocker locker(&_mutex);
+    return _result;
+}
+
+void ListerSearch::setPosition(qint64 position)
+{
+    QMutexLocker locker(&_mutex);
+    _position = position;
+}
+
+void ListerSearch::run()
+{
+    QFile file(_path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return;
+
+    const int len = _pattern.size();
+    // the blocks overlap by the length of the pattern, so no occurrence is cut in two
+    QByteArray buffer(SEARCH_BLOCK_SIZE + len, 0);
+    char *data = buffer.data();
+
+    if (_forward) {
+        qint64 pos = _from;
+        while (pos + len <= _fileSize && !_stop.load()) {
+            qint64 toRead = qMin((qint64)buffer.size(), _fileSize - pos);
+            if (!file.seek(pos))
+                break;
+            qint64 bytes = file.read(data, toRead);
+            if (bytes < len)
+                break;
+
+            int ndx = indexIn(data, bytes, 0);
+            while (ndx != -1 && !isWordBoundary(data, bytes, ndx))
+                ndx = indexIn(data, bytes, ndx + 1);
+            if (ndx != -1) {
+                QMutexLocker locker(&_mutex);
+                _result = _position = pos + ndx;
+                return;
+            }
+
+            pos += bytes - len + 1;
+            setPosition(pos);
+        }
+    } else {
+        qint64 end = qMin(_from, _fileSize);
+        while (end >= len && !_stop.load()) {
+            qint64 start = qMax(end - buffer.size(), (qint64)0);
+            if (!file.seek(start))
+                break;
+            qint64 bytes = file.read(data, end - start);
+            if (bytes < end - start)
+                break;
+
+            int ndx = lastIndexIn(data, bytes, bytes - len);
+            while (ndx != -1 && !isWordBoundary(data, bytes, ndx))
+                ndx = lastIndexIn(data, bytes, ndx - 1);
+            if (ndx != -1) {
+                QMutexLocker locker(&_mutex);
+                _result = _position = start + ndx;
+                return;
+            }
+
+            if (start == 0)
+                break;
+            end = start + len - 1;
+            setPosition(end);
+        }
+    }
+}
+
+int ListerSearch::indexIn(const char *data, int size, int from) const
+{
+    const int len = _pattern.size();
+    const char *pattern = _pattern.constData();
+
+    if (_caseSensitive) {
+        // memchr is vectorized by the C library, the candidates are verified with memcmp
+        const char *p = data + from;
+        const char *end = data + size - len + 1;
+        while (p < end && (p = (const char *)memchr(p, pattern[ 0 ], end - p)) != 0) {
+            if (memcmp(p + 1, pattern + 1, len - 1) == 0)
+                return p - data;
+            ++p;
+        }
+        return -1;
+    }
+
+    // Boyer-Moore-Horspool on the folded bytes
+    const uchar *text = (const uchar *)data;
+    const int last = len - 1;
+    for (int pos = from; pos + last < size;) {
+        uchar c = _fold[ text[ pos + last ] ];
+        if (c == (uchar)pattern[ last ]) {
+            int i = last - 1;
+            while (i >= 0 && _fold[ text[ pos + i ] ] == (uchar)pattern[ i ])
+                i--;
+            if (i < 0)
+                return pos;
+        }
+        pos += _skip[ c ];
+    }
+    return -1;
+}
+
+int ListerSearch::lastIndexIn(const char *data, int size, int from) const
+{
+    const int len = _pattern.size();
+    const char *pattern = _pattern.constData();
+    const uchar *text = (const uchar *)data;
+
+    if (from > size - len)
+        from = size - len;
+    for (int pos = from; pos >= 0;) {
+        uchar c = _fold[ text[ pos ] ];
+        if (c == (uchar)pattern[ 0 ]) {
+            int i = 1;
+            while (i < len && _fold[ text[ pos + i ] ] == (uchar)pattern[ i ])
+                i++;
+            if (i == len)
+                return pos;
+        }
+        pos -= _backSkip[ c ];
+    }
+    return -1;
+}
+
+bool ListerSearch::isWordBoundary(const char *data, int size, int ndx) const
+{
+    if (!_wholeWord)
+        return true;
+
+    // only ASCII word characters are rejected here, the others are decided by the lister
+    const int after = ndx + _pattern.size();
+    if (ndx > 0) {
+        char c = data[ ndx - 1 ];
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')
+            return false;
+    }
+    if (after < size) {
+        char c = data[ after ];
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')
+            return false;
+    }
+    return true;
+}
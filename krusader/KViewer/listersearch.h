@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef LISTERSEARCH_H
+#define LISTERSEARCH_H
+
+// QtCore
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+/**
+ * Searches the bytes of an encoded pattern in the file shown by the lister, in the background.
+ *
+ * The thread reads the file in large blocks through its own descriptor and stops at the first
+ * (or, backwards, at the last) occurrence. ASCII letters can be matched case insensitively and
+ * hits which are obviously not whole words can be skipped; anything depending on the encoding
+ * is left to the lister, which decodes the row around the hit to confirm it.
+ */
+class ListerSearch : public QThread
+{
+public:
+    ListerSearch();
+    ~ListerSearch();
+
+    /**
+     * Starts a forward search for occurrences starting at or after @p from, or a backward one
+     * for occurrences ending at or before @p from.
+     */
+    void            search(const QString &path, qint64 fileSize, const QByteArray &pattern, bool caseSensitive,
+                           bool wholeWord, bool forward, qint64 from);
+    void            stop();
+
+    /// the position the search has reached
+    qint64          position() const;
+    /// the start of the occurrence found, or -1
+    qint64          result() const;
+
+protected:
+    virtual void    run() Q_DECL_OVERRIDE;
+
+private:
+    int             indexIn(const char *data, int size, int from) const;
+    int             lastIndexIn(const char *data, int size, int from) const;
+    bool            isWordBoundary(const char *data, int size, int ndx) const;
+    void            setPosition(qint64 position);
+
+    mutable QMutex  _mutex;
+    QString         _path;
+    qint64          _fileSize;
+    QByteArray      _pattern;       // folded to lower case if not case sensitive
+    bool            _caseSensitive;
+    bool            _wholeWord;
+    bool            _forward;
+    qint64          _from;
+    qint64          _position;
+    qint64          _result;
+    QAtomicInt      _stop;
+
+    uchar           _fold[ 256 ];
+    int             _skip[ 256 ];   // Horspool shifts for forward searching
+    int             _backSkip[ 256 ];// and for backward searching
+};
+
+#endif /* LISTERSEARCH_H */
@@ -29,17 +29,18 @@
  ***************************************************************************/
 
 #include "locate.h"
+#include "locateresults.h"
 #include "../kractions.h"
 #include "../krglobal.h"
 #include "../krslots.h"
 #include "../krusaderview.h"
 #include "../Panel/krpanel.h"
 #include "../Panel/panelfunc.h"
-#include "../GUI/krtreewidget.h"
 #include "../defaults.h"
 #include "../krservices.h"
 #include "../VFS/vfs.h"
 #include "../VFS/virt_vfs.h"
+#include "../VFS/krfileindex.h"
 #include "../KViewer/krviewer.h"
 #include "../panelmanager.h"
 #include "../kicons.h"
@@ -66,12 +67,11 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
-#include <QTreeWidget>
+#include <QTreeView>
 
 #include <KConfigCore/KConfig>
 #include <KCoreAddons/KProcess>
 #include <KI18n/KLocalizedString>
-#include <KIOCore/KFileItem>
 #include <KWidgetsAddons/KMessageBox>
 #include <KCoreAddons/KShell>
 #include <KTextWidgets/KFindDialog>
@@ -87,26 +87,22 @@
 #define COMPARE_ID                  96
 //////////////////////////////////////////////////////////
 
-class LocateListView : public KrTreeWidget
+class LocateListView : public QTreeView
 {
 public:
-    LocateListView(QWidget * parent) : KrTreeWidget(parent) {
+    LocateListView(QWidget * parent) : QTreeView(parent) {
         setAlternatingRowColors(true);
+        setRootIsDecorated(false);
+        setUniformRowHeights(true); // the rows are laid out without asking the model
+        setContextMenuPolicy(Qt::CustomContextMenu);
     }
 
-    void startDrag(Qt::DropActions supportedActs) {
+    void startDrag(Qt::DropActions supportedActs) Q_DECL_OVERRIDE {
         Q_UNUSED(supportedActs);
 
         QList<QUrl> urls;
-        QList<QTreeWidgetItem *> list = selectedItems() ;
-
-        QListIterator<QTreeWidgetItem *> it(list);
-
-        while (it.hasNext()) {
-            QTreeWidgetItem * item = it.next();
-
-            urls.push_back(QUrl::fromLocalFile(item->text(0)));
-        }
+        foreach(const QModelIndex &index, selectionModel()->selectedRows())
+            urls.push_back(QUrl::fromLocalFile(index.data().toString()));
 
         if (urls.count() == 0)
             return;
@@ -124,7 +120,7 @@ public:
 KProcess *  LocateDlg::updateProcess = 0;
 LocateDlg * LocateDlg::LocateDialog = 0;
 
-LocateDlg::LocateDlg() : QDialog(0), isFeedToListBox(false)
+LocateDlg::LocateDlg() : QDialog(0), isFeedToListBox(false), filter(0), locateProc(0)
 {
     setWindowTitle(i18n("Krusader::Locate"));
     setWindowModality(Qt::NonModal);
@@ -178,15 +174,20 @@ LocateDlg::LocateDlg() : QDialog(0), isFeedToListBox(false)
     caseSensitive->setChecked(group.readEntry("Case Sensitive", false));
     hbox2->addWidget(caseSensitive);
 
+    useFileIndex = new QCheckBox(i18n("Use Krusader's file index"), hboxWidget2);
+    useFileIndex->setChecked(KrFileIndex::isEnabled());
+    useFileIndex->setToolTip(i18n("Search in the folders indexed by Krusader instead of the database of 'locate'"));
+    hbox2->addWidget(useFileIndex);
+
     grid->addWidget(hboxWidget2, 1, 0);
 
     QFrame *line1 = new QFrame(this);
     line1->setFrameStyle(QFrame::HLine | QFrame::Sunken);
     grid->addWidget(line1, 2, 0);
 
+    resultModel = new LocateResultModel(this);
     resultList = new LocateListView(this);  // create the main container
-    resultList->setColumnCount(1);
-    resultList->setHeaderLabel(i18n("Results"));
+    resultList->setModel(resultModel);
 
     resultList->setColumnWidth(0, QFontMetrics(resultList->font()).width("W") * 60);
 
@@ -200,12 +201,12 @@ LocateDlg::LocateDlg() : QDialog(0), isFeedToListBox(false)
     resultList->setSelectionMode(QAbstractItemView::ExtendedSelection);
     resultList->setDragEnabled(true);
 
-    connect(resultList, SIGNAL(itemRightClicked(QTreeWidgetItem *, const QPoint &, int)),
-            this, SLOT(slotRightClick(QTreeWidgetItem *, const QPoint &)));
-    connect(resultList, SIGNAL(itemDoubleClicked(QTreeWidgetItem *, int)),
-            this, SLOT(slotDoubleClick(QTreeWidgetItem *)));
-    connect(resultList, SIGNAL(itemActivated(QTreeWidgetItem *, int)),
-            this, SLOT(slotDoubleClick(QTreeWidgetItem *)));
+    connect(resultList, SIGNAL(customContextMenuRequested(const QPoint &)),
+            this, SLOT(slotRightClick(const QPoint &)));
+    connect(resultList, SIGNAL(doubleClicked(const QModelIndex &)),
+            this, SLOT(slotDoubleClick(const QModelIndex &)));
+    connect(resultList, SIGNAL(activated(const QModelIndex &)),
+            this, SLOT(slotDoubleClick(const QModelIndex &)));
 
     grid->addWidget(resultList, 3, 0);
 
@@ -237,6 +238,11 @@ LocateDlg::LocateDlg() : QDialog(0), isFeedToListBox(false)
 
     updateButtons(false);
 
+    if (KrFileIndex::instance()->isBuilding()) {
+        connect(KrFileIndex::instance(), &KrFileIndex::rebuildFinished, this, &LocateDlg::indexUpdateFinished);
+        updateDbButton->setEnabled(false);
+    }
+
     if (updateProcess) {
         if (updateProcess->state() == QProcess::Running) {
             connect(updateProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(updateFinished()));
@@ -255,11 +261,40 @@ void LocateDlg::slotFeedStop()   /* The stop / feed to listbox button */
     if (isFeedToListBox)
         feedToListBox();
     else
-        locateProc->kill();
+        stopLocate();
+}
+
+void LocateDlg::stopLocate()
+{
+    if (locateProc && locateProc->state() != QProcess::NotRunning)
+        locateProc->kill(); // locateFinished() lets the filter process the received output
+    else if (filter)
+        filter->stop();
+}
+
+void LocateDlg::done(int r)
+{
+    // the results are not needed anymore, don't let locate run in the background
+    if (filter) {
+        if (locateProc)
+            locateProc->kill();
+        filter->stop();
+    }
+    QDialog::done(r);
 }
 
 void LocateDlg::slotUpdateDb()   /* The Update DB button */
 {
+    if (useFileIndex->isChecked()) {
+        KrFileIndex *index = KrFileIndex::instance();
+        if (!index->isBuilding()) {
+            connect(index, &KrFileIndex::rebuildFinished, this, &LocateDlg::indexUpdateFinished, Qt::UniqueConnection);
+            index->rebuild();
+            updateDbButton->setEnabled(false);
+        }
+        return;
+    }
+
     if (!updateProcess) {
         KConfigGroup group(krConfig, "Locate");
 
@@ -280,6 +315,12 @@ void LocateDlg::updateFinished()
     updateDbButton->setEnabled(true);
 }
 
+void LocateDlg::indexUpdateFinished()
+{
+    if (!updateProcess)
+        updateDbButton->setEnabled(true);
+}
+
 void LocateDlg::slotLocate()   /* The locate button */
 {
     locateSearchFor->addToHistory(locateSearchFor->currentText());
@@ -289,6 +330,14 @@ void LocateDlg::slotLocate()   /* The locate button */
     group.writeEntry("Don't Search In Path", dontSearchPath = dontSearchInPath->isChecked());
     group.writeEntry("Existing Files", onlyExist = existingFiles->isChecked());
     group.writeEntry("Case Sensitive", isCs = caseSensitive->isChecked());
+    group.writeEntry("Use Index", useIndex = useFileIndex->isChecked());
+    KrFileIndex::reloadConfig();
+    maxResults = group.readEntry("Max Results", _LocateMaxResults);
+
+    if (useIndex) {
+        locateInIndex();
+        return;
+    }
 
     if (!KrServices::cmdExist("locate")) {
         KMessageBox::error(0,
@@ -296,9 +345,7 @@ void LocateDlg::slotLocate()   /* The locate button */
         return;
     }
 
-    resultList->clear();
-    lastItem = 0;
-    remaining = "";
+    resultModel->clear();
 
     updateButtons(true);
 
@@ -307,6 +354,17 @@ void LocateDlg::slotLocate()   /* The locate button */
 
     qApp->processEvents(); //FIXME - whats's this for ?
 
+    pattern = locateSearchFor->currentText();
+    if (!pattern.startsWith('*'))
+        pattern = '*' + pattern;
+    if (!pattern.endsWith('*'))
+        pattern = pattern + '*';
+    startFilter(dontSearchPath);
+
+    if (locateProc) {
+        disconnect(locateProc, 0, this, 0);
+        locateProc->deleteLater();
+    }
     locateProc = new KProcess(this);
     locateProc->setOutputChannelMode(KProcess::SeparateChannels); // default is forwarding to the parent channels
     connect(locateProc, SIGNAL(readyReadStandardOutput()), SLOT(processStdout()));
@@ -317,31 +375,78 @@ void LocateDlg::slotLocate()   /* The locate button */
     *locateProc << KrServices::fullPathName("locate");
     if (!isCs)
         *locateProc << "-i";
-    *locateProc << (pattern = locateSearchFor->currentText());
-
-    if (!pattern.startsWith('*'))
-        pattern = '*' + pattern;
-    if (!pattern.endsWith('*'))
-        pattern = pattern + '*';
+    *locateProc << locateSearchFor->currentText();
 
     collectedErr = "";
     locateProc->start();
 }
 
-void LocateDlg::locateError()
+void LocateDlg::locateInIndex()
 {
-    if (locateProc->error() == QProcess::FailedToStart)
-        KMessageBox::error(krMainWindow, i18n("Error during the start of 'locate' process."));
+    KrFileIndex *index = KrFileIndex::instance();
+    if (index->isBuilding()) {
+        KMessageBox::information(this, i18n("The file index is being updated. Please try again when it is finished."));
+        return;
+    }
+    if (index->isEmpty()) {
+        KMessageBox::information(this, i18n("The file index has not been built yet. It will be built now, please try again when it is finished."));
+        slotUpdateDb();
+        return;
+    }
+
+    resultModel->clear();
+    updateButtons(true);
+    isFeedToListBox = false;
+    resultList->setFocus();
+
+    // the index matched the names already, the filter checks the existence only
+    startFilter(false);
+    const QStringList found = index->locate(locateSearchFor->currentText(), isCs, dontSearchPath);
+    filter->addData(found.join(QLatin1Char('\n')).toLocal8Bit());
+    filter->finish();
 }
 
-void LocateDlg::locateFinished()
+void LocateDlg::startFilter(bool nameOnly)
 {
-    if (locateProc->exitStatus() != QProcess::NormalExit || locateProc->exitStatus()) {
-        if (!collectedErr.isEmpty())
-            KMessageBox::error(krMainWindow, i18n("Locate produced the following error message:\n\n%1", collectedErr));
+    if (filter) {
+        disconnect(filter, 0, this, 0);
+        filter->stop();
+        connect(filter, SIGNAL(finished()), filter, SLOT(deleteLater()));
     }
 
-    if (resultList->topLevelItemCount() == 0) {
+    filter = new LocateFilter(pattern, isCs, nameOnly, onlyExist, this);
+    connect(filter, SIGNAL(found(const QStringList &)), this, SLOT(slotFound(const QStringList &)));
+    connect(filter, SIGNAL(finished()), this, SLOT(filterFinished()));
+    filter->start(QThread::LowPriority);
+}
+
+void LocateDlg::slotFound(const QStringList &paths)
+{
+    if (sender() != filter)
+        return;
+
+    const int room = maxResults - resultModel->rowCount();
+    if (maxResults <= 0 || paths.count() < room) {
+        resultModel->append(paths);
+        return;
+    }
+
+    // the limit is reached, the rest of the output is not needed
+    resultModel->append(paths.mid(0, room));
+    resultModel->setTruncated(true);
+    if (locateProc)
+        locateProc->kill();
+    filter->stop();
+}
+
+void LocateDlg::filterFinished()
+{
+    if (sender() != filter)
+        return;
+    filter->deleteLater();
+    filter = 0;
+
+    if (resultModel->rowCount() == 0) {
         locateSearchFor->setFocus();
         isFeedToListBox = false;
     } else {
@@ -351,53 +456,48 @@ void LocateDlg::locateFinished()
     updateButtons(false);
 }
 
-void LocateDlg::processStdout()
+void LocateDlg::locateError()
 {
-    remaining += QString::fromLocal8Bit(locateProc->readAllStandardOutput());
-
-    QStringList list = remaining.split('\n');
-    int items = list.size();
-
-    for (QStringList::Iterator it = list.begin(); it != list.end(); ++it) {
-        if (--items == 0 && !remaining.endsWith('\n'))
-            remaining = *it;
-        else {
-            if (dontSearchPath) {
-                QRegExp regExp(pattern, isCs ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard);
-                QString fileName = (*it).trimmed();
-                if (fileName.endsWith(QLatin1String("/")) && fileName != "/") {
-                    fileName.truncate(fileName.length() - 1);
-                }
-                fileName = fileName.mid(fileName.lastIndexOf('/') + 1);
-
-                if (!regExp.exactMatch(fileName))
-                    continue;
-            }
-            if (onlyExist) {
-                KFileItem file(QUrl::fromLocalFile((*it).trimmed()));
-                if (!file.isReadable())
-                    continue;
-            }
-
-            if (lastItem)
-                lastItem = new QTreeWidgetItem(resultList, lastItem);
-            else
-                lastItem = new QTreeWidgetItem(resultList);
-
-            lastItem->setText(0, *it);
-        }
+    if (locateProc->error() == QProcess::FailedToStart) {
+        KMessageBox::error(krMainWindow, i18n("Error during the start of 'locate' process."));
+        if (filter)
+            filter->finish();
     }
 }
 
+void LocateDlg::locateFinished()
+{
+    if (locateProc->exitStatus() != QProcess::NormalExit || locateProc->exitStatus()) {
+        if (!collectedErr.isEmpty())
+            KMessageBox::error(krMainWindow, i18n("Locate produced the following error message:\n\n%1", collectedErr));
+    }
+
+    // the buttons are updated by filterFinished() when the rest of the output is processed
+    if (filter)
+        filter->finish();
+    else
+        updateButtons(false);
+}
+
+void LocateDlg::processStdout()
+{
+    // splitting and filtering is done by the filter thread
+    const QByteArray data = locateProc->readAllStandardOutput();
+    if (filter)
+        filter->addData(data);
+}
+
 void LocateDlg::processStderr()
 {
     collectedErr += QString::fromLocal8Bit(locateProc->readAllStandardError());
 }
 
-void LocateDlg::slotRightClick(QTreeWidgetItem *item, const QPoint &pos)
+void LocateDlg::slotRightClick(const QPoint &point)
 {
-    if (!item)
+    const QModelIndex item = resultList->indexAt(point);
+    if (!item.isValid())
         return;
+    const QPoint pos = resultList->viewport()->mapToGlobal(point);
 
     // create the menu
     QMenu popup;
@@ -406,7 +506,7 @@ void LocateDlg::slotRightClick(QTreeWidgetItem *item, const QPoint &pos)
     QAction * actView = popup.addAction(i18n("View (F3)"));
     QAction * actEdit = popup.addAction(i18n("Edit (F4)"));
     QAction * actComp = popup.addAction(i18n("Compare by content (F10)"));
-    if (resultList->selectedItems().count() != 2)
+    if (resultList->selectionModel()->selectedRows().count() != 2)
         actComp->setEnabled(false);
     popup.addSeparator();
 
@@ -441,12 +541,12 @@ void LocateDlg::slotRightClick(QTreeWidgetItem *item, const QPoint &pos)
         operate(item, ret);
 }
 
-void LocateDlg::slotDoubleClick(QTreeWidgetItem *item)
+void LocateDlg::slotDoubleClick(const QModelIndex &item)
 {
-    if (!item)
+    if (!item.isValid())
         return;
 
-    QString dirName = item->text(0);
+    QString dirName = resultModel->path(item);
     QString fileName;
 
     if (!QDir(dirName).exists()) {
@@ -461,7 +561,7 @@ void LocateDlg::slotDoubleClick(QTreeWidgetItem *item)
 void LocateDlg::keyPressEvent(QKeyEvent *e)
 {
     if (KrGlobal::copyShortcut == QKeySequence(e->key() | e->modifiers())) {
-        operate(0, COPY_SELECTED_TO_CLIPBOARD);
+        operate(QModelIndex(), COPY_SELECTED_TO_CLIPBOARD);
         e->accept();
         return;
     }
@@ -474,38 +574,38 @@ void LocateDlg::keyPressEvent(QKeyEvent *e)
         }
         break;
     case Qt::Key_F3 :
-        if (resultList->currentItem())
-            operate(resultList->currentItem(), VIEW_ID);
+        if (resultList->currentIndex().isValid())
+            operate(resultList->currentIndex(), VIEW_ID);
         break;
     case Qt::Key_F4 :
-        if (resultList->currentItem())
-            operate(resultList->currentItem(), EDIT_ID);
+        if (resultList->currentIndex().isValid())
+            operate(resultList->currentIndex(), EDIT_ID);
         break;
     case Qt::Key_F10 :
-        operate(0, COMPARE_ID);
+        operate(QModelIndex(), COMPARE_ID);
         break;
     case Qt::Key_N :
         if (e->modifiers() == Qt::ControlModifier)
-            operate(resultList->currentItem(), FIND_NEXT_ID);
+            operate(resultList->currentIndex(), FIND_NEXT_ID);
         break;
     case Qt::Key_P :
         if (e->modifiers() == Qt::ControlModifier)
-            operate(resultList->currentItem(), FIND_PREV_ID);
+            operate(resultList->currentIndex(), FIND_PREV_ID);
         break;
     case Qt::Key_F :
         if (e->modifiers() == Qt::ControlModifier)
-            operate(resultList->currentItem(), FIND_ID);
+            operate(resultList->currentIndex(), FIND_ID);
         break;
     }
 
     QDialog::keyPressEvent(e);
 }
 
-void LocateDlg::operate(QTreeWidgetItem *item, int task)
+void LocateDlg::operate(const QModelIndex &item, int task)
 {
     QUrl name;
-    if (item != 0)
-        name = QUrl::fromLocalFile(item->text(0));
+    if (item.isValid())
+        name = QUrl::fromLocalFile(resultModel->path(item));
 
     switch (task) {
     case VIEW_ID:
@@ -515,12 +615,12 @@ void LocateDlg::operate(QTreeWidgetItem *item, int task)
         KrViewer::edit(name, this);   // view the file
         break;
     case COMPARE_ID: {
-        QList<QTreeWidgetItem *> list = resultList->selectedItems();
+        QModelIndexList list = resultList->selectionModel()->selectedRows();
         if (list.count() != 2)
             break;
 
-        QUrl url1 = QUrl::fromLocalFile(list[ 0 ]->text(0));
-        QUrl url2 = QUrl::fromLocalFile(list[ 1 ]->text(0));
+        QUrl url1 = QUrl::fromLocalFile(resultModel->path(list[ 0 ]));
+        QUrl url2 = QUrl::fromLocalFile(resultModel->path(list[ 1 ]));
 
         SLOTS->compareContent(url1, url2);
     }
@@ -547,15 +647,15 @@ void LocateDlg::operate(QTreeWidgetItem *item, int task)
         group.writeEntry("Find Options", (long long)(findOptions = dlg->options()));
         group.writeEntry("Find Patterns", list);
 
-        if (!(findOptions & KFind::FromCursor) && resultList->topLevelItemCount())
-            resultList->setCurrentItem((findOptions & KFind::FindBackwards) ?
-                                       resultList->topLevelItem(resultList->topLevelItemCount() - 1) : resultList->topLevelItem(0));
+        if (!(findOptions & KFind::FromCursor) && resultModel->rowCount())
+            resultList->setCurrentIndex(resultModel->index((findOptions & KFind::FindBackwards) ?
+                                                           resultModel->rowCount() - 1 : 0));
 
-        findCurrentItem = resultList->currentItem();
+        findCurrentRow = resultList->currentIndex().isValid() ? resultList->currentIndex().row() : -1;
 
-        if (find() && findCurrentItem) {
+        if (find()) {
             resultList->selectionModel()->clearSelection(); // HACK: QT 4 is not able to paint the focus frame because of a bug
-            resultList->setCurrentItem(findCurrentItem);
+            resultList->setCurrentIndex(resultModel->index(findCurrentRow));
         } else {
             KMessageBox::information(this, i18n("Search string not found."));
         }
@@ -570,12 +670,12 @@ void LocateDlg::operate(QTreeWidgetItem *item, int task)
         if (task == FIND_PREV_ID)
             findOptions ^= KFind::FindBackwards;
 
-        findCurrentItem = resultList->currentItem();
+        findCurrentRow = resultList->currentIndex().isValid() ? resultList->currentIndex().row() : -1;
         nextLine();
 
-        if (find() && findCurrentItem) {
+        if (find()) {
             resultList->selectionModel()->clearSelection(); // HACK: QT 4 is not able to paint the focus frame because of a bug
-            resultList->setCurrentItem(findCurrentItem);
+            resultList->setCurrentIndex(resultModel->index(findCurrentRow));
         } else
             KMessageBox::information(this, i18n("Search string not found."));
 
@@ -587,14 +687,8 @@ void LocateDlg::operate(QTreeWidgetItem *item, int task)
     break;
     case COPY_SELECTED_TO_CLIPBOARD: {
         QList<QUrl> urls;
-
-        QTreeWidgetItemIterator it(resultList);
-        while (*it) {
-            if ((*it)->isSelected())
-                urls.push_back(QUrl::fromLocalFile((*it)->text(0)));
-
-            it++;
-        }
+        foreach(const QModelIndex &index, resultList->selectionModel()->selectedRows())
+            urls.push_back(QUrl::fromLocalFile(resultModel->path(index)));
 
         if (urls.count() == 0)
             return;
@@ -611,16 +705,18 @@ void LocateDlg::operate(QTreeWidgetItem *item, int task)
 
 void LocateDlg::nextLine()
 {
+    if (findCurrentRow < 0)
+        return;
     if (findOptions & KFind::FindBackwards)
-        findCurrentItem = resultList->itemAbove(findCurrentItem);
-    else
-        findCurrentItem = resultList->itemBelow(findCurrentItem);
+        --findCurrentRow;
+    else if (++findCurrentRow >= resultModel->rowCount())
+        findCurrentRow = -1;
 }
 
 bool LocateDlg::find()
 {
-    while (findCurrentItem) {
-        QString item = findCurrentItem->text(0);
+    while (findCurrentRow >= 0) {
+        const QString &item = resultModel->paths()[findCurrentRow];
 
         if (findOptions & KFind::RegularExpression) {
             if (item.contains(QRegExp(findPattern, ((findOptions & KFind::CaseSensitive) != 0) ? Qt::CaseSensitive : Qt::CaseInsensitive)))
@@ -659,12 +755,8 @@ void LocateDlg::feedToListBox()
     }
 
     QList<QUrl> urlList;
-    QTreeWidgetItemIterator it(resultList);
-    while (*it) {
-        QTreeWidgetItem * item = *it;
-        urlList.push_back(QUrl::fromLocalFile(item->text(0)));
-        it++;
-    }
+    for (const QString &path : resultModel->paths())
+        urlList.push_back(QUrl::fromLocalFile(path));
     QUrl url = QUrl(QStringLiteral("virt:/") + queryName);
     virtVfs.refresh(url);
     virtVfs.addFiles(urlList);
@@ -688,7 +780,7 @@ void LocateDlg::updateButtons(bool locateIsRunning)
         feedStopButton->setText(i18n("Stop"));
         feedStopButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
     } else {
-        if (resultList->topLevelItemCount() == 0) {
+        if (resultModel->rowCount() == 0) {
             feedStopButton->setEnabled(false);
             feedStopButton->setText(i18n("Stop"));
             feedStopButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
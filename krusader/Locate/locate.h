@@ -41,8 +41,10 @@
 #include <KCompletion/KHistoryComboBox>
 
 class KProcess;
-class KrTreeWidget;
-class QTreeWidgetItem;
+class LocateFilter;
+class LocateResultModel;
+class QModelIndex;
+class QTreeView;
 
 class LocateDlg : public QDialog
 {
@@ -66,18 +68,25 @@ public slots:
     void              processStderr();
     void              locateFinished();
     void              locateError();
-    void              slotRightClick(QTreeWidgetItem *, const QPoint &);
-    void              slotDoubleClick(QTreeWidgetItem *);
+    void              slotFound(const QStringList &paths);
+    void              filterFinished();
+    void              slotRightClick(const QPoint &);
+    void              slotDoubleClick(const QModelIndex &);
     void              updateFinished();
+    void              indexUpdateFinished();
 
 protected:
     void              keyPressEvent(QKeyEvent *) Q_DECL_OVERRIDE;
+    void              done(int r) Q_DECL_OVERRIDE;
 
 private:
-    void              operate(QTreeWidgetItem *item, int task);
+    void              operate(const QModelIndex &item, int task);
+    void              startFilter(bool nameOnly);
+    void              stopLocate();
 
     bool              find();
     void              nextLine();
+    void              locateInIndex();
 
     void              updateButtons(bool locateIsRunning);
 
@@ -85,25 +94,28 @@ private:
     bool              dontSearchPath;
     bool              onlyExist;
     bool              isCs;
+    bool              useIndex;
 
     bool              isFeedToListBox;
 
     QString           pattern;
 
     KHistoryComboBox *locateSearchFor;
-    KrTreeWidget     *resultList;
-    QString           remaining;
-    QTreeWidgetItem  *lastItem;
+    QTreeView        *resultList;
+    LocateResultModel *resultModel;
+    LocateFilter     *filter;
+    int               maxResults;
 
     QString           collectedErr;
 
     long              findOptions;
     QString           findPattern;
-    QTreeWidgetItem  *findCurrentItem;
+    int               findCurrentRow;
 
     QCheckBox        *dontSearchInPath;
     QCheckBox        *existingFiles;
     QCheckBox        *caseSensitive;
+    QCheckBox        *useFileIndex;
 
     QPushButton      *feedStopButton;
     QPushButton      *updateDbButton;
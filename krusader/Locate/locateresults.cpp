@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "locateresults.h"
+
+// QtCore
+#include <QMutexLocker>
+
+#include <qplatformdefs.h>
+
+#include <KI18n/KLocalizedString>
+
+LocateResultModel::LocateResultModel(QObject *parent) : QAbstractListModel(parent), _truncated(false)
+{
+}
+
+int LocateResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : _paths.count();
+}
+
+QVariant LocateResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= _paths.count())
+        return QVariant();
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole)
+        return _paths[index.row()];
+    return QVariant();
+}
+
+QVariant LocateResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (section != 0 || orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    if (_truncated)
+        return i18np("Results (only the first %1 is shown)", "Results (only the first %1 are shown)",
+                     _paths.count());
+    return i18n("Results");
+}
+
+Qt::ItemFlags LocateResultModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags itemFlags = QAbstractListModel::flags(index);
+    if (index.isValid())
+        itemFlags |= Qt::ItemIsDragEnabled;
+    return itemFlags;
+}
+
+void LocateResultModel::clear()
+{
+    beginResetModel();
+    _paths.clear();
+    _truncated = false;
+    endResetModel();
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+}
+
+void LocateResultModel::append(const QStringList &paths)
+{
+    if (paths.isEmpty())
+        return;
+    beginInsertRows(QModelIndex(), _paths.count(), _paths.count() + paths.count() - 1);
+    _paths.append(paths);
+    endInsertRows();
+}
+
+void LocateResultModel::setTruncated(bool truncated)
+{
+    _truncated = truncated;
+    emit headerDataChanged(Qt::Horizontal, 0, 0);
+}
+
+LocateFilter::LocateFilter(const QString &pattern, bool caseSensitive, bool nameOnly, bool onlyExisting,
+                           QObject *parent) :
+    QThread(parent),
+    nameRegExp(pattern, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard),
+    nameOnly(nameOnly), onlyExisting(onlyExisting), finished(false)
+{
+}
+
+void LocateFilter::addData(const QByteArray &data)
+{
+    QMutexLocker locker(&mutex);
+    input.append(data);
+    dataAvailable.wakeOne();
+}
+
+void LocateFilter::finish()
+{
+    QMutexLocker locker(&mutex);
+    finished = true;
+    dataAvailable.wakeOne();
+}
+
+void LocateFilter::stop()
+{
+    QMutexLocker locker(&mutex);
+    stopped = 1;
+    dataAvailable.wakeOne();
+}
+
+void LocateFilter::run()
+{
+    QByteArray remaining;
+    forever {
+        QByteArray data;
+        bool last;
+        {
+            QMutexLocker locker(&mutex);
+            while (input.isEmpty() && !finished && !stopped)
+                dataAvailable.wait(&mutex);
+            data.swap(input);
+            last = finished && data.isEmpty();
+        }
+        if (stopped)
+            return;
+
+        if (!remaining.isEmpty())
+            data.prepend(remaining);
+        remaining.clear();
+
+        // the incomplete line at the end waits for the next chunk
+        int end = data.size();
+        if (!last) {
+            end = data.lastIndexOf('\n') + 1;
+            remaining = data.mid(end);
+        }
+
+        QStringList accepted;
+        int start = 0;
+        while (start < end && !stopped) {
+            int newline = data.indexOf('\n', start);
+            if (newline < 0 || newline > end)
+                newline = end;
+            const QByteArray line = data.mid(start, newline - start);
+            if (!line.isEmpty() && accept(line))
+                accepted << QString::fromLocal8Bit(line);
+            start = newline + 1;
+        }
+        if (!accepted.isEmpty() && !stopped)
+            emit found(accepted);
+
+        if (last)
+            return;
+    }
+}
+
+bool LocateFilter::accept(const QByteArray &line) const
+{
+    if (nameOnly) {
+        QString fileName = QString::fromLocal8Bit(line).trimmed();
+        if (fileName.endsWith(QLatin1Char('/')) && fileName != "/")
+            fileName.truncate(fileName.length() - 1);
+        fileName = fileName.mid(fileName.lastIndexOf('/') + 1);
+
+        if (!nameRegExp.exactMatch(fileName))
+            return false;
+    }
+    if (onlyExisting) {
+        if (QT_ACCESS(line.trimmed().constData(), R_OK) != 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef LOCATERESULTS_H
+#define LOCATERESULTS_H
+
+// QtCore
+#include <QAbstractListModel>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QRegExp>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+/**
+ * The paths found by locate. Only the visible rows are rendered by the view, the
+ * model itself holds nothing but the path strings.
+ */
+class LocateResultModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit LocateResultModel(QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    Qt::ItemFlags flags(const QModelIndex &index) const Q_DECL_OVERRIDE;
+
+    const QStringList &paths() const {
+        return _paths;
+    }
+    QString path(const QModelIndex &index) const {
+        return index.isValid() ? _paths[index.row()] : QString();
+    }
+
+    void clear();
+    void append(const QStringList &paths);
+    /// marks the result as cut at the configured maximum, shown in the header
+    void setTruncated(bool truncated);
+
+private:
+    QStringList _paths;
+    bool        _truncated;
+};
+
+/**
+ * Splits the output of locate into lines and filters them in a separate thread.
+ *
+ * The raw output is passed in with addData(), the accepted paths are sent back in batches
+ * with found(). The thread ends after finish() when all the data is processed, or at once
+ * after stop().
+ */
+class LocateFilter : public QThread
+{
+    Q_OBJECT
+
+public:
+    /// pattern is a wildcard matched against the file names if nameOnly is set
+    LocateFilter(const QString &pattern, bool caseSensitive, bool nameOnly, bool onlyExisting,
+                 QObject *parent = 0);
+
+    void addData(const QByteArray &data);
+    /// no more data will come, the thread ends when the rest is processed
+    void finish();
+    /// drops the unprocessed data and ends the thread
+    void stop();
+
+signals:
+    void found(const QStringList &paths);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    bool accept(const QByteArray &line) const;
+
+    const QRegExp  nameRegExp;
+    const bool     nameOnly;
+    const bool     onlyExisting;
+
+    QMutex         mutex;
+    QWaitCondition dataAvailable;
+    QByteArray     input;     // guarded by mutex
+    bool           finished;  // guarded by mutex
+    QAtomicInt     stopped;
+};
+
+#endif /* LOCATERESULTS_H */
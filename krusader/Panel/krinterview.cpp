@@ -284,6 +284,14 @@ KrViewItem* KrInterView::preAddItem(vfile *vf)
     return getKrViewItem(idx);
 }
 
+void KrInterView::preAddItems(const QList<vfile*> &vfiles)
+{
+    bool wasEmpty = _model->rowCount() == 0;
+    _model->appendItems(vfiles);
+    if (wasEmpty) // make the first item current, like preAddItem() does
+        _itemView->setCurrentIndex(_model->index(0, 0));
+}
+
 void KrInterView::preDelItem(KrViewItem *item)
 {
     setSelected(item->getVfile(), false);
@@ -95,6 +95,7 @@ protected:
     virtual KIO::filesize_t calcSelectedSize() Q_DECL_OVERRIDE;
     virtual void populate(const QList<vfile*> &vfiles, vfile *dummy) Q_DECL_OVERRIDE;
     virtual KrViewItem* preAddItem(vfile *vf) Q_DECL_OVERRIDE;
+    virtual void preAddItems(const QList<vfile*> &vfiles) Q_DECL_OVERRIDE;
     virtual void preDelItem(KrViewItem *item) Q_DECL_OVERRIDE;
     virtual void preUpdateItem(vfile *vf) Q_DECL_OVERRIDE;
     virtual void intSetSelected(const vfile* vf, bool select) Q_DECL_OVERRIDE;
@@ -359,6 +359,19 @@ QModelIndex KrVfsModel::addItem(vfile * vf)
     return index(insertIndex, 0);
 }
 
+void KrVfsModel::appendItems(const QList<vfile*> &files)
+{
+    if (files.isEmpty())
+        return;
+
+    int first = _vfiles.count();
+    beginInsertRows(QModelIndex(), first, first + files.count() - 1);
+    _vfiles.append(files);
+    for (int i = first; i < _vfiles.count(); ++i)
+        updateIndices(_vfiles[i], i);
+    endInsertRows();
+}
+
 QModelIndex KrVfsModel::removeItem(vfile * vf)
 {
     QModelIndex currIndex = _view->getCurrentIndex();
@@ -45,6 +45,8 @@ public:
     }
     void populate(const QList<vfile*> &files, vfile *dummy);
     QModelIndex addItem(vfile *);
+    /// appends the vfiles at the end, the sort order is restored by the next sort()
+    void appendItems(const QList<vfile*> &files);
     QModelIndex removeItem(vfile *);
     void updateItem(vfile *vf);
 
@@ -94,6 +94,11 @@ void KrViewOperator::fileAdded(vfile *vf)
     _view->addItem(vf);
 }
 
+void KrViewOperator::filesAdded(const QList<vfile *> &vfiles)
+{
+    _view->addItems(vfiles);
+}
+
 void KrViewOperator::fileUpdated(vfile *vf)
 {
     _view->updateItem(vf);
@@ -582,6 +587,32 @@ void KrView::addItem(vfile *vf)
     op()->emitSelectionChanged();
 }
 
+void KrView::addItems(const QList<vfile *> &vfiles)
+{
+    QList<vfile *> shown;
+    foreach(vfile *vf, vfiles) {
+        if (isFiltered(vf))
+            continue;
+        if (vf->vfile_isDir())
+            ++_numDirs;
+        ++_count;
+        shown << vf;
+    }
+    if (shown.isEmpty())
+        return;
+
+    preAddItems(shown);
+
+    if (_previews) {
+        foreach(vfile *vf, shown) {
+            if (KrViewItem *item = findItemByVfile(vf))
+                _previews->updatePreview(item);
+        }
+    }
+
+    op()->emitSelectionChanged();
+}
+
 void KrView::updateItem(vfile *vf)
 {
     if (isFiltered(vf))
@@ -1006,6 +1037,7 @@ void KrView::setFiles(VfileContainer *files)
     QObject::connect(_files, SIGNAL(refreshDone(bool)), op(), SLOT(startUpdate()));
     QObject::connect(_files, SIGNAL(cleared()), op(), SLOT(cleared()));
     QObject::connect(_files, SIGNAL(addedVfile(vfile*)), op(), SLOT(fileAdded(vfile*)));
+    QObject::connect(_files, SIGNAL(addedVfiles(QList<vfile*>)), op(), SLOT(filesAdded(QList<vfile*>)));
     QObject::connect(_files, SIGNAL(updatedVfile(vfile*)), op(), SLOT(fileUpdated(vfile*)));
 }
 
@@ -205,6 +205,7 @@ protected slots:
     void cleared();
 
     void fileAdded(vfile *vf);
+    void filesAdded(const QList<vfile *> &vfiles);
     void fileUpdated(vfile *vf);
 
 protected:
@@ -306,6 +307,8 @@ public:
 
 protected:
     virtual KrViewItem *preAddItem(vfile *vf) = 0;
+    /// appends the vfiles without sorting them, sort() has to be called afterwards
+    virtual void preAddItems(const QList<vfile *> &vfiles) = 0;
     virtual void preDelItem(KrViewItem *item) = 0;
     virtual void preUpdateItem(vfile *vf) = 0;
     virtual void copySettingsFrom(KrView *other) = 0;
@@ -314,6 +317,7 @@ protected:
     virtual void clear();
 
     void addItem(vfile *vf);
+    void addItems(const QList<vfile *> &vfiles);
     void updateItem(vfile *vf);
     void delItem(const QString &name);
 
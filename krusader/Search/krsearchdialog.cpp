@@ -104,15 +104,25 @@ public:
         _foundText.clear();
     }
 
-    void addItem(QString path, KIO::filesize_t size, time_t mtime, QString perm,
-                 uid_t uid, gid_t gid, QString foundText)
+    void addItems(const QList<KrSearchResult> &results)
     {
-        vfile *vf = new vfile(path, size, perm, mtime, false/*FIXME*/, false/*FIXME*/,
-                              uid, gid, QString(), QString(), 0, -1, QUrl::fromUserInput(path));
-        _vfiles << vf;
-        if(!foundText.isEmpty())
-            _foundText[vf] = foundText;
-        emit addedVfile(vf);
+        QList<vfile*> added;
+        added.reserve(results.count());
+        foreach(const KrSearchResult &res, results) {
+            QString where = res.dir;
+            where.replace(QRegExp("\\\\"), "#"); //FIXME ? why is that done ?
+            QString path = where.endsWith('/') ? (where + res.name) : (where + '/' + res.name);
+            if(res.perm[0] == 'd' && !path.endsWith('/')) // file is a directory
+                path += '/';
+
+            vfile *vf = new vfile(path, res.size, res.perm, res.mtime, false/*FIXME*/, false/*FIXME*/,
+                                  res.owner, res.group, QString(), QString(), 0, -1, QUrl::fromUserInput(path));
+            if(!res.foundText.isEmpty())
+                _foundText[vf] = res.foundText;
+            added << vf;
+        }
+        _vfiles << added;
+        emit addedVfiles(added);
     }
 
     QString foundText(const vfile *vf) {
@@ -383,14 +393,9 @@ void KrSearchDialog::resizeEvent(QResizeEvent *e)
     }
 }
 
-void KrSearchDialog::found(QString what, QString where, KIO::filesize_t size, time_t mtime, QString perm,
-                           uid_t uid, gid_t gid, QString foundText)
+void KrSearchDialog::found(const QList<KrSearchResult> &results)
 {
-    where = where.replace(QRegExp("\\\\"), "#"); //FIXME ? why is that done ?
-    QString path =  where.endsWith('/') ? (where + what) : (where + "/" + what);
-    if(perm[0] == 'd' && !path.endsWith('/')) // file is a directory
-        path += '/';
-    result->addItem(path, size, mtime, perm, uid, gid, foundText);
+    result->addItems(results);
     foundLabel->setText(i18np("Found %1 match.", "Found %1 matches.", result->numVfiles()));
 }
 
@@ -444,8 +449,7 @@ void KrSearchDialog::startSearch()
     searcher  = new KRSearchMod(query);
     connect(searcher, SIGNAL(searching(const QString&)),
             searchingLabel, SLOT(setText(const QString&)));
-    connect(searcher, SIGNAL(found(QString, QString, KIO::filesize_t, time_t, QString, uid_t, gid_t, QString)),
-            this, SLOT(found(QString, QString, KIO::filesize_t, time_t, QString, uid_t, gid_t, QString)));
+    connect(searcher, &KRSearchMod::found, this, &KrSearchDialog::found);
     connect(searcher, SIGNAL(finished()), this, SLOT(stopSearch()));
 
     searcher->start();
@@ -455,6 +459,9 @@ void KrSearchDialog::startSearch()
     delete searcher;
     searcher = 0;
 
+    // the results were appended unsorted, sort them once if the user picked a column meanwhile
+    resultView->sort();
+
     // gui stuff
     mainSearchBtn->setEnabled(true);
     mainCloseBtn->setEnabled(true);
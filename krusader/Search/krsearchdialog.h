@@ -68,8 +68,7 @@ public slots:
     void stopSearch();
     void feedToListBox();
     void copyToClipBoard();
-    void found(QString what, QString where, KIO::filesize_t size, time_t mtime, QString perm,
-               uid_t uid, gid_t gid, QString foundText);
+    void found(const QList<KrSearchResult> &results);
     void closeDialog(bool isAccept = true);
     void executed(const QString &name);
     void currentChanged(KrViewItem *item);
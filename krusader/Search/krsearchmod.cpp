@@ -31,6 +31,7 @@
 #include "krsearchmod.h"
 
 // QtCore
+#include <QCache>
 #include <QDir>
 #include <QMimeDatabase>
 #include <QMimeType>
@@ -39,17 +40,46 @@
 #include <QApplication>
 #include <qplatformdefs.h>
 
+#include <KConfigCore/KConfigGroup>
 #include <KIO/Global>
+#include <KIO/ListJob>
 
+#include "../defaults.h"
+#include "../krglobal.h"
+#include "../VFS/krfileindex.h"
 #include "../VFS/krquery.h"
 #include "../VFS/vfile.h"
 #include "../VFS/krpermhandler.h"
 #include "../Archive/krarchandler.h"
 
 #define  EVENT_PROCESS_DELAY     250
+#define  RESULT_BATCH_DELAY      50
+
+#define  ARCHIVE_CACHE_ENTRIES   500000
 
 extern KRarcHandler arcHandler;
 
+namespace {
+/// the listing of an archive, valid while the archive has the same time and size
+struct CachedArchiveListing {
+    time_t mtime;
+    KIO::filesize_t size;
+    KIO::UDSEntryList entries;
+};
+
+/// listings of the searched archives, shared by all searches and limited by the entry count
+QCache<QString, CachedArchiveListing> &archiveListingCache()
+{
+    static QCache<QString, CachedArchiveListing> cache(ARCHIVE_CACHE_ENTRIES);
+    return cache;
+}
+
+QString archiveListingKey(const QUrl &archiveURL, bool recursive)
+{
+    return archiveURL.toString() + (recursive ? QStringLiteral(" R") : QStringLiteral(" F"));
+}
+}
+
 KRSearchMod::KRSearchMod(const KRQuery* q)
 {
     stopSearch = false; /// ===> added
@@ -61,10 +91,19 @@ KRSearchMod::KRSearchMod(const KRQuery* q)
 
     remote_vfs = 0;
     virtual_vfs = 0;
+
+    // the file index can replace the recursive scanning of the indexed local folders
+    KConfigGroup group(krConfig, "Search");
+    useIndex = group.readEntry("Use File Index", _SearchUseIndex) && KrFileIndex::isEnabled() &&
+               query->isRecursive() && !query->searchInArchives();
+
+    maxArchiveJobs = qMax(1, group.readEntry("Archive Listers", _SearchArchiveListers));
 }
 
 KRSearchMod::~KRSearchMod()
 {
+    for (KJob *job : archiveJobs.keys())
+        job->kill();
     delete query;
     if (remote_vfs)
         delete remote_vfs;
@@ -77,6 +116,7 @@ void KRSearchMod::start()
     unScannedUrls.clear();
     scannedUrls.clear();
     timer.start();
+    batchTimer.start();
 
     QList<QUrl> whereToSearch = query->searchInDirs();
 
@@ -84,6 +124,8 @@ void KRSearchMod::start()
     for (int i = 0; i < whereToSearch.count(); ++i)
         scanURL(whereToSearch [ i ]);
 
+    waitForArchives();
+    flushResults();
     emit finished();
 }
 
@@ -98,6 +140,8 @@ void KRSearchMod::scanURL(QUrl url)
 
     unScannedUrls.push(url);
     while (!unScannedUrls.isEmpty()) {
+        matchListedArchives();
+
         QUrl urlToCheck = unScannedUrls.pop();
 
         if (stopSearch) return;
@@ -113,9 +157,10 @@ void KRSearchMod::scanURL(QUrl url)
 
         emit searching(urlToCheck.toDisplayString(QUrl::PreferLocalFile));
 
-        if (urlToCheck.isLocalFile())
-            scanLocalDir(urlToCheck);
-        else
+        if (urlToCheck.isLocalFile()) {
+            if (!useIndex || !scanIndexedDir(urlToCheck))
+                scanLocalDir(urlToCheck);
+        } else
             scanRemoteDir(urlToCheck);
     }
 }
@@ -129,6 +174,10 @@ void KRSearchMod::scanLocalDir(QUrl urlToScan)
 
     QT_DIRENT* dirEnt;
 
+    // the listing is fed into the file index
+    const bool feedIndex = KrFileIndex::isEnabled() && KrFileIndex::instance()->wantsListing(dir);
+    QList<KrFileIndexEntry> indexEntries;
+
     while ((dirEnt = QT_READDIR(d)) != NULL) {
         QString name = QString::fromLocal8Bit(dirEnt->d_name);
 
@@ -138,10 +187,20 @@ void KRSearchMod::scanLocalDir(QUrl urlToScan)
         QT_STATBUF stat_p;
         QT_LSTAT((dir + name).toLocal8Bit(), &stat_p);
 
+        if (feedIndex) {
+            KrFileIndexEntry entry;
+            entry.name = dirEnt->d_name;
+            entry.flags = S_ISLNK(stat_p.st_mode) ? KrFileIndexData::IsLink :
+                          S_ISDIR(stat_p.st_mode) ? KrFileIndexData::IsDir : 0;
+            indexEntries.append(entry);
+        }
+
         QUrl url = QUrl::fromLocalFile(dir + name);
 
+        // the mime type is only detected here when archives need it, otherwise the
+        // query resolves it lazily after the cheaper conditions have passed
         QString mime;
-        if (query->searchInArchives() || !query->hasMimeType()) {
+        if (query->searchInArchives()) {
             QMimeDatabase db;
             QMimeType mt = db.mimeTypeForUrl(url);
             if (mt.isValid())
@@ -171,27 +230,72 @@ void KRSearchMod::scanLocalDir(QUrl urlToScan)
                     else
                         archiveURL.setScheme("krarc");
 
-                    unScannedUrls.push(archiveURL);
+                    scanArchive(archiveURL, stat_p.st_mtime, (KIO::filesize_t)stat_p.st_size);
                 }
             }
         }
 
         if (query->match(vf)) {
             // if we got here - we got a winner
-            results.append(dir + name);
-            emit found(name, dir, (KIO::filesize_t) stat_p.st_size, stat_p.st_mtime,
-                       KRpermHandler::mode2QString(stat_p.st_mode), stat_p.st_uid, stat_p.st_gid, query->foundText());
+            addResult(name, dir, (KIO::filesize_t) stat_p.st_size, stat_p.st_mtime,
+                      KRpermHandler::mode2QString(stat_p.st_mode), stat_p.st_uid, stat_p.st_gid);
         }
         delete vf;
 
         if (timer.elapsed() >= EVENT_PROCESS_DELAY) {
-            qApp->processEvents();
+            processEvents();
             timer.start();
             if (stopSearch) return;
         }
     }
     // clean up
     QT_CLOSEDIR(d);
+
+    if (feedIndex)
+        KrFileIndex::instance()->updateDirectory(dir, indexEntries);
+}
+
+bool KRSearchMod::scanIndexedDir(QUrl urlToScan)
+{
+    KrFileIndex *index = KrFileIndex::instance();
+    const QString path = urlToScan.path();
+    if (index->isBuilding() || !index->covers(path))
+        return false;
+
+    // only the entries with matching names are checked on the disk, stale ones are skipped
+    return index->walk(path, [this](const QString &dir, const QString &name, uchar flags) -> KrFileIndex::WalkAction {
+        if (timer.elapsed() >= EVENT_PROCESS_DELAY) {
+            processEvents();
+            timer.start();
+        }
+        if (stopSearch)
+            return KrFileIndex::Stop;
+
+        KrFileIndex::WalkAction action = KrFileIndex::Continue;
+        if ((flags & KrFileIndexData::IsDir) && query->isExcluded(QUrl::fromLocalFile(dir + name)))
+            action = KrFileIndex::SkipSubtree;
+        else if (flags & KrFileIndexData::IsDir)
+            scannedUrls.push(QUrl::fromLocalFile(dir + name)); // followed links into it are not walked again
+        else if ((flags & KrFileIndexData::IsLink) && query->followLinks())
+            unScannedUrls.push(QUrl::fromLocalFile(QDir(dir + name).canonicalPath()));
+
+        if (!query->match(name))
+            return action;
+
+        QT_STATBUF stat_p;
+        if (QT_LSTAT((dir + name).toLocal8Bit(), &stat_p) != 0)
+            return action;
+
+        vfile vf(name, (KIO::filesize_t)stat_p.st_size, KRpermHandler::mode2QString(stat_p.st_mode),
+                 stat_p.st_mtime, S_ISLNK(stat_p.st_mode), false, stat_p.st_uid, stat_p.st_gid,
+                 QString(), "", stat_p.st_mode, -1, QUrl::fromLocalFile(dir + name));
+
+        if (query->match(&vf)) {
+            addResult(name, dir, (KIO::filesize_t) stat_p.st_size, stat_p.st_mtime,
+                      KRpermHandler::mode2QString(stat_p.st_mode), stat_p.st_uid, stat_p.st_gid);
+        }
+        return action;
+    });
 }
 
 void KRSearchMod::scanRemoteDir(QUrl url)
@@ -219,24 +323,184 @@ void KRSearchMod::scanRemoteDir(QUrl url)
 
         if (query->match(vf)) {
             // if we got here - we got a winner
-            results.append(fileURL.toDisplayString(QUrl::PreferLocalFile));
-
-            emit found(fileURL.fileName(), KIO::upUrl(fileURL).toDisplayString(QUrl::PreferLocalFile | QUrl::StripTrailingSlash),
-                       vf->vfile_getSize(), vf->vfile_getTime_t(), vf->vfile_getPerm(), vf->vfile_getUid(),
-                       vf->vfile_getGid(), query->foundText());
+            addResult(fileURL.fileName(), KIO::upUrl(fileURL).toDisplayString(QUrl::PreferLocalFile | QUrl::StripTrailingSlash),
+                      vf->vfile_getSize(), vf->vfile_getTime_t(), vf->vfile_getPerm(), vf->vfile_getUid(),
+                      vf->vfile_getGid());
         }
 
         if (timer.elapsed() >= EVENT_PROCESS_DELAY) {
-            qApp->processEvents();
+            processEvents();
             timer.start();
             if (stopSearch) return;
         }
     }
 }
 
-void KRSearchMod::slotProcessEvents(bool & stopped)
+void KRSearchMod::scanArchive(const QUrl &archiveURL, time_t mtime, KIO::filesize_t size)
+{
+    // an unchanged archive is not listed again
+    CachedArchiveListing *cached = archiveListingCache().object(archiveListingKey(archiveURL, query->isRecursive()));
+    if (cached && cached->mtime == mtime && cached->size == size) {
+        matchArchive(archiveURL, cached->entries);
+        return;
+    }
+
+    ArchiveListing archive;
+    archive.url = archiveURL;
+    archive.mtime = mtime;
+    archive.size = size;
+    pendingArchives.enqueue(archive);
+    startArchiveJobs();
+}
+
+void KRSearchMod::startArchiveJobs()
+{
+    // the archives are listed in the background while the search goes on, the number of
+    // concurrent jobs limits the archiver processes started by the KIO slaves
+    while (!stopSearch && !pendingArchives.isEmpty() && archiveJobs.count() < maxArchiveJobs) {
+        ArchiveListing archive = pendingArchives.dequeue();
+        KIO::ListJob *job = query->isRecursive() ? KIO::listRecursive(archive.url, KIO::HideProgressInfo) :
+                                                   KIO::listDir(archive.url, KIO::HideProgressInfo);
+        connect(job, &KIO::ListJob::entries, this, &KRSearchMod::slotArchiveEntries);
+        connect(job, &KJob::result, this, &KRSearchMod::slotArchiveResult);
+        archiveJobs.insert(job, archive);
+    }
+}
+
+void KRSearchMod::waitForArchives()
+{
+    while (true) {
+        matchListedArchives();
+        if (stopSearch) {
+            for (KJob *job : archiveJobs.keys())
+                job->kill();
+            archiveJobs.clear();
+            pendingArchives.clear();
+            listedArchives.clear();
+            return;
+        }
+        if (archiveJobs.isEmpty())
+            return;
+        emit searching(archiveJobs.begin().value().url.toDisplayString(QUrl::PreferLocalFile));
+        flushResults();
+        qApp->processEvents(QEventLoop::WaitForMoreEvents);
+    }
+}
+
+void KRSearchMod::matchListedArchives()
+{
+    while (!stopSearch && !listedArchives.isEmpty()) {
+        const ArchiveListing archive = listedArchives.dequeue();
+        matchArchive(archive.url, archive.entries);
+    }
+}
+
+void KRSearchMod::slotArchiveEntries(KIO::Job *job, const KIO::UDSEntryList &entries)
+{
+    QHash<KJob *, ArchiveListing>::iterator it = archiveJobs.find(job);
+    if (it != archiveJobs.end())
+        it.value().entries.append(entries);
+}
+
+void KRSearchMod::slotArchiveResult(KJob *job)
 {
+    if (!archiveJobs.contains(job))
+        return;
+    ArchiveListing archive = archiveJobs.take(job);
+
+    if (!job->error() && !stopSearch) {
+        // the result may arrive in the event loop of a running match: the query is not reentrant
+        listedArchives.enqueue(archive);
+
+        CachedArchiveListing *cached = new CachedArchiveListing;
+        cached->mtime = archive.mtime;
+        cached->size = archive.size;
+        cached->entries = archive.entries;
+        archiveListingCache().insert(archiveListingKey(archive.url, query->isRecursive()), cached,
+                                     qMax(1, archive.entries.count()));
+    }
+
+    startArchiveJobs();
+}
+
+void KRSearchMod::matchArchive(const QUrl &archiveURL, const KIO::UDSEntryList &entries)
+{
+    const QUrl root = vfs::ensureTrailingSlash(archiveURL);
+    QStringList excludedDirs; // the recursive listing has the subfolders before their content
+
+    for (const KIO::UDSEntry &entry : entries) {
+        // recursive listings name the entries by their path relative to the archive root
+        const QString relPath = entry.stringValue(KIO::UDSEntry::UDS_NAME);
+        if (relPath.isEmpty() || relPath == "." || relPath == ".." ||
+                relPath.endsWith(QLatin1String("/.")) || relPath.endsWith(QLatin1String("/..")))
+            continue;
+
+        bool excluded = false;
+        for (const QString &dir : excludedDirs) {
+            if (relPath.startsWith(dir)) {
+                excluded = true;
+                break;
+            }
+        }
+        if (excluded)
+            continue;
+
+        const int slash = relPath.lastIndexOf('/');
+        QUrl dirURL = root;
+        KIO::UDSEntry leaf(entry);
+        if (slash >= 0) {
+            dirURL.setPath(root.path() + relPath.left(slash + 1));
+            leaf.insert(KIO::UDSEntry::UDS_NAME, relPath.mid(slash + 1));
+            const QString displayName = entry.stringValue(KIO::UDSEntry::UDS_DISPLAY_NAME);
+            if (!displayName.isEmpty())
+                leaf.insert(KIO::UDSEntry::UDS_DISPLAY_NAME, displayName.mid(displayName.lastIndexOf('/') + 1));
+        }
+
+        vfile *vf = vfs::createVFileFromKIO(leaf, dirURL);
+        if (!vf)
+            continue;
+
+        const QUrl fileURL = vf->vfile_getUrl();
+        if (vf->vfile_isDir() && query->isExcluded(fileURL))
+            excludedDirs << relPath + '/';
+        if (query->match(vf)) {
+            addResult(fileURL.fileName(), KIO::upUrl(fileURL).toDisplayString(QUrl::PreferLocalFile | QUrl::StripTrailingSlash),
+                      vf->vfile_getSize(), vf->vfile_getTime_t(), vf->vfile_getPerm(), vf->vfile_getUid(),
+                      vf->vfile_getGid());
+        }
+        delete vf;
+    }
+}
+
+void KRSearchMod::addResult(const QString &name, const QString &dir, KIO::filesize_t size, time_t mtime,
+                            const QString &perm, uid_t owner, gid_t group)
+{
+    KrSearchResult result = { name, dir, size, mtime, perm, owner, group, query->foundText() };
+    pendingResults.append(result);
+    if (batchTimer.elapsed() >= RESULT_BATCH_DELAY)
+        flushResults();
+}
+
+void KRSearchMod::flushResults()
+{
+    batchTimer.start();
+    if (pendingResults.isEmpty())
+        return;
+    QList<KrSearchResult> batch;
+    batch.swap(pendingResults);
+    emit found(batch);
+}
+
+void KRSearchMod::processEvents()
+{
+    // show the hits before the GUI gets the chance to stop the search
+    flushResults();
     qApp->processEvents();
+}
+
+void KRSearchMod::slotProcessEvents(bool & stopped)
+{
+    processEvents();
     stopped = stopSearch;
 }
 
@@ -34,20 +34,43 @@
 #define KRSEARCHMOD_H
 
 // QtCore
+#include <QHash>
+#include <QList>
 #include <QObject>
+#include <QQueue>
 #include <QStringList>
 #include <QDateTime>
 #include <QStack>
 #include <QUrl>
 
 #include <KIO/Global>
+#include <KIO/UDSEntry>
 
 #include "../VFS/default_vfs.h"
 #include "../VFS/virt_vfs.h"
 
 
+class KJob;
 class KRQuery;
 class ftp_vfs;
+namespace KIO {
+class Job;
+}
+
+/**
+ * A search hit. The hits are collected and passed to the GUI in batches.
+ */
+struct KrSearchResult
+{
+    QString name;
+    QString dir;
+    KIO::filesize_t size;
+    time_t mtime;
+    QString perm;
+    uid_t owner;
+    gid_t group;
+    QString foundText;
+};
 
 class KRSearchMod : public QObject
 {
@@ -62,28 +85,56 @@ public:
 
 private:
     void scanLocalDir(QUrl url);
+    bool scanIndexedDir(QUrl url);
     void scanRemoteDir(QUrl url);
+    void scanArchive(const QUrl &archiveURL, time_t mtime, KIO::filesize_t size);
+    void startArchiveJobs();
+    void waitForArchives();
+    void matchListedArchives();
+    void matchArchive(const QUrl &archiveURL, const KIO::UDSEntryList &entries);
+    void addResult(const QString &name, const QString &dir, KIO::filesize_t size, time_t mtime,
+                   const QString &perm, uid_t owner, gid_t group);
+    void flushResults();
+    void processEvents();
 
 signals:
     void finished();
     void searching(const QString&);
-    void found(QString what, QString where,KIO::filesize_t size, time_t mtime,
-               QString perm, uid_t owner, gid_t group, QString textFound);
+    /// the hits found since the last emit, sent at most every RESULT_BATCH_DELAY ms
+    void found(const QList<KrSearchResult> &results);
 
 private slots:
     void slotProcessEvents(bool & stopped);
+    void slotArchiveEntries(KIO::Job *job, const KIO::UDSEntryList &entries);
+    void slotArchiveResult(KJob *job);
 
 private:
     bool stopSearch;
+    bool useIndex;
     QStack<QUrl> scannedUrls;
     QStack<QUrl> unScannedUrls;
     KRQuery *query;
-    QStringList results;
 
     default_vfs *remote_vfs;
     virt_vfs *virtual_vfs;
 
+    QList<KrSearchResult> pendingResults;
+
+    /// an archive waiting for or being listed by a KIO job
+    struct ArchiveListing {
+        QUrl url;
+        time_t mtime;
+        KIO::filesize_t size;
+        KIO::UDSEntryList entries;
+    };
+    QQueue<ArchiveListing> pendingArchives;
+    QHash<KJob *, ArchiveListing> archiveJobs;
+    /// listed archives waiting to be matched, outside of the slots where a match may be running
+    QQueue<ArchiveListing> listedArchives;
+    int maxArchiveJobs;
+
     QTime timer;
+    QTime batchTimer;
 };
 
 #endif
@@ -30,7 +30,6 @@
 
 #include "feedtolistboxdialog.h"
 #include "synchronizer.h"
-#include "synchronizergui.h"
 #include "../VFS/vfs.h"
 #include "../VFS/virt_vfs.h"
 #include "../krglobal.h"
@@ -54,8 +53,8 @@
 #define  S_BOTH        2
 
 FeedToListBoxDialog::FeedToListBoxDialog(QWidget *parent, Synchronizer *sync,
-        QTreeWidget *syncL, bool equOK) : QDialog(parent),
-        synchronizer(sync), syncList(syncL), equalAllowed(equOK), accepted(false)
+        const QSet<SynchronizerFileItem *> &selected, bool equOK) : QDialog(parent),
+        synchronizer(sync), selectedItems(selected), equalAllowed(equOK), accepted(false)
 {
 
     setWindowTitle(i18n("Krusader::Feed to listbox"));
@@ -71,15 +70,15 @@ FeedToListBoxDialog::FeedToListBoxDialog(QWidget *parent, Synchronizer *sync,
     int leftExistingNum = 0;
     int rightExistingNum = 0;
 
-    QTreeWidgetItemIterator it(syncList);
-    while (*it) {
-        SynchronizerGUI::SyncViewItem *item = (SynchronizerGUI::SyncViewItem *) * it;
-        SynchronizerFileItem *syncItem = item->synchronizerItemRef();
+    unsigned              ndx = 0;
+    SynchronizerFileItem  *syncItem;
 
-        if (syncItem && syncItem->isMarked()) {
-            if (item->isSelected() || syncItem->task() != TT_EQUALS || equalAllowed) {
+    while ((syncItem = synchronizer->getItemAt(ndx++)) != 0) {
+        if (syncItem->isMarked()) {
+            bool isSelected = selectedItems.contains(syncItem);
+            if (isSelected || syncItem->task() != TT_EQUALS || equalAllowed) {
                 itemNum++;
-                if (item->isSelected())
+                if (isSelected)
                     selectedNum++;
 
                 if (syncItem->existsInLeft())
@@ -88,7 +87,6 @@ FeedToListBoxDialog::FeedToListBoxDialog(QWidget *parent, Synchronizer *sync,
                     rightExistingNum++;
             }
         }
-        it++;
     }
 
     if (itemNum == 0) {
@@ -177,16 +175,16 @@ void FeedToListBoxDialog::slotOk()
     QString name = lineEdit->text();
     QList<QUrl> urlList;
 
-    QTreeWidgetItemIterator it(syncList);
-    for (;*it; it++) {
-        SynchronizerGUI::SyncViewItem *item = (SynchronizerGUI::SyncViewItem *) * it;
-        SynchronizerFileItem *syncItem = item->synchronizerItemRef();
+    unsigned              ndx = 0;
+    SynchronizerFileItem  *syncItem;
 
-        if (!syncItem || !syncItem->isMarked())
+    while ((syncItem = synchronizer->getItemAt(ndx++)) != 0) {
+        if (!syncItem->isMarked())
             continue;
-        if (selected && !item->isSelected())
+        bool isSelected = selectedItems.contains(syncItem);
+        if (selected && !isSelected)
             continue;
-        if (!equalAllowed && syncItem->task() == TT_EQUALS && (!selected || !item->isSelected()))
+        if (!equalAllowed && syncItem->task() == TT_EQUALS && (!selected || !isSelected))
             continue;
 
         if ((side == S_BOTH || side == S_LEFT) && syncItem->existsInLeft()) {
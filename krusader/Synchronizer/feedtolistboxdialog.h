@@ -31,21 +31,23 @@
 #ifndef FEEDTOLISTBOXDIALOG_H
 #define FEEDTOLISTBOXDIALOG_H
 
+// QtCore
+#include <QSet>
 // QtWidgets
 #include <QDialog>
 
 class Synchronizer;
+class SynchronizerFileItem;
 class QCheckBox;
 class QLineEdit;
 class QComboBox;
-class QTreeWidget;
 
 class FeedToListBoxDialog : public QDialog
 {
     Q_OBJECT
 
 public:
-    FeedToListBoxDialog(QWidget*, Synchronizer *, QTreeWidget *, bool);
+    FeedToListBoxDialog(QWidget*, Synchronizer *, const QSet<SynchronizerFileItem *> &selected, bool);
     virtual ~FeedToListBoxDialog() {}
 
     bool isAccepted() {
@@ -57,7 +59,7 @@ protected slots:
 
 private:
     Synchronizer * synchronizer;
-    QTreeWidget  * syncList;
+    QSet<SynchronizerFileItem *> selectedItems;
     QCheckBox    * cbSelected;
     QLineEdit    * lineEdit;
     QComboBox    * sideCombo;
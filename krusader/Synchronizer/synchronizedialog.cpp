@@ -114,6 +114,13 @@ SynchronizeDialog::SynchronizeDialog(QWidget* parent,
     cbOverwrite->setChecked(group.readEntry("Confirm overwrites", _ConfirmOverWrites));
     layout->addWidget(cbOverwrite);
 
+    cbDeltaCopy = new QCheckBox(i18n("Write only the changed blocks of large local files"), this);
+    cbDeltaCopy->setChecked(group.readEntry("Delta Copy", _DeltaCopy));
+    cbDeltaCopy->setWhatsThis(i18n("Large files existing on both local sides are updated in place: both versions are read "
+                                   "and only the differing blocks are written. Much faster for big files with few "
+                                   "changes, like disk images, but an interrupted update leaves a partially updated file."));
+    layout->addWidget(cbDeltaCopy);
+
     QSpacerItem* spacer = new QSpacerItem(20, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
     hbox->addItem(spacer);
 
@@ -146,6 +153,7 @@ SynchronizeDialog::~SynchronizeDialog()
 {
     KConfigGroup group(krConfig, "Synchronize");
     group.writeEntry("Confirm overwrites", cbOverwrite->isChecked());
+    group.writeEntry("Delta Copy", cbDeltaCopy->isChecked());
 }
 
 void SynchronizeDialog::startSynchronization()
@@ -162,7 +170,8 @@ void SynchronizeDialog::startSynchronization()
     if (!cbDeletable->isChecked())   deleteSize = 0;
 
     synchronizer->synchronize(this, cbRightToLeft->isChecked(), cbLeftToRight->isChecked(),
-                              cbDeletable->isChecked(), !cbOverwrite->isChecked(), parallelThreads);
+                              cbDeletable->isChecked(), !cbOverwrite->isChecked(), parallelThreads,
+                              cbDeltaCopy->isChecked());
 }
 
 void SynchronizeDialog::synchronizationFinished()
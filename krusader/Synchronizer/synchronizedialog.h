@@ -72,6 +72,7 @@ private:
     QLabel        *lbDeletable;
 
     QCheckBox     *cbOverwrite;
+    QCheckBox     *cbDeltaCopy;
 
     QPushButton   *btnStart;
     QPushButton   *btnPause;
@@ -29,10 +29,14 @@
  ***************************************************************************/
 
 #include "synchronizer.h"
+#include "synchronizerchecksumcache.h"
+#include "synchronizerdeltajob.h"
 #include "synchronizerdirlist.h"
 #include "../krglobal.h"
 #include "../krservices.h"
+#include "../defaults.h"
 #include "../VFS/vfs.h"
+#include "../VFS/krpermhandler.h"
 #include "../VFS/krquery.h"
 
 #include <utime.h>
@@ -55,7 +59,10 @@
 #include <QPushButton>
 #include <QLabel>
 
+#include <KConfigCore/KConfig>
+#include <KConfigCore/KConfigGroup>
 #include <KI18n/KLocalizedString>
+#include <KIO/CopyJob>
 #include <KIO/DeleteJob>
 #include <KIO/JobUiDelegate>
 #include <KIO/SkipDialog>
@@ -72,12 +79,18 @@
 #endif
 
 
-#define  DISPLAY_UPDATE_PERIOD        2
+#define  DISPLAY_UPDATE_PERIOD        100
 
-Synchronizer::Synchronizer() : displayUpdateCount(0), markEquals(true),
+// the files below this size are copied in batches, the bigger ones one by one
+#define  SMALL_FILE_SIZE              (1024 * 1024)
+#define  BATCH_MAX_FILES              64
+#define  BATCH_MAX_SIZE               (16 * 1024 * 1024)
+
+Synchronizer::Synchronizer() : markEquals(true),
         markDiffers(true), markCopyToLeft(true), markCopyToRight(true), markDeletable(true),
-        stack(), jobMap(), receivedMap(), parentWidget(0), resultListIt(resultList)
+        stack(), jobMap(), receivedMap(), parentWidget(0)
 {
+    displayUpdateTimer.start();
 }
 
 Synchronizer::~Synchronizer()
@@ -95,7 +108,7 @@ void Synchronizer::clearLists()
 {
     QListIterator<SynchronizerFileItem *> i1(resultList);
     while (i1.hasNext())
-        delete i1.next();
+        i1.next()->~SynchronizerFileItem();
     resultList.clear();
 
     QListIterator<SynchronizerTask *> i2(stack);
@@ -104,27 +117,31 @@ void Synchronizer::clearLists()
     stack.clear();
 
     temporaryList.clear();
+    itemArena.clear();
 }
 
 void Synchronizer::reset()
 {
-    displayUpdateCount = 0;
+    displayUpdateTimer.start();
     markEquals = markDiffers = markCopyToLeft = markCopyToRight = markDeletable = true;
     stopped = false;
-    recurseSubDirs = followSymLinks = ignoreDate = asymmetric = cmpByContent = ignoreCase = autoScroll = false;
+    recurseSubDirs = followSymLinks = ignoreDate = asymmetric = cmpByContent = checksumCache = ignoreCase = autoScroll = false;
     markEquals = markDiffers = markCopyToLeft = markCopyToRight = markDeletable = markDuplicates = markSingles = false;
-    leftCopyEnabled = rightCopyEnabled = deleteEnabled = overWrite = autoSkip = paused = false;
+    leftCopyEnabled = rightCopyEnabled = deleteEnabled = overWrite = deltaCopy = autoSkip = paused = false;
     leftCopyNr = rightCopyNr = deleteNr = 0;
     leftCopySize = rightCopySize = deleteSize = 0;
-    comparedDirs = fileCount = 0;
+    comparedDirs = unchangedDirs = fileCount = 0;
+    listedEntries = listingTime = 0;
     leftBaseDir.clear();
     rightBaseDir.clear();
     clearLists();
+    snapshot.close();
 }
 
 int Synchronizer::compare(QString leftURL, QString rightURL, KRQuery *query, bool subDirs,
                           bool symLinks, bool igDate, bool asymm, bool cmpByCnt, bool igCase,
-                          bool autoSc, QStringList &selFiles, int equThres, int timeOffs, int parThreads, bool hiddenFiles)
+                          bool autoSc, QStringList &selFiles, int equThres, int timeOffs, int parThreads, bool hiddenFiles,
+                          bool cachedChecksums, bool incremental)
 {
     clearLists();
 
@@ -133,6 +150,7 @@ int Synchronizer::compare(QString leftURL, QString rightURL, KRQuery *query, boo
     ignoreDate     = igDate;
     asymmetric     = asymm;
     cmpByContent   = cmpByCnt;
+    checksumCache  = cachedChecksums;
     autoScroll     = autoSc;
     ignoreCase     = igCase;
     selectedFiles  = selFiles;
@@ -156,7 +174,26 @@ int Synchronizer::compare(QString leftURL, QString rightURL, KRQuery *query, boo
         if (excludedPaths[ i ].endsWith('/'))
             excludedPaths[ i ].truncate(excludedPaths[ i ].length() - 1);
 
-    comparedDirs = fileCount = 0;
+    comparedDirs = unchangedDirs = fileCount = 0;
+    listedEntries = listingTime = 0;
+
+    snapshot.close();
+    folderStates.clear();
+    if (incremental && fsUrl(leftURL).isLocalFile() && fsUrl(rightURL).isLocalFile()) {
+        // everything affecting the equality of the files invalidates the snapshot
+        KConfig config(QString(), KConfig::SimpleConfig);
+        KConfigGroup group(&config, "Query");
+        query->save(group);
+        QByteArray settings;
+        const QMap<QString, QString> entries = group.entryMap();
+        for (QMap<QString, QString>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+            settings += (it.key() + '=' + it.value() + '\n').toUtf8();
+        settings += QString("%1 %2 %3 %4 %5 %6 %7 %8").arg(subDirs).arg(symLinks).arg(igDate).arg(cmpByCnt)
+                    .arg(igCase).arg(equThres).arg(timeOffs).arg(hiddenFiles).toLatin1();
+        snapshot.open(fsUrl(leftURL).toLocalFile(), fsUrl(rightURL).toLocalFile(), settings);
+    }
+
+    SynchronizerTask::workerPool()->setMaxThreadCount(qMax(parallelThreads, 1));
 
     stack.append(new CompareTask(0, leftBaseDir = leftURL, rightBaseDir = rightURL, "", "", ignoreHidden));
     compareLoop();
@@ -166,36 +203,69 @@ int Synchronizer::compare(QString leftURL, QString rightURL, KRQuery *query, boo
         SynchronizerFileItem * item = it.next();
 
         if (item->isTemporary())
-            delete item;
+            item->~SynchronizerFileItem();
     }
     temporaryList.clear();
 
+    if (useChecksumCache())
+        SynchronizerChecksumCache::instance()->save();
+
+    if (snapshot.isOpen()) {
+        // without differences there is nothing to synchronize, the snapshot is taken now
+        if (stopped || !selectedFiles.isEmpty())
+            snapshot.close();
+        else if (!snapshot.hasDifferences())
+            snapshot.save();
+    }
+    folderStates.clear();
 
     if (!autoScroll)
         refresh(true);
 
-    emit statusInfo(i18n("Number of files: %1", fileCount));
+    QString status;
+    if (unchangedDirs)
+        status = i18n("Number of files: %1, unchanged folders: %2", fileCount, unchangedDirs);
+    else
+        status = i18n("Number of files: %1", fileCount);
+    if (listingTime > 0)
+        status += ' ' + i18n("(listed %1 entries/s)", listedEntries * 1000 / listingTime);
+    emit statusInfo(status);
     return fileCount;
 }
 
 void Synchronizer::compareLoop()
 {
     while (!stopped && !stack.isEmpty()) {
+        bool progress = false;
         for (int thread = 0; thread < (int)stack.count() && thread < parallelThreads; thread++) {
             SynchronizerTask * entry = stack.at(thread);
 
-            if (entry->state() == ST_STATE_NEW)
+            if (entry->state() == ST_STATE_NEW) {
+                if (snapshot.isOpen() && entry->inherits("CompareTask") &&
+                        skipUnchangedDirectory((CompareTask *) entry)) {
+                    comparedDirs++;
+                    stack.removeAll(entry);
+                    delete entry;
+                    progress = true;
+                    continue;
+                }
                 entry->start(parentWidget);
+                progress = true;
+            }
 
             if (entry->inherits("CompareTask")) {
                 if (entry->state() == ST_STATE_READY) {
                     CompareTask *ctentry = (CompareTask *) entry;
-                    if (ctentry->isDuplicate())
+                    if (ctentry->isDuplicate()) {
                         compareDirectory(ctentry->parent(), ctentry->leftDirList(), ctentry->rightDirList(),
                                          ctentry->leftDir(), ctentry->rightDir());
-                    else
+                        countListing(ctentry->leftDirList());
+                        countListing(ctentry->rightDirList());
+                    } else {
                         addSingleDirectory(ctentry->parent(), ctentry->dirList(), ctentry->dir(),
                                            ctentry->isLeft());
+                        countListing(ctentry->dirList());
+                    }
                 }
                 if (entry->state() == ST_STATE_READY || entry->state() == ST_STATE_ERROR)
                     comparedDirs++;
@@ -209,13 +279,16 @@ void Synchronizer::compareLoop()
                 emit statusInfo(i18n("Number of compared folders: %1", comparedDirs));
                 stack.removeAll(entry);
                 delete entry;
+                progress = true;
                 continue;
             default:
                 break;
             }
         }
+        // the tasks are finished by events (worker threads, KIO jobs), so wait for them
+        // instead of spinning when nothing happened
         if (!stack.isEmpty())
-            qApp->processEvents();
+            qApp->processEvents(progress ? QEventLoop::AllEvents : QEventLoop::WaitForMoreEvents);
     }
 
     QListIterator<SynchronizerTask *> it(stack);
@@ -230,8 +303,8 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
 {
     const QString &leftURL = left_directory->url();
     const QString &rightURL = right_directory->url();
-    vfile * left_file;
-    vfile * right_file;
+    const SynchronizerDirEntry * left_file;
+    const SynchronizerDirEntry * right_file;
 
     QString file_name;
     bool checkIfSelected = false;
@@ -239,34 +312,50 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
     if (leftDir.isEmpty() && rightDir.isEmpty() && selectedFiles.count())
         checkIfSelected = true;
 
+    // the directories go to the snapshot if no difference is found in them
+    SynchronizerSnapshot::Folder folder = folderStates.take(leftDir);
+    bool equal = snapshot.isOpen() && !checkIfSelected;
+
     /* walking through in the left directory */
     for (left_file = left_directory->first(); left_file != 0 && !stopped ;
             left_file = left_directory->next()) {
         if (isDir(left_file))
             continue;
 
-        file_name =  left_file->vfile_getName();
+        file_name =  left_file->name;
 
         if (checkIfSelected && !selectedFiles.contains(file_name))
             continue;
 
-        if (!query->match(left_file))
+        if (!matches(left_file, leftURL))
             continue;
 
-        if ((right_file = right_directory->search(file_name, ignoreCase)) == 0)
-            addLeftOnlyItem(parent, file_name, leftDir, left_file->vfile_getSize(), left_file->vfile_getTime_t(),
-                            readLink(left_file), left_file->vfile_getOwner(), left_file->vfile_getGroup(),
-                            left_file->vfile_getMode(), left_file->vfile_getACL());
-        else {
-            if (isDir(right_file))
+        if ((right_file = right_directory->search(file_name, ignoreCase)) == 0) {
+            addLeftOnlyItem(parent, file_name, leftDir, left_file->size, left_file->mtime,
+                            readLink(left_file), left_file->uid, left_file->gid,
+                            left_file->mode, remoteACL(left_file));
+            equal = false;
+        } else {
+            if (isDir(right_file)) {
+                equal = false;
                 continue;
+            }
 
-            addDuplicateItem(parent, file_name, right_file->vfile_getName(), leftDir, rightDir, left_file->vfile_getSize(), right_file->vfile_getSize(),
-                             left_file->vfile_getTime_t(), right_file->vfile_getTime_t(), readLink(left_file),
-                             readLink(right_file), left_file->vfile_getOwner(), right_file->vfile_getOwner(),
-                             left_file->vfile_getGroup(), right_file->vfile_getGroup(),
-                             left_file->vfile_getMode(), right_file->vfile_getMode(),
-                             left_file->vfile_getACL(), right_file->vfile_getACL());
+            SynchronizerFileItem *item = addDuplicateItem(parent, file_name, right_file->name, leftDir, rightDir, left_file->size, right_file->size,
+                             left_file->mtime, right_file->mtime, readLink(left_file),
+                             readLink(right_file), left_file->uid, right_file->uid,
+                             left_file->gid, right_file->gid,
+                             left_file->mode, right_file->mode,
+                             remoteACL(left_file), remoteACL(right_file));
+            // the files compared by content are checked in compareContentResult()
+            if (item->task() != TT_EQUALS && item->task() < TT_UNKNOWN)
+                equal = false;
+            else if (equal && left_file->isLocal && right_file->isLocal) {
+                SynchronizerSnapshot::FileState leftState = { left_file->name, left_file->inode, left_file->size, left_file->mtimeNsec };
+                SynchronizerSnapshot::FileState rightState = { right_file->name, right_file->inode, right_file->size, right_file->mtimeNsec };
+                folder.leftFiles.append(leftState);
+                folder.rightFiles.append(rightState);
+            }
         }
     }
 
@@ -276,26 +365,28 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
         if (isDir(right_file))
             continue;
 
-        file_name =  right_file->vfile_getName();
+        file_name =  right_file->name;
 
         if (checkIfSelected && !selectedFiles.contains(file_name))
             continue;
 
-        if (!query->match(right_file))
+        if (!matches(right_file, rightURL))
             continue;
 
-        if (left_directory->search(file_name, ignoreCase) == 0)
-            addRightOnlyItem(parent, file_name, rightDir, right_file->vfile_getSize(), right_file->vfile_getTime_t(),
-                             readLink(right_file), right_file->vfile_getOwner(), right_file->vfile_getGroup(),
-                             right_file->vfile_getMode(), right_file->vfile_getACL());
+        if (left_directory->search(file_name, ignoreCase) == 0) {
+            addRightOnlyItem(parent, file_name, rightDir, right_file->size, right_file->mtime,
+                             readLink(right_file), right_file->uid, right_file->gid,
+                             right_file->mode, remoteACL(right_file));
+            equal = false;
+        }
     }
 
     /* walking through the subdirectories */
     if (recurseSubDirs) {
         for (left_file = left_directory->first(); left_file != 0 && !stopped ;
                 left_file = left_directory->next()) {
-            if (left_file->vfile_isDir() && (followSymLinks || !left_file->vfile_isSymLink())) {
-                QString left_file_name =  left_file->vfile_getName();
+            if (left_file->isDir && (followSymLinks || !left_file->isLink)) {
+                QString left_file_name =  left_file->name;
 
                 if (checkIfSelected && !selectedFiles.contains(left_file_name))
                     continue;
@@ -308,23 +399,28 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
 
                 if ((right_file = right_directory->search(left_file_name, ignoreCase)) == 0) {
                     SynchronizerFileItem *me = addLeftOnlyItem(parent, left_file_name, leftDir, 0,
-                                               left_file->vfile_getTime_t(), readLink(left_file),
-                                               left_file->vfile_getOwner(), left_file->vfile_getGroup(),
-                                               left_file->vfile_getMode(), left_file->vfile_getACL(),
-                                               true, !query->match(left_file));
+                                               left_file->mtime, readLink(left_file),
+                                               left_file->uid, left_file->gid,
+                                               left_file->mode, remoteACL(left_file),
+                                               true, !matches(left_file, leftURL));
                     stack.append(new CompareTask(me, leftURL + left_file_name + '/',
                                                  leftDir.isEmpty() ? left_file_name : leftDir + '/' + left_file_name, true, ignoreHidden));
+                    equal = false;
                 } else {
-                    QString right_file_name =  right_file->vfile_getName();
+                    QString right_file_name =  right_file->name;
+                    if (!right_file->isDir)
+                        equal = false;
+                    folder.leftSubDirs.append(left_file_name);
+                    folder.rightSubDirs.append(right_file_name);
                     SynchronizerFileItem *me = addDuplicateItem(parent, left_file_name, right_file_name,
                                                leftDir, rightDir, 0, 0,
-                                               left_file->vfile_getTime_t(), right_file->vfile_getTime_t(),
+                                               left_file->mtime, right_file->mtime,
                                                readLink(left_file), readLink(right_file),
-                                               left_file->vfile_getOwner(), right_file->vfile_getOwner(),
-                                               left_file->vfile_getGroup(), right_file->vfile_getGroup(),
-                                               left_file->vfile_getMode(), right_file->vfile_getMode(),
-                                               left_file->vfile_getACL(), right_file->vfile_getACL(),
-                                               true, !query->match(left_file));
+                                               left_file->uid, right_file->uid,
+                                               left_file->gid, right_file->gid,
+                                               left_file->mode, right_file->mode,
+                                               remoteACL(left_file), remoteACL(right_file),
+                                               true, !matches(left_file, leftURL));
                     stack.append(new CompareTask(me, leftURL + left_file_name + '/', rightURL + right_file_name + '/',
                                                  leftDir.isEmpty() ? left_file_name : leftDir + '/' + left_file_name,
                                                  rightDir.isEmpty() ? right_file_name : rightDir + '/' + right_file_name, ignoreHidden));
@@ -335,8 +431,8 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
         /* walking through the right side subdirectories */
         for (right_file = right_directory->first(); right_file != 0 && !stopped ;
                 right_file = right_directory->next()) {
-            if (right_file->vfile_isDir() && (followSymLinks || !right_file->vfile_isSymLink())) {
-                file_name =  right_file->vfile_getName();
+            if (right_file->isDir && (followSymLinks || !right_file->isLink)) {
+                file_name =  right_file->name;
 
                 if (checkIfSelected && !selectedFiles.contains(file_name))
                     continue;
@@ -349,16 +445,81 @@ void Synchronizer::compareDirectory(SynchronizerFileItem *parent, SynchronizerDi
 
                 if (left_directory->search(file_name, ignoreCase) == 0) {
                     SynchronizerFileItem *me = addRightOnlyItem(parent, file_name, rightDir, 0,
-                                               right_file->vfile_getTime_t(), readLink(right_file),
-                                               right_file->vfile_getOwner(), right_file->vfile_getGroup(),
-                                               right_file->vfile_getMode(), right_file->vfile_getACL(),
-                                               true, !query->match(right_file));
+                                               right_file->mtime, readLink(right_file),
+                                               right_file->uid, right_file->gid,
+                                               right_file->mode, remoteACL(right_file),
+                                               true, !matches(right_file, rightURL));
                     stack.append(new CompareTask(me, rightURL + file_name + '/',
                                                  rightDir.isEmpty() ? file_name : rightDir + '/' + file_name, false, ignoreHidden));
+                    equal = false;
                 }
             }
         }
     }
+
+    if (snapshot.isOpen() && !stopped) {
+        if (equal)
+            snapshot.setEqual(leftDir, folder);
+        else
+            snapshot.setDifferent(leftDir);
+    }
+}
+
+void Synchronizer::countListing(SynchronizerDirList *list)
+{
+    listedEntries += list->count();
+    listingTime += list->listingTime();
+}
+
+bool Synchronizer::skipUnchangedDirectory(CompareTask *task)
+{
+    if (!task->isDuplicate())
+        return false;
+
+    SynchronizerSnapshot::Folder &states = folderStates[task->leftDir()];
+    if (!SynchronizerSnapshot::folderState(fsUrl(task->leftURL()).toLocalFile(), states.left) ||
+            !SynchronizerSnapshot::folderState(fsUrl(task->rightURL()).toLocalFile(), states.right)) {
+        folderStates.remove(task->leftDir());
+        return false;
+    }
+
+    SynchronizerSnapshot::Folder folder;
+    if (!snapshot.findUnchanged(task->leftDir(), states.left, states.right, folder))
+        return false;
+
+    // no entry was created, removed or renamed in the directories since the snapshot, but
+    // the files may have been rewritten in place
+    if (!SynchronizerSnapshot::filesUnchanged(fsUrl(task->leftURL()).toLocalFile(), folder.leftFiles) ||
+            !SynchronizerSnapshot::filesUnchanged(fsUrl(task->rightURL()).toLocalFile(), folder.rightFiles))
+        return false;
+
+    // the files are still equal: only the subdirectories are compared
+    folderStates.remove(task->leftDir());
+    folder.left = states.left;
+    folder.right = states.right;
+    snapshot.setEqual(task->leftDir(), folder);
+    unchangedDirs++;
+
+    for (int i = 0; i != folder.leftSubDirs.count() && i != folder.rightSubDirs.count(); ++i) {
+        const QString &leftName = folder.leftSubDirs[ i ];
+        const QString &rightName = folder.rightSubDirs[ i ];
+        SynchronizerSnapshot::FolderState leftState = SynchronizerSnapshot::FolderState();
+        SynchronizerSnapshot::FolderState rightState = SynchronizerSnapshot::FolderState();
+        SynchronizerSnapshot::folderState(fsUrl(task->leftURL() + leftName).toLocalFile(), leftState);
+        SynchronizerSnapshot::folderState(fsUrl(task->rightURL() + rightName).toLocalFile(), rightState);
+
+        // temporary items: they are shown only if something differs in them
+        SynchronizerFileItem *me = addDuplicateItem(task->parent(), leftName, rightName,
+                                   task->leftDir(), task->rightDir(), 0, 0, leftState.mtime / 1000000000,
+                                   rightState.mtime / 1000000000, QString(), QString(),
+                                   leftState.uid, rightState.uid, leftState.gid, rightState.gid,
+                                   leftState.mode, rightState.mode, QString(), QString(), true, true);
+        stack.append(new CompareTask(me, task->leftURL() + leftName + '/', task->rightURL() + rightName + '/',
+                                     task->leftDir().isEmpty() ? leftName : task->leftDir() + '/' + leftName,
+                                     task->rightDir().isEmpty() ? rightName : task->rightDir() + '/' + rightName,
+                                     ignoreHidden));
+    }
+    return true;
 }
 
 QString Synchronizer::getTaskTypeName(TaskType taskType)
@@ -373,14 +534,14 @@ SynchronizerFileItem * Synchronizer::addItem(SynchronizerFileItem *parent, const
         const QString &rightDir, bool existsLeft, bool existsRight,
         KIO::filesize_t leftSize, KIO::filesize_t rightSize,
         time_t leftDate, time_t rightDate, const QString &leftLink,
-        const QString &rightLink, const QString &leftOwner,
-        const QString &rightOwner, const QString &leftGroup,
-        const QString &rightGroup, mode_t leftMode, mode_t rightMode,
+        const QString &rightLink, uid_t leftOwner,
+        uid_t rightOwner, gid_t leftGroup,
+        gid_t rightGroup, mode_t leftMode, mode_t rightMode,
         const QString &leftACL, const QString &rightACL, TaskType tsk,
         bool isDir, bool isTemp)
 {
     bool marked = autoScroll ? !isTemp && isMarked(tsk, existsLeft && existsRight) : false;
-    SynchronizerFileItem *item = new SynchronizerFileItem(leftFile, rightFile, leftDir, rightDir, marked,
+    SynchronizerFileItem *item = new(itemArena.allocate()) SynchronizerFileItem(leftFile, rightFile, leftDir, rightDir, marked,
             existsLeft, existsRight, leftSize, rightSize, leftDate, rightDate, leftLink, rightLink,
             leftOwner, rightOwner, leftGroup, rightGroup, leftMode, rightMode, leftACL, rightACL, tsk, isDir,
             isTemp, parent);
@@ -389,22 +550,21 @@ SynchronizerFileItem * Synchronizer::addItem(SynchronizerFileItem *parent, const
         while (parent && parent->isTemporary())
             setPermanent(parent);
 
-        bool doRefresh = false;
-
         if (marked) {
             fileCount++;
-            if (autoScroll && markParentDirectories(item))
-                doRefresh = true;
+            if (autoScroll)
+                markParentDirectories(item);
         }
 
+        item->setPosition(resultList.count());
         resultList.append(item);
         emit comparedFileData(item);
 
-        if (doRefresh)
-            refresh(true);
-
-        if (marked && (displayUpdateCount++ % DISPLAY_UPDATE_PERIOD == (DISPLAY_UPDATE_PERIOD - 1)))
+        // the new items are shown in batches, not after every single one
+        if (marked && displayUpdateTimer.elapsed() >= DISPLAY_UPDATE_PERIOD) {
             qApp->processEvents();
+            displayUpdateTimer.start();
+        }
     } else
         temporaryList.append(item);
 
@@ -414,6 +574,8 @@ SynchronizerFileItem * Synchronizer::addItem(SynchronizerFileItem *parent, const
 void Synchronizer::compareContentResult(SynchronizerFileItem * item, bool res)
 {
     item->compareContentResult(res);
+    if (!res && snapshot.isOpen())
+        snapshot.setDifferent(item->leftDirectory());
     bool marked = autoScroll ? isMarked(item->task(), item->existsInLeft() && item->existsInRight()) : false;
     item->setMarked(marked);
     if (marked) {
@@ -429,29 +591,30 @@ void Synchronizer::setPermanent(SynchronizerFileItem *item)
         setPermanent(item->parent());
 
     item->setPermanent();
+    item->setPosition(resultList.count());
     resultList.append(item);
     emit comparedFileData(item);
 }
 
 SynchronizerFileItem * Synchronizer::addLeftOnlyItem(SynchronizerFileItem *parent,
         const QString &file_name, const QString &dir, KIO::filesize_t size,
-        time_t date, const QString &link, const QString &owner,
-        const QString &group, mode_t mode, const QString &acl, bool isDir,
+        time_t date, const QString &link, uid_t owner,
+        gid_t group, mode_t mode, const QString &acl, bool isDir,
         bool isTemp)
 {
     return addItem(parent, file_name, file_name, dir, dir, true, false, size, 0, date, 0, link, QString(),
-                   owner, QString(), group, QString(), mode, (mode_t) - 1, acl, QString(),
+                   owner, (uid_t) - 1, group, (gid_t) - 1, mode, (mode_t) - 1, acl, QString(),
                    asymmetric ? TT_DELETE : TT_COPY_TO_RIGHT, isDir, isTemp);
 }
 
 SynchronizerFileItem * Synchronizer::addRightOnlyItem(SynchronizerFileItem *parent,
         const QString &file_name, const QString &dir, KIO::filesize_t size,
-        time_t date, const QString &link, const QString &owner,
-        const QString &group, mode_t mode, const QString &acl, bool isDir,
+        time_t date, const QString &link, uid_t owner,
+        gid_t group, mode_t mode, const QString &acl, bool isDir,
         bool isTemp)
 {
     return addItem(parent, file_name, file_name, dir, dir, false, true, 0, size, 0, date, QString(), link,
-                   QString(), owner, QString(), group, (mode_t) - 1, mode, QString(), acl,
+                   (uid_t) - 1, owner, (gid_t) - 1, group, (mode_t) - 1, mode, QString(), acl,
                    TT_COPY_TO_LEFT, isDir, isTemp);
 }
 
@@ -460,8 +623,8 @@ SynchronizerFileItem * Synchronizer::addDuplicateItem(SynchronizerFileItem *pare
         const QString &leftDir, const QString &rightDir,
         KIO::filesize_t leftSize, KIO::filesize_t rightSize, time_t leftDate, time_t rightDate,
         const QString &leftLink, const QString &rightLink,
-        const QString &leftOwner, const QString &rightOwner,
-        const QString &leftGroup, const QString &rightGroup,
+        uid_t leftOwner, uid_t rightOwner,
+        gid_t leftGroup, gid_t rightGroup,
         mode_t leftMode, mode_t rightMode,
         const QString &leftACL, const QString &rightACL,
         bool isDir, bool isTemp)
@@ -529,7 +692,7 @@ void Synchronizer::addSingleDirectory(SynchronizerFileItem *parent, Synchronizer
                                       const QString &dirName, bool isLeft)
 {
     const QString &url = directory->url();
-    vfile               * file;
+    const SynchronizerDirEntry * file;
     QString file_name;
 
     /* walking through the directory files */
@@ -537,23 +700,23 @@ void Synchronizer::addSingleDirectory(SynchronizerFileItem *parent, Synchronizer
         if (isDir(file))
             continue;
 
-        file_name =  file->vfile_getName();
+        file_name =  file->name;
 
-        if (!query->match(file))
+        if (!matches(file, url))
             continue;
 
         if (isLeft)
-            addLeftOnlyItem(parent, file_name, dirName, file->vfile_getSize(), file->vfile_getTime_t(), readLink(file),
-                            file->vfile_getOwner(), file->vfile_getGroup(), file->vfile_getMode(), file->vfile_getACL());
+            addLeftOnlyItem(parent, file_name, dirName, file->size, file->mtime, readLink(file),
+                            file->uid, file->gid, file->mode, remoteACL(file));
         else
-            addRightOnlyItem(parent, file_name, dirName, file->vfile_getSize(), file->vfile_getTime_t(), readLink(file),
-                             file->vfile_getOwner(), file->vfile_getGroup(), file->vfile_getMode(), file->vfile_getACL());
+            addRightOnlyItem(parent, file_name, dirName, file->size, file->mtime, readLink(file),
+                             file->uid, file->gid, file->mode, remoteACL(file));
     }
 
     /* walking through the subdirectories */
     for (file = directory->first(); file != 0 && !stopped; file = directory->next()) {
-        if (file->vfile_isDir() && (followSymLinks || !file->vfile_isSymLink())) {
-            file_name =  file->vfile_getName();
+        if (file->isDir && (followSymLinks || !file->isLink)) {
+            file_name =  file->name;
 
             if (excludedPaths.contains(dirName.isEmpty() ? file_name : dirName + '/' + file_name))
                 continue;
@@ -564,13 +727,13 @@ void Synchronizer::addSingleDirectory(SynchronizerFileItem *parent, Synchronizer
             SynchronizerFileItem *me;
 
             if (isLeft)
-                me = addLeftOnlyItem(parent, file_name, dirName, 0, file->vfile_getTime_t(), readLink(file),
-                                     file->vfile_getOwner(), file->vfile_getGroup(), file->vfile_getMode(),
-                                     file->vfile_getACL(), true, !query->match(file));
+                me = addLeftOnlyItem(parent, file_name, dirName, 0, file->mtime, readLink(file),
+                                     file->uid, file->gid, file->mode,
+                                     remoteACL(file), true, !matches(file, url));
             else
-                me = addRightOnlyItem(parent, file_name, dirName, 0, file->vfile_getTime_t(), readLink(file),
-                                      file->vfile_getOwner(), file->vfile_getGroup(), file->vfile_getMode(),
-                                      file->vfile_getACL(), true, !query->match(file));
+                me = addRightOnlyItem(parent, file_name, dirName, 0, file->mtime, readLink(file),
+                                      file->uid, file->gid, file->mode,
+                                      remoteACL(file), true, !matches(file, url));
             stack.append(new CompareTask(me, url + file_name + '/',
                                          dirName.isEmpty() ? file_name : dirName + '/' + file_name, isLeft, ignoreHidden));
         }
@@ -610,17 +773,18 @@ bool Synchronizer::isMarked(TaskType task, bool isDuplicate)
     }
 }
 
-bool Synchronizer::markParentDirectories(SynchronizerFileItem *item)
+bool Synchronizer::markParentDirectories(SynchronizerFileItem *item, bool notify)
 {
     if (item->parent() == 0 || item->parent()->isMarked())
         return false;
 
-    markParentDirectories(item->parent());
+    markParentDirectories(item->parent(), notify);
 
     item->parent()->setMarked(true);
 
     fileCount++;
-    emit markChanged(item->parent(), false);
+    if (notify)
+        emit markChanged(item->parent(), false);
     return true;
 }
 
@@ -636,16 +800,12 @@ int Synchronizer::refresh(bool nostatus)
         item->setMarked(marked);
 
         if (marked) {
-            markParentDirectories(item);
+            markParentDirectories(item, false);
             fileCount++;
         }
     }
 
-    it.toFront();
-    while (it.hasNext()) {
-        SynchronizerFileItem * item = it.next();
-        emit markChanged(item, false);
-    }
+    emit markingRefreshed();
 
     if (!nostatus)
         emit statusInfo(i18n("Number of files: %1", fileCount));
@@ -835,6 +995,8 @@ void Synchronizer::swapSides()
     leftBaseDir = rightBaseDir;
     rightBaseDir = leftTmp;
 
+    snapshot.close();
+
     QListIterator<SynchronizerFileItem *> it(resultList);
     while (it.hasNext()) {
         SynchronizerFileItem * item = it.next();
@@ -854,77 +1016,254 @@ void Synchronizer::setScrolling(bool scroll)
 }
 
 void Synchronizer::synchronize(QWidget *syncWdg, bool leftCopyEnabled, bool rightCopyEnabled,
-                               bool deleteEnabled, bool overWrite, int parThreads)
+                               bool deleteEnabled, bool overWrite, int parThreads, bool deltaCopy)
 {
     this->leftCopyEnabled   = leftCopyEnabled;
     this->rightCopyEnabled  = rightCopyEnabled;
     this->deleteEnabled     = deleteEnabled;
     this->overWrite         = overWrite;
+    this->deltaCopy         = deltaCopy;
     this->parallelThreads   = parThreads;
     this->syncDlgWidget     = syncWdg;
 
-    autoSkip = paused = disableNewTasks = false;
+    autoSkip = paused = syncFailed = false;
 
     leftCopyNr = rightCopyNr = deleteNr = 0;
     leftCopySize = rightCopySize = deleteSize = 0;
 
     inTaskFinished = 0;
-    lastTask = 0;
 
     jobMap.clear();
+    batchMap.clear();
     receivedMap.clear();
+    transferQueues.clear();
+    waitingTasks.clear();
+    unfinishedDirs.clear();
+    unbatchedTasks.clear();
+
+    KConfigGroup group(krConfig, "Synchronize");
+    transfersPerHost = qMax(group.readEntry("Transfers Per Host", _TransfersPerHost), 1);
+    deltaCopyMinSize = (KIO::filesize_t)qMax(group.readEntry("Delta Copy Min Size", _DeltaCopyMinSize), 0) << 20;
+
+    // a task waits only for the creation of its own directory, not for every earlier mkdir
+    QListIterator<SynchronizerFileItem *> it(resultList);
+    while (it.hasNext()) {
+        SynchronizerFileItem *item = it.next();
+        if (!isEnabledTask(item))
+            continue;
+
+        SynchronizerFileItem *dir = item->parent();
+        while (dir && !unfinishedDirs.contains(dir))
+            dir = dir->parent();
+
+        if (item->isDir())
+            unfinishedDirs.insert(item);
+
+        if (dir)
+            waitingTasks[ dir ].append(item);
+        else
+            queueTask(item);
+    }
 
-    resultListIt = resultList;
     synchronizeLoop();
 }
 
 void Synchronizer::synchronizeLoop()
 {
-    if (disableNewTasks) {
-        if (!resultListIt.hasNext() && jobMap.count() == 0)
-            emit synchronizationFinished();
-        return;
+    while (jobMap.count() + batchMap.count() < parallelThreads && startNextTransfer())
+        ;
+
+    if (jobMap.isEmpty() && batchMap.isEmpty() && transferQueues.isEmpty() && waitingTasks.isEmpty())
+        finishSynchronization();
+}
+
+void Synchronizer::finishSynchronization()
+{
+    // the equal directories were not touched, the changed ones are compared again next time
+    if (!syncFailed)
+        snapshot.save();
+    emit synchronizationFinished();
+}
+
+bool Synchronizer::isEnabledTask(SynchronizerFileItem *item)
+{
+    if (!item->isMarked())
+        return false;
+
+    switch (item->task()) {
+    case TT_COPY_TO_LEFT:
+        return leftCopyEnabled;
+    case TT_COPY_TO_RIGHT:
+        return rightCopyEnabled;
+    case TT_DELETE:
+        return deleteEnabled;
+    default:
+        return false;
     }
+}
 
-    while ((int)jobMap.count() < parallelThreads) {
-        SynchronizerFileItem *task = getNextTask();
-        if (task == 0) {
-            if (jobMap.count() == 0)
-                emit synchronizationFinished();
-            return;
-        }
-        executeTask(task);
-        if (disableNewTasks)
-            break;
+KIO::filesize_t Synchronizer::transferSize(SynchronizerFileItem *item)
+{
+    switch (item->task()) {
+    case TT_COPY_TO_LEFT:
+        return item->rightSize();
+    case TT_COPY_TO_RIGHT:
+        return item->leftSize();
+    default:
+        return 0;
     }
 }
 
-SynchronizerFileItem * Synchronizer::getNextTask()
+QString Synchronizer::destinationHost(SynchronizerFileItem *item)
 {
-    TaskType task;
-    SynchronizerFileItem * currentTask;
+    QUrl url = Synchronizer::fsUrl(item->task() == TT_COPY_TO_RIGHT ? rightBaseDir : leftBaseDir);
+    return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment).toString();
+}
 
-    do {
-        if (!resultListIt.hasNext())
-            return 0;
+void Synchronizer::queueTask(SynchronizerFileItem *item)
+{
+    TransferQueue &queue = transferQueues[ destinationHost(item)];
 
-        currentTask = resultListIt.next();
+    if (item->isDir())
+        queue.dirs.append(item);
+    else if (transferSize(item) >= SMALL_FILE_SIZE)
+        queue.large.append(item);
+    else
+        queue.small.append(item);
+}
 
-        if (currentTask->isMarked()) {
-            task = currentTask->task();
+void Synchronizer::transferFinished(SynchronizerFileItem *item)
+{
+    if (!unfinishedDirs.remove(item))
+        return;
 
-            if (leftCopyEnabled && task == TT_COPY_TO_LEFT)
-                break;
-            else if (rightCopyEnabled && task == TT_COPY_TO_RIGHT)
-                break;
-            else if (deleteEnabled && task == TT_DELETE)
-                break;
+    QListIterator<SynchronizerFileItem *> it(waitingTasks.take(item));
+    while (it.hasNext())
+        queueTask(it.next());
+}
+
+int Synchronizer::runningTransfers(const QString &host, int *largeFiles)
+{
+    int count = 0;
+    *largeFiles = 0;
+
+    QMapIterator<KJob *, SynchronizerFileItem *> it(jobMap);
+    while (it.hasNext()) {
+        SynchronizerFileItem *item = it.next().value();
+        if (destinationHost(item) == host) {
+            count++;
+            if (!item->isDir() && transferSize(item) >= SMALL_FILE_SIZE)
+                (*largeFiles)++;
         }
-    } while (true);
+    }
+
+    QHashIterator<KJob *, TransferBatch> bit(batchMap);
+    while (bit.hasNext()) {
+        if (bit.next().value().host == host)
+            count++;
+    }
+    return count;
+}
+
+bool Synchronizer::startNextTransfer()
+{
+    QMutableMapIterator<QString, TransferQueue> it(transferQueues);
+    while (it.hasNext()) {
+        it.next();
+        TransferQueue &queue = it.value();
+
+        int largeFiles;
+        if (runningTransfers(it.key(), &largeFiles) >= transfersPerHost)
+            continue;
 
-    return lastTask = currentTask;
+        // the directories go first, as the files inside are waiting for them; a large file
+        // is copied together with the small ones to use the bandwidth between the bursts
+        if (!queue.dirs.isEmpty())
+            executeTask(queue.dirs.takeFirst());
+        else if (!queue.large.isEmpty() && (largeFiles == 0 || queue.small.isEmpty()))
+            executeTask(queue.large.takeFirst());
+        else
+            startSmallTransfer(it.key(), queue.small);
+
+        if (queue.dirs.isEmpty() && queue.large.isEmpty() && queue.small.isEmpty())
+            it.remove();
+        return true;
+    }
+    return false;
+}
+
+bool Synchronizer::isBatchable(SynchronizerFileItem *item)
+{
+    // only the new files: the overwrites are confirmed one by one
+    if (item->isDir() || !item->destination().isNull() || unbatchedTasks.contains(item))
+        return false;
+    if (item->task() == TT_COPY_TO_LEFT)
+        return !item->existsInLeft() && item->rightLink().isNull();
+    if (item->task() == TT_COPY_TO_RIGHT)
+        return !item->existsInRight() && item->leftLink().isNull();
+    return false;
 }
 
+void Synchronizer::startSmallTransfer(const QString &host, QList<SynchronizerFileItem *> &small)
+{
+    SynchronizerFileItem *first = small.takeFirst();
+    if (!isBatchable(first)) {
+        executeTask(first);
+        return;
+    }
+
+    QList<SynchronizerFileItem *> items;
+    items.append(first);
+    KIO::filesize_t size = transferSize(first);
+
+    while (!small.isEmpty() && items.count() < BATCH_MAX_FILES && size < BATCH_MAX_SIZE) {
+        SynchronizerFileItem *item = small.first();
+        if (!isBatchable(item) || item->task() != first->task() ||
+                item->leftDirectory() != first->leftDirectory() || item->rightDirectory() != first->rightDirectory())
+            break;
+        items.append(small.takeFirst());
+        size += transferSize(item);
+    }
+
+    if (items.count() == 1) {
+        executeTask(first);
+        return;
+    }
+
+    bool toLeft = first->task() == TT_COPY_TO_LEFT;
+    QString sourceDir = toLeft ? first->rightDirectory() : first->leftDirectory();
+    QString destDir = toLeft ? first->leftDirectory() : first->rightDirectory();
+    if (!sourceDir.isEmpty())
+        sourceDir += '/';
+    if (!destDir.isEmpty())
+        destDir += '/';
+
+    QList<QUrl> sources;
+    QListIterator<SynchronizerFileItem *> it(items);
+    while (it.hasNext()) {
+        SynchronizerFileItem *item = it.next();
+        sources.append(Synchronizer::fsUrl((toLeft ? rightBaseDir : leftBaseDir) + sourceDir +
+                                           (toLeft ? item->rightName() : item->leftName())));
+    }
+    QUrl destURL = Synchronizer::fsUrl((toLeft ? leftBaseDir : rightBaseDir) + destDir);
+
+    // one job copies the files of a directory through a single connection
+    KIO::CopyJob *job = KIO::copy(sources, destURL, KIO::HideProgressInfo);
+    // no dialogs: the files not copied are retried one by one, with the usual error handling
+    job->setUiDelegate(0);
+    connect(job, SIGNAL(copyingDone(KIO::Job *, const QUrl &, const QUrl &, const QDateTime &, bool, bool)),
+            this, SLOT(slotBatchCopyingDone(KIO::Job *, const QUrl &, const QUrl &, const QDateTime &, bool, bool)));
+    connect(job, SIGNAL(processedSize(KJob *, qulonglong)), this,
+            SLOT(slotProcessedSize(KJob *, qulonglong)));
+    connect(job, SIGNAL(result(KJob*)), this, SLOT(slotBatchFinished(KJob*)));
+
+    TransferBatch batch;
+    batch.task = first->task();
+    batch.host = host;
+    batch.items = items;
+    batch.doneSize = 0;
+    batchMap[ job ] = batch;
+}
 
 void Synchronizer::executeTask(SynchronizerFileItem * task)
 {
@@ -944,15 +1283,13 @@ void Synchronizer::executeTask(SynchronizerFileItem * task)
             KIO::SimpleJob *job = KIO::mkdir(leftURL);
             connect(job, SIGNAL(result(KJob*)), this, SLOT(slotTaskFinished(KJob*)));
             jobMap[ job ] = task;
-            disableNewTasks = true;
         } else {
             QUrl destURL(leftURL);
             if (!task->destination().isNull())
                 destURL = Synchronizer::fsUrl(task->destination());
 
             if (task->rightLink().isNull()) {
-                KIO::FileCopyJob *job = KIO::file_copy(rightURL, destURL, -1,
-                                                       ((overWrite || task->overWrite()) ? KIO::Overwrite : KIO::DefaultFlags) | KIO::HideProgressInfo);
+                KJob *job = fileCopyJob(task, rightURL, destURL, task->rightSize(), !task->leftLink().isNull());
                 connect(job, SIGNAL(processedSize(KJob *, qulonglong)), this,
                         SLOT(slotProcessedSize(KJob *, qulonglong)));
                 connect(job, SIGNAL(result(KJob*)), this, SLOT(slotTaskFinished(KJob*)));
@@ -970,15 +1307,13 @@ void Synchronizer::executeTask(SynchronizerFileItem * task)
             KIO::SimpleJob *job = KIO::mkdir(rightURL);
             connect(job, SIGNAL(result(KJob*)), this, SLOT(slotTaskFinished(KJob*)));
             jobMap[ job ] = task;
-            disableNewTasks = true;
         } else {
             QUrl destURL(rightURL);
             if (!task->destination().isNull())
                 destURL = Synchronizer::fsUrl(task->destination());
 
             if (task->leftLink().isNull()) {
-                KIO::FileCopyJob *job = KIO::file_copy(leftURL, destURL, -1,
-                                                       ((overWrite || task->overWrite()) ? KIO::Overwrite : KIO::DefaultFlags) | KIO::HideProgressInfo);
+                KJob *job = fileCopyJob(task, leftURL, destURL, task->leftSize(), !task->rightLink().isNull());
                 connect(job, SIGNAL(processedSize(KJob *, qulonglong)), this,
                         SLOT(slotProcessedSize(KJob *, qulonglong)));
                 connect(job, SIGNAL(result(KJob*)), this, SLOT(slotTaskFinished(KJob*)));
@@ -1002,6 +1337,23 @@ void Synchronizer::executeTask(SynchronizerFileItem * task)
     }
 }
 
+KJob * Synchronizer::fileCopyJob(SynchronizerFileItem *task, const QUrl &source, const QUrl &dest,
+                                  KIO::filesize_t size, bool destIsLink)
+{
+    bool overwrite = overWrite || task->overWrite();
+
+    // a large file existing on both sides is updated in place if it can be written directly
+    if (deltaCopy && overwrite && size >= deltaCopyMinSize && task->existsInLeft() && task->existsInRight() &&
+            task->destination().isNull() && !destIsLink && source.isLocalFile() && dest.isLocalFile()) {
+        SynchronizerDeltaJob *job = new SynchronizerDeltaJob(source.path(), dest.path(), size);
+        job->setUiDelegate(new KIO::JobUiDelegate());
+        job->start();
+        return job;
+    }
+
+    return KIO::file_copy(source, dest, -1, (overwrite ? KIO::Overwrite : KIO::DefaultFlags) | KIO::HideProgressInfo);
+}
+
 void Synchronizer::slotTaskFinished(KJob *job)
 {
     inTaskFinished++;
@@ -1016,9 +1368,6 @@ void Synchronizer::slotTaskFinished(KJob *job)
         receivedMap.remove(job);
     }
 
-    if (disableNewTasks && item == lastTask)
-        disableNewTasks = false; // the blocker task finished
-
     QString leftDirName     = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
     QString rightDirName     = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
     QUrl leftURL = Synchronizer::fsUrl(leftBaseDir + leftDirName + item->leftName());
@@ -1026,91 +1375,19 @@ void Synchronizer::slotTaskFinished(KJob *job)
 
     do {
         if (!job->error()) {
-            switch (item->task()) {
-            case TT_COPY_TO_LEFT:
-                if (leftURL.isLocalFile()) {
-                    struct utimbuf timestamp;
-
-                    timestamp.actime = time(0);
-                    timestamp.modtime = item->rightDate() - timeOffset;
-
-                    utime((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), &timestamp);
-
-                    uid_t newOwnerID = (uid_t) - 1; // chown(2) : -1 means no change
-                    if (!item->rightOwner().isEmpty()) {
-                        struct passwd* pw = getpwnam(QFile::encodeName(item->rightOwner()));
-                        if (pw != 0L)
-                            newOwnerID = pw->pw_uid;
-                    }
-                    gid_t newGroupID = (gid_t) - 1; // chown(2) : -1 means no change
-                    if (!item->rightGroup().isEmpty()) {
-                        struct group* g = getgrnam(QFile::encodeName(item->rightGroup()));
-                        if (g != 0L)
-                            newGroupID = g->gr_gid;
-                    }
-                    chown((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), newOwnerID, (gid_t) - 1);
-                    chown((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), (uid_t) - 1, newGroupID);
-
-                    chmod((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), item->rightMode() & 07777);
-
-#ifdef HAVE_POSIX_ACL
-                    if (!item->rightACL().isNull()) {
-                        acl_t acl = acl_from_text(item->rightACL().toLatin1());
-                        if (acl && !acl_valid(acl))
-                            acl_set_file(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS, acl);
-                        if (acl)
-                            acl_free(acl);
-                    }
-#endif
-                }
-                break;
-            case TT_COPY_TO_RIGHT:
-                if (rightURL.isLocalFile()) {
-                    struct utimbuf timestamp;
-
-                    timestamp.actime = time(0);
-                    timestamp.modtime = item->leftDate() + timeOffset;
-
-                    utime((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), &timestamp);
-
-                    uid_t newOwnerID = (uid_t) - 1; // chown(2) : -1 means no change
-                    if (!item->leftOwner().isEmpty()) {
-                        struct passwd* pw = getpwnam(QFile::encodeName(item->leftOwner()));
-                        if (pw != 0L)
-                            newOwnerID = pw->pw_uid;
-                    }
-                    gid_t newGroupID = (gid_t) - 1; // chown(2) : -1 means no change
-                    if (!item->leftGroup().isEmpty()) {
-                        struct group* g = getgrnam(QFile::encodeName(item->leftGroup()));
-                        if (g != 0L)
-                            newGroupID = g->gr_gid;
-                    }
-                    chown((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), newOwnerID, (uid_t) - 1);
-                    chown((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), (uid_t) - 1, newGroupID);
-
-                    chmod((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), item->leftMode() & 07777);
-
-#ifdef HAVE_POSIX_ACL
-                    if (!item->leftACL().isNull()) {
-                        acl_t acl = acl_from_text(item->leftACL().toLatin1());
-                        if (acl && !acl_valid(acl))
-                            acl_set_file(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS, acl);
-                        if (acl)
-                            acl_free(acl);
-                    }
-#endif
-                }
-                break;
-            default:
-                break;
-            }
+            applyAttributes(item);
         } else {
+            syncFailed = true;
             if (job->error() == KIO::ERR_FILE_ALREADY_EXIST && item->task() != TT_DELETE) {
                 KIO::RenameDialog_Result result;
                 QString newDest;
 
                 if (autoSkip)
                     break;
+                if (SynchronizerTask::isHeadless()) {
+                    SynchronizerTask::showError(syncDlgWidget, job->errorString());
+                    break;
+                }
 
                 KIO::JobUiDelegate *ui = static_cast<KIO::JobUiDelegate*>(job->uiDelegate());
                 ui->setWindow(syncDlgWidget);
@@ -1180,6 +1457,11 @@ void Synchronizer::slotTaskFinished(KJob *job)
                     break;
                 }
 
+                if (SynchronizerTask::isHeadless()) {
+                    SynchronizerTask::showError(syncDlgWidget, error + ' ' + job->errorString());
+                    break;
+                }
+
                 KIO::JobUiDelegate *ui = static_cast<KIO::JobUiDelegate*>(job->uiDelegate());
                 ui->setWindow(syncDlgWidget);
 
@@ -1199,6 +1481,8 @@ void Synchronizer::slotTaskFinished(KJob *job)
         }
     } while (false);
 
+    transferFinished(item);
+
     switch (item->task()) {
     case TT_COPY_TO_LEFT:
         leftCopyNr++;
@@ -1226,10 +1510,81 @@ void Synchronizer::slotTaskFinished(KJob *job)
     }
 }
 
+void Synchronizer::applyAttributes(SynchronizerFileItem *item)
+{
+    QString leftDirName     = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
+    QString rightDirName     = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
+    QUrl leftURL = Synchronizer::fsUrl(leftBaseDir + leftDirName + item->leftName());
+    QUrl rightURL = Synchronizer::fsUrl(rightBaseDir + rightDirName + item->rightName());
+
+    switch (item->task()) {
+    case TT_COPY_TO_LEFT:
+        if (leftURL.isLocalFile()) {
+            struct utimbuf timestamp;
+
+            timestamp.actime = time(0);
+            timestamp.modtime = item->rightDate() - timeOffset;
+
+            utime((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), &timestamp);
+
+            uid_t newOwnerID = item->rightOwner(); // chown(2) : -1 means no change
+            gid_t newGroupID = item->rightGroup();
+            chown((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), newOwnerID, (gid_t) - 1);
+            chown((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), (uid_t) - 1, newGroupID);
+
+            chmod((const char *)(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), item->rightMode() & 07777);
+
+#ifdef HAVE_POSIX_ACL
+            acl_t acl = 0;
+            if (!item->rightACL().isNull())
+                acl = acl_from_text(item->rightACL().toLatin1());
+            else if (rightURL.isLocalFile())
+                acl = acl_get_file(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS);
+            if (acl && !acl_valid(acl))
+                acl_set_file(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS, acl);
+            if (acl)
+                acl_free(acl);
+#endif
+        }
+        break;
+    case TT_COPY_TO_RIGHT:
+        if (rightURL.isLocalFile()) {
+            struct utimbuf timestamp;
+
+            timestamp.actime = time(0);
+            timestamp.modtime = item->leftDate() + timeOffset;
+
+            utime((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), &timestamp);
+
+            uid_t newOwnerID = item->leftOwner(); // chown(2) : -1 means no change
+            gid_t newGroupID = item->leftGroup();
+            chown((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), newOwnerID, (gid_t) - 1);
+            chown((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), (uid_t) - 1, newGroupID);
+
+            chmod((const char *)(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit()), item->leftMode() & 07777);
+
+#ifdef HAVE_POSIX_ACL
+            acl_t acl = 0;
+            if (!item->leftACL().isNull())
+                acl = acl_from_text(item->leftACL().toLatin1());
+            else if (leftURL.isLocalFile())
+                acl = acl_get_file(leftURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS);
+            if (acl && !acl_valid(acl))
+                acl_set_file(rightURL.adjusted(QUrl::StripTrailingSlash).path().toLocal8Bit(), ACL_TYPE_ACCESS, acl);
+            if (acl)
+                acl_free(acl);
+#endif
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 void Synchronizer::slotProcessedSize(KJob * job , qulonglong size)
 {
     KIO::filesize_t dl = 0, dr = 0, dd = 0;
-    SynchronizerFileItem * item = jobMap[ job ];
+    TaskType task = jobMap.contains(job) ? jobMap[ job ]->task() : batchMap[ job ].task;
 
     KIO::filesize_t lastProcessedSize = 0;
     if (receivedMap.contains(job))
@@ -1237,7 +1592,7 @@ void Synchronizer::slotProcessedSize(KJob * job , qulonglong size)
 
     receivedMap[ job ] = size;
 
-    switch (item->task()) {
+    switch (task) {
     case TT_COPY_TO_LEFT:
         dl = size - lastProcessedSize;
         break;
@@ -1254,6 +1609,62 @@ void Synchronizer::slotProcessedSize(KJob * job , qulonglong size)
     emit processedSizes(leftCopyNr, leftCopySize += dl, rightCopyNr, rightCopySize += dr, deleteNr, deleteSize += dd);
 }
 
+void Synchronizer::slotBatchCopyingDone(KIO::Job *job, const QUrl &from, const QUrl &, const QDateTime &, bool, bool)
+{
+    if (!batchMap.contains(job))
+        return;
+
+    TransferBatch &batch = batchMap[ job ];
+    for (int i = 0; i != batch.items.count(); i++) {
+        SynchronizerFileItem *item = batch.items[ i ];
+        const QString &name = batch.task == TT_COPY_TO_LEFT ? item->rightName() : item->leftName();
+        if (name != from.fileName())
+            continue;
+
+        batch.items.removeAt(i);
+        batch.doneSize += transferSize(item);
+        applyAttributes(item);
+        transferFinished(item);
+
+        if (batch.task == TT_COPY_TO_LEFT)
+            leftCopyNr++;
+        else
+            rightCopyNr++;
+        emit processedSizes(leftCopyNr, leftCopySize, rightCopyNr, rightCopySize, deleteNr, deleteSize);
+        break;
+    }
+}
+
+void Synchronizer::slotBatchFinished(KJob *job)
+{
+    inTaskFinished++;
+
+    TransferBatch batch = batchMap.take(job);
+    KIO::filesize_t receivedSize = receivedMap.take(job);
+
+    // the progress reported for the files not copied is taken back
+    if (batch.task == TT_COPY_TO_LEFT)
+        leftCopySize += batch.doneSize - receivedSize;
+    else
+        rightCopySize += batch.doneSize - receivedSize;
+
+    // the remaining files are copied one by one, to get the usual error handling
+    for (int i = batch.items.count() - 1; i >= 0; i--) {
+        SynchronizerFileItem *item = batch.items[ i ];
+        unbatchedTasks.insert(item);
+        transferQueues[ batch.host ].small.prepend(item);
+    }
+
+    emit processedSizes(leftCopyNr, leftCopySize, rightCopyNr, rightCopySize, deleteNr, deleteSize);
+
+    if (--inTaskFinished == 0) {
+        if (paused)
+            emit pauseAccepted();
+        else
+            synchronizeLoop();
+    }
+}
+
 void Synchronizer::pause()
 {
     paused = true;
@@ -1418,23 +1829,47 @@ void Synchronizer::synchronizeWithKGet()
         delete progDlg;
 }
 
-bool Synchronizer::isDir(const vfile * file)
+bool Synchronizer::isDir(const SynchronizerDirEntry * file)
 {
     if (followSymLinks) {
-        return file->vfile_isDir();
+        return file->isDir;
     } else {
-        return file->vfile_isDir() && !file->vfile_isSymLink();
+        return file->isDir && !file->isLink;
     }
 }
 
-QString Synchronizer::readLink(const vfile * file)
+QString Synchronizer::readLink(const SynchronizerDirEntry * file)
 {
-    if (file->vfile_isSymLink())
-        return file->vfile_getSymDest();
+    if (file->isLink)
+        return file->linkDest;
     else
         return QString();
 }
 
+QString Synchronizer::remoteACL(const SynchronizerDirEntry * file)
+{
+    // reading the ACL of a local file costs system calls, it is done only at synchronizing
+    if (file->isLocal)
+        return QString();
+    return file->acl;
+}
+
+bool Synchronizer::matches(const SynchronizerDirEntry * file, const QString &dirUrl)
+{
+    if (!query->matchStat(file->name, file->isDir, file->size, file->mtime))
+        return false;
+    if (!query->needsFileDetails())
+        return true;
+
+    // the permission, owner, mime and content conditions are checked on a temporary vfile
+    QString perm = KRpermHandler::mode2QString(file->mode);
+    if (file->isDir)
+        perm[ 0 ] = 'd';
+    vfile temp(file->name, file->size, perm, file->mtime, file->isLink, false, file->uid, file->gid,
+               QString(), file->linkDest, file->mode, -1, fsUrl(dirUrl + file->name));
+    return query->match(&temp);
+}
+
 SynchronizerFileItem *Synchronizer::getItemAt(unsigned ndx)
 {
     if (ndx < (unsigned)resultList.count())
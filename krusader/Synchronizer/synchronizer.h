@@ -33,8 +33,12 @@
 
 // QtCore
 #include <QObject>
+#include <QHash>
 #include <QMap>
 #include <QList>
+#include <QSet>
+#include <QTime>
+#include <QDateTime>
 // QtGui
 #include <QColor>
 // QtWidgets
@@ -44,31 +48,36 @@
 
 # include "synchronizertask.h"
 #include "synchronizerfileitem.h"
+#include "synchronizersnapshot.h"
 
 class KRQuery;
-class vfile;
+struct SynchronizerDirEntry;
 
 class Synchronizer : public QObject
 {
     Q_OBJECT
 
 private:
-    int     displayUpdateCount;   // the display is refreshed after every x-th change
+    QTime   displayUpdateTimer;   // the display is refreshed at most every DISPLAY_UPDATE_PERIOD ms
 
 public:
     Synchronizer();
     ~Synchronizer();
     int     compare(QString leftURL, QString rightURL, KRQuery *query, bool subDirs, bool symLinks,
                     bool igDate, bool asymm, bool cmpByCnt, bool igCase, bool autoSc, QStringList &selFiles,
-                    int equThres, int timeOffs, int parThreads, bool hiddenFiles);
+                    int equThres, int timeOffs, int parThreads, bool hiddenFiles, bool cachedChecksums,
+                    bool incremental);
     void    stop() {
         stopped = true;
     }
+    bool    useChecksumCache() const {
+        return cmpByContent && checksumCache;
+    }
     void    setMarkFlags(bool left, bool equal, bool differs, bool right, bool dup, bool sing, bool del);
     int     refresh(bool nostatus = false);
     bool    totalSizes(int *, KIO::filesize_t *, int *, KIO::filesize_t *, int *, KIO::filesize_t *);
     void    synchronize(QWidget *, bool leftCopyEnabled, bool rightCopyEnabled, bool deleteEnabled,
-                        bool overWrite, int parThreads);
+                        bool overWrite, int parThreads, bool deltaCopy = false);
     void    synchronizeWithKGet();
     void    setScrolling(bool scroll);
     void    pause();
@@ -99,6 +108,7 @@ public:
 signals:
     void    comparedFileData(SynchronizerFileItem *);
     void    markChanged(SynchronizerFileItem *, bool);
+    void    markingRefreshed();
     void    synchronizationFinished();
     void    processedSizes(int, KIO::filesize_t, int, KIO::filesize_t, int, KIO::filesize_t);
     void    pauseAccepted();
@@ -107,36 +117,54 @@ signals:
 public slots:
     void    slotTaskFinished(KJob*);
     void    slotProcessedSize(KJob * , qulonglong);
+    void    slotBatchCopyingDone(KIO::Job *, const QUrl &, const QUrl &, const QDateTime &, bool, bool);
+    void    slotBatchFinished(KJob*);
 
 private:
-    bool                  isDir(const vfile * file);
-    QString               readLink(const vfile * file);
+    bool                  isDir(const SynchronizerDirEntry * file);
+    QString               readLink(const SynchronizerDirEntry * file);
+    QString               remoteACL(const SynchronizerDirEntry * file);
+    bool                  matches(const SynchronizerDirEntry * file, const QString &dirUrl);
 
     void    compareDirectory(SynchronizerFileItem *, SynchronizerDirList *, SynchronizerDirList *,
                              const QString &leftDir, const QString &rightDir);
     void    addSingleDirectory(SynchronizerFileItem *, SynchronizerDirList *, const QString &, bool);
+    void    countListing(SynchronizerDirList *);
+    bool    skipUnchangedDirectory(CompareTask *);
+    void    finishSynchronization();
     SynchronizerFileItem * addItem(SynchronizerFileItem *, const QString &, const QString &,
                                    const QString &, const QString &, bool, bool, KIO::filesize_t,
                                    KIO::filesize_t, time_t, time_t, const QString &, const QString &,
-                                   const QString &, const QString &, const QString &, const QString &,
+                                   uid_t, uid_t, gid_t, gid_t,
                                    mode_t, mode_t, const QString &, const QString &, TaskType, bool, bool);
     SynchronizerFileItem * addLeftOnlyItem(SynchronizerFileItem *, const QString &, const QString &,
-                                           KIO::filesize_t, time_t, const QString &, const QString &,
-                                           const QString &, mode_t, const QString &, bool isDir = false, bool isTemp = false);
+                                           KIO::filesize_t, time_t, const QString &, uid_t,
+                                           gid_t, mode_t, const QString &, bool isDir = false, bool isTemp = false);
     SynchronizerFileItem * addRightOnlyItem(SynchronizerFileItem *, const QString &, const QString &,
-                                            KIO::filesize_t, time_t, const QString &,  const QString &,
-                                            const QString &, mode_t, const QString &, bool isDir = false, bool isTemp = false);
+                                            KIO::filesize_t, time_t, const QString &, uid_t,
+                                            gid_t, mode_t, const QString &, bool isDir = false, bool isTemp = false);
     SynchronizerFileItem * addDuplicateItem(SynchronizerFileItem *, const QString &, const QString &,
                                             const QString &, const QString &, KIO::filesize_t,
                                             KIO::filesize_t, time_t, time_t, const QString &,
-                                            const QString &, const QString &, const QString &,
-                                            const QString &, const QString &, mode_t, mode_t, const QString &,
+                                            const QString &, uid_t, uid_t, gid_t, gid_t,
+                                            mode_t, mode_t, const QString &,
                                             const QString &, bool isDir = false, bool isTemp = false);
     bool    isMarked(TaskType task, bool dupl);
-    bool    markParentDirectories(SynchronizerFileItem *);
+    bool    markParentDirectories(SynchronizerFileItem *, bool notify = true);
     void    synchronizeLoop();
-    SynchronizerFileItem * getNextTask();
+    bool    isEnabledTask(SynchronizerFileItem *);
+    KIO::filesize_t transferSize(SynchronizerFileItem *);
+    QString destinationHost(SynchronizerFileItem *);
+    void    queueTask(SynchronizerFileItem *);
+    void    transferFinished(SynchronizerFileItem *);
+    int     runningTransfers(const QString &host, int *largeFiles);
+    bool    startNextTransfer();
+    bool    isBatchable(SynchronizerFileItem *);
+    void    startSmallTransfer(const QString &host, QList<SynchronizerFileItem *> &small);
     void    executeTask(SynchronizerFileItem * task);
+    KJob *  fileCopyJob(SynchronizerFileItem *task, const QUrl &source, const QUrl &dest,
+                        KIO::filesize_t size, bool destIsLink);
+    void    applyAttributes(SynchronizerFileItem *);
     void    setPermanent(SynchronizerFileItem *);
     void    operate(SynchronizerFileItem *item, void (*)(SynchronizerFileItem *));
     void    compareLoop();
@@ -154,10 +182,12 @@ protected:
     bool                              ignoreDate;     // don't use date info at comparing
     bool                              asymmetric;     // asymmetric directory update
     bool                              cmpByContent;   // compare the files by content
+    bool                              checksumCache;  // reuse the checksums of the unchanged files at comparing by content
     bool                              ignoreCase;     // case insensitive synchronization for Windows fs
     bool                              autoScroll;     // automatic update of the directory
     QList<SynchronizerFileItem *>     resultList;     // the found files
     QList<SynchronizerFileItem *>     temporaryList;  // temporary files
+    SynchronizerFileItemArena         itemArena;      // the memory of the found and temporary files
     QString                           leftBaseDir;    // the left-side base directory
     QString                           rightBaseDir;   // the right-side base directory
     QStringList                       excludedPaths;  // list of the excluded paths
@@ -180,9 +210,10 @@ protected:
     bool                              rightCopyEnabled;// copy to right is enabled at synchronize
     bool                              deleteEnabled;  // delete is enabled at synchronize
     bool                              overWrite;      // overwrite or query each modification
+    bool                              deltaCopy;      // update the changed local files in place
+    KIO::filesize_t                   deltaCopyMinSize;// the smaller files are copied entirely
     bool                              autoSkip;       // automatic skipping
     bool                              paused;         // pause flag
-    bool                              disableNewTasks;// at mkdir the further task creation is disabled
 
     int                               leftCopyNr;     // the file number copied to left
     int                               rightCopyNr;    // the file number copied to right
@@ -193,19 +224,43 @@ protected:
     KIO::filesize_t                   deleteSize;     // the size of the deleted files
 
     int                               comparedDirs;   // the number of the compared directories
+    int                               unchangedDirs;  // the directories skipped as unchanged since the snapshot
     int                               fileCount;      // the number of counted files
+    qint64                            listedEntries;  // the number of the listed directory entries
+    qint64                            listingTime;    // the summed time of the listings in ms
 
 private:
+    struct TransferQueue {
+        QList<SynchronizerFileItem *> dirs;           // the directories to create or delete
+        QList<SynchronizerFileItem *> small;          // the small files, copied in batches
+        QList<SynchronizerFileItem *> large;          // the large files
+    };
+
+    struct TransferBatch {
+        TaskType                      task;           // the direction of the copy
+        QString                       host;           // the destination host
+        QList<SynchronizerFileItem *> items;          // the files not copied yet
+        KIO::filesize_t               doneSize;       // the size of the copied files
+    };
+
     QList<SynchronizerTask *>         stack;          // stack for comparing
     QMap<KJob *, SynchronizerFileItem *> jobMap;  // job maps
     QMap<KJob *, KIO::filesize_t>      receivedMap;   // the received file size
-    SynchronizerFileItem             *lastTask;       // reference to the last stack
+    QHash<KJob *, TransferBatch>      batchMap;       // the jobs copying several small files
+    QMap<QString, TransferQueue>      transferQueues; // the tasks ready to start by destination host
+    QHash<SynchronizerFileItem *, QList<SynchronizerFileItem *> > waitingTasks; // the tasks waiting for their directory
+    QSet<SynchronizerFileItem *>      unfinishedDirs; // the directory tasks not finished yet
+    QSet<SynchronizerFileItem *>      unbatchedTasks; // the files failed in a batch, retried alone
+    int                               transfersPerHost;// the maximum number of jobs for a destination host
     int                               inTaskFinished; // counter of quasy 'threads' in slotTaskFinished
 
     QStringList                       selectedFiles;  // the selected files to compare
     QWidget                          *parentWidget;   // the parent widget
     QWidget                          *syncDlgWidget;  // the synchronizer dialog widget
-    QListIterator<SynchronizerFileItem *> resultListIt; // iterator for result list
+
+    SynchronizerSnapshot              snapshot;       // the equal directories of the last synchronization
+    QHash<QString, SynchronizerSnapshot::Folder> folderStates; // the states of the directories being compared
+    bool                              syncFailed;     // an error occurred at synchronizing
 };
 
 class QProgressBar;
@@ -0,0 +1,141 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+
+#include "synchronizerchecksumcache.h"
+
+// QtCore
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#define CHECKSUM_CACHE_MAGIC      0x4b524353  // "KRCS"
+#define CHECKSUM_CACHE_VERSION    2
+// above this size only the checksums used in the session are saved
+#define CHECKSUM_CACHE_MAX_ENTRIES 200000
+// the five numbers of the key and the length of the checksum
+#define CHECKSUM_CACHE_MIN_ENTRY_SIZE (5 * 8 + 4)
+
+uint qHash(const SynchronizerChecksumCache::Key &key, uint seed)
+{
+    return qHash(key.inode, seed) ^ qHash(key.device) ^ qHash(key.size) ^ qHash(key.mtime) ^ qHash(key.ctime);
+}
+
+static QString cacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) +
+           QStringLiteral("/krusader/synchronizer-checksums");
+}
+
+SynchronizerChecksumCache *SynchronizerChecksumCache::instance()
+{
+    static SynchronizerChecksumCache cache;
+    return &cache;
+}
+
+SynchronizerChecksumCache::SynchronizerChecksumCache() : loaded(false), modified(false)
+{
+}
+
+QByteArray SynchronizerChecksumCache::find(const Key &key)
+{
+    QMutexLocker locker(&mutex);
+    load();
+    QHash<Key, Entry>::iterator it = entries.find(key);
+    if (it == entries.end())
+        return QByteArray();
+    it->used = true;
+    return it->checksum;
+}
+
+void SynchronizerChecksumCache::insert(const Key &key, const QByteArray &checksum)
+{
+    QMutexLocker locker(&mutex);
+    load();
+    Entry entry = { checksum, true };
+    entries.insert(key, entry);
+    modified = true;
+}
+
+void SynchronizerChecksumCache::load()
+{
+    if (loaded)
+        return;
+    loaded = true;
+
+    QFile file(cacheFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if (stream.status() != QDataStream::Ok || magic != CHECKSUM_CACHE_MAGIC || version != CHECKSUM_CACHE_VERSION)
+        return;
+
+    // a damaged file must not make us reserve more entries than it can hold
+    if (count > (file.size() - file.pos()) / CHECKSUM_CACHE_MIN_ENTRY_SIZE)
+        return;
+
+    entries.reserve(count);
+    for (quint32 i = 0; i != count; ++i) {
+        Key key;
+        Entry entry;
+        stream >> key.device >> key.inode >> key.size >> key.mtime >> key.ctime >> entry.checksum;
+        if (stream.status() != QDataStream::Ok)
+            break;
+        entry.used = false;
+        entries.insert(key, entry);
+    }
+}
+
+void SynchronizerChecksumCache::save()
+{
+    QMutexLocker locker(&mutex);
+    if (!modified)
+        return;
+
+    // the checksums of the files not seen for a while are dropped when the cache is too big
+    const bool usedOnly = entries.count() > CHECKSUM_CACHE_MAX_ENTRIES;
+    quint32 count = 0;
+    for (QHash<Key, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        if (!usedOnly || it->used)
+            ++count;
+    }
+
+    QDir().mkpath(QFileInfo(cacheFileName()).absolutePath());
+    QSaveFile file(cacheFileName());
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << (quint32)CHECKSUM_CACHE_MAGIC << (quint32)CHECKSUM_CACHE_VERSION << count;
+    for (QHash<Key, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        if (usedOnly && !it->used)
+            continue;
+        const Key &key = it.key();
+        stream << key.device << key.inode << key.size << key.mtime << key.ctime << it->checksum;
+    }
+
+    if (file.commit())
+        modified = false;
+}
@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+
+#ifndef SYNCHRONIZERCHECKSUMCACHE_H
+#define SYNCHRONIZERCHECKSUMCACHE_H
+
+#include <sys/types.h>
+
+// QtCore
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+
+/**
+ * Checksums of the files compared by content, kept across the synchronizer runs.
+ *
+ * A checksum is identified by the device, inode, size and the modification and status change
+ * times of the file in nanoseconds, so a modified file gets a new one even within a second. If
+ * both sides of a comparison are known, the files are not read at all. The cache is stored in
+ * the Krusader data folder, it is thread safe.
+ */
+class SynchronizerChecksumCache
+{
+public:
+    struct Key {
+        quint64 device;
+        quint64 inode;
+        quint64 size;
+        qint64  mtime;    // nanoseconds
+        qint64  ctime;    // nanoseconds
+
+        bool operator==(const Key &other) const {
+            return device == other.device && inode == other.inode && size == other.size &&
+                   mtime == other.mtime && ctime == other.ctime;
+        }
+    };
+
+    static SynchronizerChecksumCache *instance();
+
+    /// returns an empty array if the checksum is not known
+    QByteArray find(const Key &key);
+    void insert(const Key &key, const QByteArray &checksum);
+    /// writes the changes to the disk
+    void save();
+
+private:
+    SynchronizerChecksumCache();
+    void load();
+
+    struct Entry {
+        QByteArray checksum;
+        bool       used;      // looked up or inserted in this session
+    };
+
+    QMutex             mutex;
+    QHash<Key, Entry>  entries;
+    bool               loaded;
+    bool               modified;
+};
+
+uint qHash(const SynchronizerChecksumCache::Key &key, uint seed = 0);
+
+#endif /* SYNCHRONIZERCHECKSUMCACHE_H */
@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "synchronizerdeltajob.h"
+#include "synchronizertask.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <qplatformdefs.h>
+// QtCore
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#define DELTA_BLOCK_SIZE        1048576
+#define DELTA_PROGRESS_PERIOD   200       // ms
+
+struct SynchronizerDeltaJob::State
+{
+    QMutex                  mutex;
+    SynchronizerDeltaJob   *owner;     // guarded by mutex, 0 if the job was deleted or killed
+    QAtomicInt              cancelled;
+    QAtomicInteger<qint64>  processed; // the processed size of the source
+    QString                 source;
+    QString                 destination;
+    int                     error;     // KIO error code, 0 on success
+    QString                 errorPath;
+};
+
+namespace {
+class DeltaCopyWorker : public QRunnable
+{
+public:
+    explicit DeltaCopyWorker(const QSharedPointer<SynchronizerDeltaJob::State> &state) : state(state) {}
+
+    void run() Q_DECL_OVERRIDE {
+        if (!state->cancelled.load())
+            update();
+
+        QMutexLocker locker(&state->mutex);
+        if (state->owner)
+            QMetaObject::invokeMethod(state->owner, "slotWorkerDone", Qt::QueuedConnection);
+    }
+
+private:
+    void setError(int error, const QString &path) {
+        state->error = error;
+        state->errorPath = path;
+    }
+
+    void update() {
+        int sourceFd = QT_OPEN(QFile::encodeName(state->source).constData(), O_RDONLY);
+        if (sourceFd < 0) {
+            setError(KIO::ERR_CANNOT_OPEN_FOR_READING, state->source);
+            return;
+        }
+        int destFd = QT_OPEN(QFile::encodeName(state->destination).constData(), O_RDWR);
+        if (destFd < 0) {
+            QT_CLOSE(sourceFd);
+            setError(KIO::ERR_CANNOT_OPEN_FOR_WRITING, state->destination);
+            return;
+        }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(sourceFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(destFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        updateFds(sourceFd, destFd);
+        QT_CLOSE(sourceFd);
+        if (QT_CLOSE(destFd) != 0 && state->error == 0)
+            setError(KIO::ERR_COULD_NOT_WRITE, state->destination);
+    }
+
+    void updateFds(int sourceFd, int destFd) {
+        QByteArray sourceBuffer(DELTA_BLOCK_SIZE, 0);
+        QByteArray destBuffer(DELTA_BLOCK_SIZE, 0);
+        qint64 offset = 0;
+
+        while (!state->cancelled.load()) {
+            qint64 sourceLen = readBlock(sourceFd, sourceBuffer.data(), offset);
+            if (sourceLen < 0) {
+                setError(KIO::ERR_COULD_NOT_READ, state->source);
+                return;
+            }
+            if (sourceLen == 0)
+                break;
+
+            qint64 destLen = readBlock(destFd, destBuffer.data(), offset);
+            if (destLen < 0) {
+                setError(KIO::ERR_COULD_NOT_READ, state->destination);
+                return;
+            }
+
+            if (destLen < sourceLen || memcmp(sourceBuffer.constData(), destBuffer.constData(), sourceLen) != 0) {
+                if (!writeBlock(destFd, sourceBuffer.constData(), sourceLen, offset)) {
+                    setError(errno == ENOSPC ? KIO::ERR_DISK_FULL : KIO::ERR_COULD_NOT_WRITE, state->destination);
+                    return;
+                }
+            }
+
+            offset += sourceLen;
+            state->processed = offset;
+        }
+
+        if (state->cancelled.load())
+            return;
+
+        QT_STATBUF destStat;
+        if (QT_FSTAT(destFd, &destStat) != 0 || (destStat.st_size != offset && QT_FTRUNCATE(destFd, offset) != 0))
+            setError(KIO::ERR_COULD_NOT_WRITE, state->destination);
+    }
+
+    // reads a whole block unless the end of the file is reached
+    static qint64 readBlock(int fd, char *buffer, qint64 offset) {
+        qint64 done = 0;
+        while (done < DELTA_BLOCK_SIZE) {
+            ssize_t len = pread(fd, buffer + done, DELTA_BLOCK_SIZE - done, offset + done);
+            if (len < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if (len == 0)
+                break;
+            done += len;
+        }
+        return done;
+    }
+
+    static bool writeBlock(int fd, const char *buffer, qint64 size, qint64 offset) {
+        qint64 done = 0;
+        while (done < size) {
+            ssize_t len = pwrite(fd, buffer + done, size - done, offset + done);
+            if (len < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            done += len;
+        }
+        return true;
+    }
+
+    QSharedPointer<SynchronizerDeltaJob::State> state;
+};
+}
+
+SynchronizerDeltaJob::SynchronizerDeltaJob(const QString &source, const QString &destination,
+                                           KIO::filesize_t size) : state(new State)
+{
+    state->owner = this;
+    state->source = source;
+    state->destination = destination;
+    state->error = 0;
+
+    setCapabilities(KJob::Killable);
+    setTotalAmount(KJob::Bytes, size);
+
+    progressTimer.setInterval(DELTA_PROGRESS_PERIOD);
+    connect(&progressTimer, SIGNAL(timeout()), this, SLOT(slotUpdateProgress()));
+}
+
+SynchronizerDeltaJob::~SynchronizerDeltaJob()
+{
+    detachWorker();
+}
+
+void SynchronizerDeltaJob::start()
+{
+    SynchronizerTask::workerPool()->start(new DeltaCopyWorker(state));
+    progressTimer.start();
+}
+
+bool SynchronizerDeltaJob::doKill()
+{
+    detachWorker();
+    return true;
+}
+
+void SynchronizerDeltaJob::detachWorker()
+{
+    progressTimer.stop();
+
+    QMutexLocker locker(&state->mutex);
+    state->owner = 0;
+    state->cancelled = 1;
+}
+
+QString SynchronizerDeltaJob::errorString() const
+{
+    return KIO::buildErrorString(error(), errorText());
+}
+
+void SynchronizerDeltaJob::slotUpdateProgress()
+{
+    setProcessedAmount(KJob::Bytes, state->processed.load());
+}
+
+void SynchronizerDeltaJob::slotWorkerDone()
+{
+    progressTimer.stop();
+    slotUpdateProgress();
+
+    if (state->error) {
+        setError(state->error);
+        setErrorText(state->errorPath);
+    }
+    emitResult();
+}
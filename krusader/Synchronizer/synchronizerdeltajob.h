@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef SYNCHRONIZERDELTAJOB_H
+#define SYNCHRONIZERDELTAJOB_H
+
+// QtCore
+#include <QSharedPointer>
+#include <QString>
+#include <QTimer>
+
+#include <KCoreAddons/KJob>
+#include <KIO/Global>
+
+/**
+ * Updates a changed local file in place from its new version.
+ *
+ * The source and the destination are read block by block, and only the blocks which differ
+ * are written; a longer destination is truncated. For large files with a few changes (disk
+ * images, database dumps) this writes a small fraction of the data of a full copy. The work
+ * is done by the synchronizer's worker pool, the job reports the processed size of the source
+ * like a KIO::FileCopyJob. An interrupted update leaves a partially updated destination.
+ */
+class SynchronizerDeltaJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    struct State;
+
+    SynchronizerDeltaJob(const QString &source, const QString &destination, KIO::filesize_t size);
+    virtual ~SynchronizerDeltaJob();
+
+    virtual void start() Q_DECL_OVERRIDE;
+    virtual QString errorString() const Q_DECL_OVERRIDE;
+
+protected:
+    virtual bool doKill() Q_DECL_OVERRIDE;
+
+protected slots:
+    void slotUpdateProgress();
+    void slotWorkerDone();
+
+private:
+    void detachWorker();
+
+    QSharedPointer<State> state;    // shared with the worker, which may outlive the job
+    QTimer                progressTimer;
+};
+
+#endif /* SYNCHRONIZERDELTAJOB_H */
@@ -37,75 +37,121 @@
 #endif
 #endif
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <qplatformdefs.h>
 // QtCore
-#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
 // QtWidgets
 #include <QApplication>
 
 #include <KI18n/KLocalizedString>
 #include <KIOCore/KFileItem>
-#include <KIO/JobUiDelegate>
-#include <KWidgetsAddons/KMessageBox>
 
-#include "../VFS/vfs.h"
+#include "synchronizertask.h"
 #include "../VFS/krpermhandler.h"
 #include "../krservices.h"
 
-SynchronizerDirList::SynchronizerDirList(QWidget *w, bool hidden) : QObject(), QHash<QString, vfile *>(), fileIterator(0),
-        parentWidget(w), busy(false), result(false), ignoreHidden(hidden), currentUrl()
+/**
+ * A local folder read by the worker pool. The listing is shared between the reader and the
+ * dir list, which may be deleted before the reader is finished.
+ */
+struct SynchronizerDirList::LocalListing
 {
-}
-
-SynchronizerDirList::~SynchronizerDirList()
+    QMutex                        mutex;
+    SynchronizerDirList          *owner;      // guarded by mutex, 0 if the dir list was deleted
+    QAtomicInt                    cancelled;
+    QString                       path;
+    bool                          ok;
+    int                           elapsed;    // the milliseconds spent reading, without the queuing
+    QVector<SynchronizerDirEntry> entries;    // handed over to the owner in slotLocalListingDone()
+};
+
+namespace {
+class LocalDirReader : public QRunnable
 {
-    if (fileIterator)
-        delete fileIterator;
+public:
+    explicit LocalDirReader(const QSharedPointer<SynchronizerDirList::LocalListing> &listing,
+                            bool ignoreHidden) : listing(listing), ignoreHidden(ignoreHidden) {}
+
+    void run() Q_DECL_OVERRIDE {
+        QVector<SynchronizerDirEntry> entries;
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = SynchronizerDirList::readLocalDir(listing->path, ignoreHidden, entries, &listing->cancelled);
+        const int elapsed = timer.elapsed();
+
+        QMutexLocker locker(&listing->mutex);
+        if (!listing->owner)
+            return;
+        listing->ok = ok;
+        listing->elapsed = elapsed;
+        listing->entries.swap(entries);
+        QMetaObject::invokeMethod(listing->owner, "slotLocalListingDone", Qt::QueuedConnection);
+    }
 
-    QHashIterator< QString, vfile *> lit(*this);
-    while (lit.hasNext())
-        delete lit.next().value();
+private:
+    QSharedPointer<SynchronizerDirList::LocalListing> listing;
+    bool ignoreHidden;
+};
 }
 
-vfile * SynchronizerDirList::search(const QString &name, bool ignoreCase)
+SynchronizerDirList::SynchronizerDirList(QWidget *w, bool hidden) : QObject(), iterator(0),
+        parentWidget(w), busy(false), result(false), ignoreHidden(hidden), currentUrl(), elapsed(0)
 {
-    if (!ignoreCase) {
-        if (!contains(name))
-            return 0;
-        return (*this)[ name ];
-    }
-
-    QHashIterator<QString, vfile *> iter(*this);
-    iter.toFront();
-
-    QString file = name.toLower();
+}
 
-    while (iter.hasNext()) {
-        vfile * item = iter.next().value();
-        if (file == item->vfile_getName().toLower())
-            return item;
+SynchronizerDirList::~SynchronizerDirList()
+{
+    if (localListing) {
+        QMutexLocker locker(&localListing->mutex);
+        localListing->owner = 0;
+        localListing->cancelled = 1;
     }
-    return 0;
 }
 
-vfile * SynchronizerDirList::first()
+const SynchronizerDirEntry * SynchronizerDirList::search(const QString &name, bool ignoreCase)
 {
-    if (fileIterator == 0)
-        fileIterator = new QHashIterator<QString, vfile *> (*this);
+    // an exact match is preferred even when the case is ignored
+    int pos = nameIndex.value(name, -1);
+    if (pos < 0 && ignoreCase)
+        pos = lowerCaseIndex.value(name.toLower(), -1);
+    return pos < 0 ? 0 : &dirEntries.at(pos);
+}
 
-    fileIterator->toFront();
-    if (fileIterator->hasNext())
-        return fileIterator->next().value();
-    return 0;
+void SynchronizerDirList::indexEntry(int pos)
+{
+    const QString &name = dirEntries.at(pos).name;
+    nameIndex.insert(name, pos);
+
+    // if the names differ only in case, the smallest one wins, whatever the listing order is
+    const QString lowerName = name.toLower();
+    QHash<QString, int>::iterator it = lowerCaseIndex.find(lowerName);
+    if (it == lowerCaseIndex.end())
+        lowerCaseIndex.insert(lowerName, pos);
+    else if (name < dirEntries.at(it.value()).name)
+        it.value() = pos;
 }
 
-vfile * SynchronizerDirList::next()
+const SynchronizerDirEntry * SynchronizerDirList::first()
 {
-    if (fileIterator == 0)
-        fileIterator = new QHashIterator<QString, vfile *> (*this);
+    iterator = 0;
+    return next();
+}
 
-    if (fileIterator->hasNext())
-        return fileIterator->next().value();
+const SynchronizerDirEntry * SynchronizerDirList::next()
+{
+    if (iterator < dirEntries.count())
+        return &dirEntries.at(iterator++);
     return 0;
 }
 
@@ -117,76 +163,33 @@ bool SynchronizerDirList::load(const QString &urlIn, bool wait)
     currentUrl = urlIn;
     QUrl url = QUrl::fromUserInput(urlIn, QString(), QUrl::AssumeLocalFile);
 
-    QHashIterator< QString, vfile *> lit(*this);
-    while (lit.hasNext())
-        delete lit.next().value();
-    clear();
-    if (fileIterator) {
-        delete fileIterator;
-        fileIterator = 0;
-    }
+    dirEntries.clear();
+    nameIndex.clear();
+    lowerCaseIndex.clear();
+    iterator = 0;
+    elapsed = 0;
 
     if (url.isLocalFile()) {
         QString path = url.adjusted(QUrl::StripTrailingSlash).path();
-        QT_DIR* dir = QT_OPENDIR(path.toLocal8Bit());
-        if (!dir)  {
-            KMessageBox::error(parentWidget, i18n("Cannot open the folder %1.", path), i18n("Error"));
-            emit finished(result = false);
-            return false;
+        if (wait) {
+            QElapsedTimer timer;
+            timer.start();
+            bool ok = readLocalDir(path, ignoreHidden, dirEntries);
+            localListingDone(ok, path, timer.elapsed());
+            return ok;
         }
 
-        QT_DIRENT* dirEnt;
-        QString name;
-
-        while ((dirEnt = QT_READDIR(dir)) != NULL) {
-            name = QString::fromLocal8Bit(dirEnt->d_name);
-
-            if (name == "." || name == "..") continue;
-            if (ignoreHidden && name.startsWith('.')) continue;
-
-            QString fullName = path + '/' + name;
-
-            QT_STATBUF stat_p;
-            QT_LSTAT(fullName.toLocal8Bit(), &stat_p);
-
-            QString perm = KRpermHandler::mode2QString(stat_p.st_mode);
-
-            bool symLink = S_ISLNK(stat_p.st_mode);
-            QString symlinkDest;
-            bool brokenLink = false;
-
-            if (symLink) {  // who the link is pointing to ?
-                char symDest[256];
-                memset(symDest, 0, 256);
-                int endOfName = 0;
-                endOfName = readlink(fullName.toLocal8Bit(), symDest, 256);
-                if (endOfName != -1) {
-                    QString absSymDest = symlinkDest = QString::fromLocal8Bit(symDest);
-
-                    if (!absSymDest.startsWith('/'))
-                        absSymDest = QDir::cleanPath(path + '/' + absSymDest);
-
-                    if (QDir(absSymDest).exists())
-                        perm[0] = 'd';
-                    if (!QDir(path).exists(absSymDest))
-                        brokenLink = true;
-                }
-            }
-
-            QString mime;
-
-            QUrl fileURL = QUrl::fromLocalFile(fullName);
-
-            vfile* item = new vfile(name, stat_p.st_size, perm, stat_p.st_mtime, symLink, brokenLink, stat_p.st_uid,
-                                    stat_p.st_gid, mime, symlinkDest, stat_p.st_mode, -1, fileURL);
-
-            insert(name, item);
-        }
-
-        QT_CLOSEDIR(dir);
-        emit finished(result = true);
+        // the folder is read by a worker thread, finished() is emitted when it is done
+        localListing = QSharedPointer<LocalListing>(new LocalListing);
+        localListing->owner = this;
+        localListing->path = path;
+        localListing->ok = false;
+        localListing->elapsed = 0;
+        busy = true;
+        SynchronizerTask::workerPool()->start(new LocalDirReader(localListing, ignoreHidden));
         return true;
     } else {
+        listingTimer.start();
         KIO::Job *job = KIO::listDir(KrServices::escapeFileUrl(url), KIO::HideProgressInfo, true);
         connect(job, SIGNAL(entries(KIO::Job*, const KIO::UDSEntryList&)),
                 this, SLOT(slotEntries(KIO::Job*, const KIO::UDSEntryList&)));
@@ -203,34 +206,132 @@ bool SynchronizerDirList::load(const QString &urlIn, bool wait)
     }
 }
 
+bool SynchronizerDirList::readLocalDir(const QString &path, bool ignoreHidden, QVector<SynchronizerDirEntry> &entries,
+                                       const QAtomicInt *cancelled)
+{
+    // the files are stat-ed relative to the folder's descriptor, so the kernel doesn't
+    // resolve the whole path again for each of them
+    int dirFd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0)
+        return false;
+    DIR *dir = fdopendir(dirFd);
+    if (!dir) {
+        ::close(dirFd);
+        return false;
+    }
+
+    QByteArray linkBuffer;
+    struct dirent *dirEnt;
+
+    while ((dirEnt = readdir(dir)) != NULL && !(cancelled && cancelled->load())) {
+        const char *localName = dirEnt->d_name;
+        if (localName[ 0 ] == '.') {
+            if (localName[ 1 ] == 0 || (localName[ 1 ] == '.' && localName[ 2 ] == 0))
+                continue;
+            if (ignoreHidden)
+                continue;
+        }
+
+        struct stat stat_p;
+        if (fstatat(dirFd, localName, &stat_p, AT_SYMLINK_NOFOLLOW) != 0)
+            continue; // deleted since it was listed
+
+        SynchronizerDirEntry entry;
+        entry.name = QString::fromLocal8Bit(localName);
+        entry.mtime = stat_p.st_mtime;
+#ifdef Q_OS_LINUX
+        entry.mtimeNsec = (qint64)stat_p.st_mtim.tv_sec * 1000000000 + stat_p.st_mtim.tv_nsec;
+#else
+        entry.mtimeNsec = (qint64)stat_p.st_mtime * 1000000000;
+#endif
+        entry.inode = stat_p.st_ino;
+        entry.mode = stat_p.st_mode;
+        entry.uid = stat_p.st_uid;
+        entry.gid = stat_p.st_gid;
+        entry.isLink = S_ISLNK(stat_p.st_mode);
+        entry.isDir = S_ISDIR(stat_p.st_mode);
+        entry.isLocal = true;
+        entry.size = entry.isDir ? 0 : stat_p.st_size;
+
+        if (entry.isLink) {  // who the link is pointing to ?
+            // the size of a link is the length of its destination
+            linkBuffer.resize(stat_p.st_size > 0 ? stat_p.st_size + 1 : PATH_MAX);
+            ssize_t length = readlinkat(dirFd, localName, linkBuffer.data(), linkBuffer.size());
+            if (length >= 0)
+                entry.linkDest = QString::fromLocal8Bit(linkBuffer.constData(), length);
+
+            struct stat dest_p;
+            entry.isDir = fstatat(dirFd, localName, &dest_p, 0) == 0 && S_ISDIR(dest_p.st_mode);
+        }
+
+        entries.append(entry);
+    }
+
+    closedir(dir); // closes dirFd too
+    return true;
+}
+
+void SynchronizerDirList::slotLocalListingDone()
+{
+    if (!localListing)
+        return;
+
+    QSharedPointer<LocalListing> listing = localListing;
+    localListing.clear();
+
+    {
+        QMutexLocker locker(&listing->mutex);
+        listing->owner = 0;
+        dirEntries.swap(listing->entries);
+    }
+    busy = false;
+    localListingDone(listing->ok, listing->path, listing->elapsed);
+}
+
+void SynchronizerDirList::localListingDone(bool ok, const QString &path, int readingTime)
+{
+    elapsed = readingTime;
+    if (!ok) {
+        dirEntries.clear();
+        SynchronizerTask::showError(parentWidget, i18n("Cannot open the folder %1.", path));
+        emit finished(result = false);
+        return;
+    }
+
+    for (int pos = 0; pos != dirEntries.count(); ++pos)
+        indexEntry(pos);
+    emit finished(result = true);
+}
+
 void SynchronizerDirList::slotEntries(KIO::Job * job, const KIO::UDSEntryList& entries)
 {
     KIO::UDSEntryList::const_iterator it = entries.begin();
     KIO::UDSEntryList::const_iterator end = entries.end();
 
-    int rwx = -1;
-    QString prot = ((KIO::ListJob *)job)->url().scheme();
-
-    if (prot == "krarc" || prot == "tar" || prot == "zip")
-        rwx = PERM_ALL;
-
     while (it != end) {
         KFileItem kfi(*it, ((KIO::ListJob *)job)->url(), true, true);
         QString key = kfi.text();
         if (key != "." && key != ".." && (!ignoreHidden || !key.startsWith(QLatin1String(".")))) {
-            mode_t mode = kfi.mode() | kfi.permissions();
-            QString perm = KRpermHandler::mode2QString(mode);
-            if (kfi.isDir())
-                perm[ 0 ] = 'd';
-
-            vfile *item = new vfile(kfi.text(), kfi.size(), perm, kfi.time(KFileItem::ModificationTime).toTime_t(),
-                                    kfi.isLink(), false, kfi.user(), kfi.group(), kfi.user(),
-                                    kfi.mimetype(), kfi.linkDest(), mode, rwx
+            SynchronizerDirEntry entry;
+            entry.name = key;
+            entry.mtime = kfi.time(KFileItem::ModificationTime).toTime_t();
+            entry.mtimeNsec = 0;
+            entry.inode = 0;
+            entry.mode = kfi.mode() | kfi.permissions();
+            // the remote users unknown here are not applied: -1 means no change for chown(2)
+            entry.uid = KRpermHandler::user2uid(kfi.user(), (uid_t) - 1);
+            entry.gid = KRpermHandler::group2gid(kfi.group(), (gid_t) - 1);
+            entry.isLink = kfi.isLink();
+            entry.isDir = kfi.isDir();
+            entry.isLocal = false;
+            entry.size = entry.isDir && !entry.isLink ? 0 : kfi.size();
+            if (entry.isLink)
+                entry.linkDest = kfi.linkDest();
 #ifdef HAVE_POSIX_ACL
-                                    , kfi.ACL().asString()
+            entry.acl = kfi.ACL().asString();
 #endif
-                                   );
-            insert(key, item);
+            dirEntries.append(entry);
+            indexEntry(dirEntries.count() - 1);
         }
         ++it;
     }
@@ -239,11 +340,11 @@ void SynchronizerDirList::slotEntries(KIO::Job * job, const KIO::UDSEntryList& e
 void SynchronizerDirList::slotListResult(KJob *job)
 {
     busy = false;
+    elapsed = listingTimer.elapsed();
     if (job && job->error()) {
-        job->uiDelegate()->showErrorMessage();
+        SynchronizerTask::showError(parentWidget, job->errorString());
         emit finished(result = false);
         return;
     }
     emit finished(result = true);
 }
-
@@ -32,14 +32,39 @@
 #define SYNCHRONIZERDIRLIST_H
 
 // QtCore
+#include <QAtomicInt>
 #include <QObject>
 #include <QHash>
+#include <QSharedPointer>
+#include <QTime>
+#include <QVector>
+
+#include <sys/types.h>
 
 #include <KIO/Job>
 
-#include "../VFS/vfile.h"
+/**
+ * The data of a listed file needed by the comparison. Unlike a vfile it is a plain value,
+ * so a listing doesn't cost a QObject, a permission string and an URL per file.
+ */
+struct SynchronizerDirEntry
+{
+    QString          name;
+    QString          linkDest;      //< the destination of a symbolic link, null for other files
+    QString          acl;           //< the ACL of a remote file, local ACLs are read at synchronizing
+    KIO::filesize_t  size;          //< 0 for folders
+    time_t           mtime;
+    qint64           mtimeNsec;     //< the modification time in nanoseconds, 0 for remote files
+    quint64          inode;         //< 0 for remote files
+    mode_t           mode;
+    uid_t            uid;
+    gid_t            gid;
+    bool             isDir;         //< folders and links pointing to folders
+    bool             isLink;
+    bool             isLocal;
+};
 
-class SynchronizerDirList : public QObject, public QHash<QString, vfile *>
+class SynchronizerDirList : public QObject
 {
     Q_OBJECT
 
@@ -47,13 +72,20 @@ public:
     SynchronizerDirList(QWidget *w, bool ignoreHidden);
     ~SynchronizerDirList();
 
-    vfile * search(const QString &name, bool ignoreCase = false);
-    vfile * first();
-    vfile * next();
+    const SynchronizerDirEntry * search(const QString &name, bool ignoreCase = false);
+    const SynchronizerDirEntry * first();
+    const SynchronizerDirEntry * next();
 
     inline const QString & url() {
         return currentUrl;
     }
+    inline int count() {
+        return dirEntries.count();
+    }
+    /// the milliseconds spent reading the folder by the last load(), without waiting for a worker
+    inline int listingTime() {
+        return elapsed;
+    }
     bool load(const QString &urlIn, bool wait = false);
 
 public slots:
@@ -61,16 +93,35 @@ public slots:
     void slotEntries(KIO::Job * job, const KIO::UDSEntryList& entries);
     void slotListResult(KJob *job);
 
+private slots:
+    void slotLocalListingDone();
+
 signals:
     void finished(bool err);
 
+public:
+    struct LocalListing;
+
+    /// reads a local folder relative to its descriptor, it is called by the worker threads too
+    static bool readLocalDir(const QString &path, bool ignoreHidden, QVector<SynchronizerDirEntry> &entries,
+                             const QAtomicInt *cancelled = 0);
+
 private:
-    QHashIterator<QString, vfile *> *fileIterator; //< Point to a dictionary of virtual files (vfile).
+    void indexEntry(int pos);
+    void localListingDone(bool ok, const QString &path, int readingTime);
+
+    QVector<SynchronizerDirEntry> dirEntries; //< The listed files in the order of the listing.
+    QHash<QString, int> nameIndex;            //< The positions of the files by name.
+    QHash<QString, int> lowerCaseIndex;       //< The same files by lower case name, for ignoreCase searches.
+    int      iterator;                        //< The position of the file returned by next().
     QWidget *parentWidget;
     bool     busy;
     bool     result;
     bool     ignoreHidden;
     QString  currentUrl;
+    QTime    listingTimer;
+    int      elapsed;
+    QSharedPointer<LocalListing> localListing; //< The folder being read by a worker thread.
 };
 
 #endif /* __SYNCHRONIZER_DIR_LIST_H__ */
@@ -32,8 +32,11 @@
 #define SYNCHRONIZERFILEITEM_H
 
 // QtCore
+#include <QList>
 #include <QString>
 
+#include <sys/types.h>
+
 #include <KIO/Global>
 
 typedef enum {
@@ -65,53 +68,79 @@ typedef enum {
 class SynchronizerFileItem
 {
 private:
+    // the rarely used properties are only allocated if one of them is set
+    struct Extra {
+        QString           leftLink;       // the left file's symbolic link destination
+        QString           rightLink;      // the right file's symbolic link destination
+        QString           leftACL;        // ACL of the left remote file, local ACLs are read at synchronizing
+        QString           rightACL;       // ACL of the right remote file
+        QString           destination;    // the destination URL at rename
+    };
+
     QString               m_leftName;     // the left file name
-    QString               m_rightName;    // the right file name
+    QString               m_rightName;    // the right file name, shares the data with the left one if equal
     QString               m_leftDirectory;// the left relative directory path from the base
     QString               m_rightDirectory;// the left relative directory path from the base
-    bool                  m_marked;       // flag, indicates to show the file
-    bool                  m_existsLeft;   // flag, the file exists in the left directory
-    bool                  m_existsRight;  // flag, the file exists in the right directory
     KIO::filesize_t       m_leftSize;     // the file size at the left directory
     KIO::filesize_t       m_rightSize;    // the file size at the right directory
     time_t                m_leftDate;     // the file date at the left directory
     time_t                m_rightDate;    // the file date at the left directory
-    QString               m_leftLink;     // the left file's symbolic link destination
-    QString               m_rightLink;    // the right file's symbolic link destination
-    QString               m_leftOwner;    // the left file's owner
-    QString               m_rightOwner;   // the right file's owner
-    QString               m_leftGroup;    // the left file's group
-    QString               m_rightGroup;   // the right file's group
+    SynchronizerFileItem *m_parent;       // pointer to the parent directory item or 0
+    Extra                *m_extra;        // links, ACLs and rename destination or 0
+    uid_t                 m_leftOwner;    // the left file's owner
+    uid_t                 m_rightOwner;   // the right file's owner
+    gid_t                 m_leftGroup;    // the left file's group
+    gid_t                 m_rightGroup;   // the right file's group
     mode_t                m_leftMode;     // mode for left
     mode_t                m_rightMode;    // mode for right
-    QString               m_leftACL;      // ACL of the left file
-    QString               m_rightACL;     // ACL of the right file
-    TaskType              m_task;         // the task with the file
-    bool                  m_isDir;        // flag, indicates that the file is a directory
-    SynchronizerFileItem *m_parent;       // pointer to the parent directory item or 0
-    void                 *m_userData;     // user data
-    bool                  m_overWrite;    // overwrite flag
-    QString               m_destination;  // the destination URL at rename
-    bool                  m_temporary;    // flag indicates temporary directory
-    TaskType              m_originalTask; // the original task type
+    int                   m_position;     // the position in the result list, defines the display order
+    quint8                m_task;         // the task with the file
+    quint8                m_originalTask; // the original task type
+    bool                  m_marked : 1;   // flag, indicates to show the file
+    bool                  m_existsLeft : 1;// flag, the file exists in the left directory
+    bool                  m_existsRight : 1;// flag, the file exists in the right directory
+    bool                  m_isDir : 1;    // flag, indicates that the file is a directory
+    bool                  m_overWrite : 1;// overwrite flag
+    bool                  m_temporary : 1;// flag indicates temporary directory
+
+    SynchronizerFileItem(const SynchronizerFileItem &);
+    SynchronizerFileItem &operator=(const SynchronizerFileItem &);
+
+    inline Extra *                extra()                 {
+        if (!m_extra)
+            m_extra = new Extra;
+        return m_extra;
+    }
+    static inline const QString & nullString()            {
+        static const QString null;
+        return null;
+    }
 
 public:
     SynchronizerFileItem(const QString &leftNam, const QString &rightNam, const QString &leftDir,
                          const QString &rightDir, bool mark, bool exL, bool exR, KIO::filesize_t leftSize,
                          KIO::filesize_t rightSize, time_t leftDate, time_t rightDate,
-                         const QString &leftLink, const QString &rightLink, const QString &leftOwner,
-                         const QString &rightOwner, const QString &leftGroup, const QString &rightGroup,
+                         const QString &leftLink, const QString &rightLink, uid_t leftOwner,
+                         uid_t rightOwner, gid_t leftGroup, gid_t rightGroup,
                          mode_t leftMode, mode_t rightMode, const QString &leftACL, const QString &rightACL,
                          TaskType tsk, bool isDir, bool tmp, SynchronizerFileItem *parent) :
-            m_leftName(leftNam), m_rightName(rightNam), m_leftDirectory(leftDir),  m_rightDirectory(rightDir),
-            m_marked(mark),  m_existsLeft(exL), m_existsRight(exR), m_leftSize(leftSize),
-            m_rightSize(rightSize), m_leftDate(leftDate), m_rightDate(rightDate),
-            m_leftLink(leftLink), m_rightLink(rightLink), m_leftOwner(leftOwner),
-            m_rightOwner(rightOwner), m_leftGroup(leftGroup), m_rightGroup(rightGroup),
-            m_leftMode(leftMode), m_rightMode(rightMode), m_leftACL(leftACL),
-            m_rightACL(rightACL), m_task(tsk), m_isDir(isDir), m_parent(parent),
-            m_userData(0), m_overWrite(false), m_destination(QString()),
-            m_temporary(tmp), m_originalTask(tsk) {}
+            m_leftName(leftNam), m_rightName(rightNam == leftNam ? leftNam : rightNam),
+            m_leftDirectory(leftDir),  m_rightDirectory(rightDir == leftDir ? leftDir : rightDir),
+            m_leftSize(leftSize), m_rightSize(rightSize), m_leftDate(leftDate), m_rightDate(rightDate),
+            m_parent(parent), m_extra(0), m_leftOwner(leftOwner), m_rightOwner(rightOwner),
+            m_leftGroup(leftGroup), m_rightGroup(rightGroup), m_leftMode(leftMode), m_rightMode(rightMode),
+            m_position(-1), m_task(tsk), m_originalTask(tsk), m_marked(mark), m_existsLeft(exL),
+            m_existsRight(exR), m_isDir(isDir), m_overWrite(false), m_temporary(tmp) {
+        if (!leftLink.isNull() || !rightLink.isNull() || !leftACL.isNull() || !rightACL.isNull()) {
+            extra()->leftLink = leftLink;
+            m_extra->rightLink = rightLink;
+            m_extra->leftACL = leftACL;
+            m_extra->rightACL = rightACL;
+        }
+    }
+    ~SynchronizerFileItem() {
+        delete m_extra;
+    }
 
     inline bool                   isMarked()              {
         return m_marked;
@@ -153,21 +182,21 @@ public:
         return m_rightDate;
     }
     inline const QString &        leftLink()              {
-        return m_leftLink;
+        return m_extra ? m_extra->leftLink : nullString();
     }
     inline const QString &        rightLink()             {
-        return m_rightLink;
+        return m_extra ? m_extra->rightLink : nullString();
     }
-    inline const QString &        leftOwner()             {
+    inline uid_t                  leftOwner()             {
         return m_leftOwner;
     }
-    inline const QString &        rightOwner()            {
+    inline uid_t                  rightOwner()            {
         return m_rightOwner;
     }
-    inline const QString &        leftGroup()             {
+    inline gid_t                  leftGroup()             {
         return m_leftGroup;
     }
-    inline const QString &        rightGroup()            {
+    inline gid_t                  rightGroup()            {
         return m_rightGroup;
     }
     inline mode_t                 leftMode()              {
@@ -177,19 +206,19 @@ public:
         return m_rightMode;
     }
     inline const QString &        leftACL()               {
-        return m_leftACL;
+        return m_extra ? m_extra->leftACL : nullString();
     }
     inline const QString &        rightACL()              {
-        return m_rightACL;
+        return m_extra ? m_extra->rightACL : nullString();
     }
     inline TaskType               task()                  {
-        return m_task;
+        return (TaskType)m_task;
     }
     inline void                   compareContentResult(bool res) {
         if (res == true)
             m_task = m_originalTask = TT_EQUALS;
         else if (m_originalTask >= TT_UNKNOWN)
-            m_task = m_originalTask = (TaskType)(m_originalTask - TT_UNKNOWN);
+            m_task = m_originalTask = m_originalTask - TT_UNKNOWN;
     }
     inline bool                   isDir()                 {
         return m_isDir;
@@ -197,20 +226,20 @@ public:
     inline SynchronizerFileItem * parent()                {
         return m_parent;
     }
-    inline void *                 userData()              {
-        return m_userData;
+    inline int                    position()              {
+        return m_position;
     }
-    inline void                   setUserData(void *ud)  {
-        m_userData = ud;
+    inline void                   setPosition(int pos)  {
+        m_position = pos;
     }
     inline void                   setOverWrite()          {
         m_overWrite = true;
     }
     inline const QString &        destination()           {
-        return m_destination;
+        return m_extra ? m_extra->destination : nullString();
     }
     inline void                   setDestination(QString d) {
-        m_destination = d;
+        extra()->destination = d;
     }
     inline bool                   isTemporary()           {
         return m_temporary;
@@ -219,7 +248,7 @@ public:
         m_temporary = false;
     }
     inline TaskType               originalTask()          {
-        return m_originalTask;
+        return (TaskType)m_originalTask;
     }
     inline void                   restoreOriginalTask()   {
         m_task = m_originalTask;
@@ -228,18 +257,58 @@ public:
         m_task = t;
     }
     inline void                   swap(bool asym = false) {
-        SWAP(m_existsLeft, m_existsRight, bool);
+        bool existsLeft = m_existsLeft;
+        m_existsLeft = m_existsRight;
+        m_existsRight = existsLeft;
         SWAP(m_leftName, m_rightName, QString);
         SWAP(m_leftDirectory, m_rightDirectory, QString);
         SWAP(m_leftSize, m_rightSize, KIO::filesize_t);
         SWAP(m_leftDate, m_rightDate, time_t);
-        SWAP(m_leftLink, m_rightLink, QString);
-        SWAP(m_leftOwner, m_rightOwner, QString);
-        SWAP(m_leftGroup, m_rightGroup, QString);
-        SWAP(m_leftACL, m_rightACL, QString);
+        SWAP(m_leftOwner, m_rightOwner, uid_t);
+        SWAP(m_leftGroup, m_rightGroup, gid_t);
+        if (m_extra) {
+            SWAP(m_extra->leftLink, m_extra->rightLink, QString);
+            SWAP(m_extra->leftACL, m_extra->rightACL, QString);
+        }
         REVERSE_TASK(m_originalTask, asym);
         REVERSE_TASK(m_task, asym);
     }
 };
 
+/**
+ * Allocates the file items of a comparison in large blocks instead of one by one.
+ * The memory is only released by clear(), after the items were destructed.
+ */
+class SynchronizerFileItemArena
+{
+public:
+    SynchronizerFileItemArena() : used(ITEMS_PER_BLOCK) {}
+    ~SynchronizerFileItemArena() {
+        clear();
+    }
+
+    inline void *                 allocate()              {
+        if (used == ITEMS_PER_BLOCK) {
+            blocks.append(::operator new(ITEMS_PER_BLOCK * sizeof(SynchronizerFileItem)));
+            used = 0;
+        }
+        return (char *)blocks.last() + sizeof(SynchronizerFileItem) * used++;
+    }
+    inline void                   clear()                 {
+        foreach(void *block, blocks)
+            ::operator delete(block);
+        blocks.clear();
+        used = ITEMS_PER_BLOCK;
+    }
+
+private:
+    SynchronizerFileItemArena(const SynchronizerFileItemArena &);
+    SynchronizerFileItemArena &operator=(const SynchronizerFileItemArena &);
+
+    enum { ITEMS_PER_BLOCK = 1024 };
+
+    QList<void *>         blocks;
+    int                   used;
+};
+
 #endif /* __SYNCHRONIZER_FILE_ITEM_H__ */
@@ -44,6 +44,7 @@
 #include "synchronizedialog.h"
 #include "feedtolistboxdialog.h"
 #include "synchronizercolors.h"
+#include "synchronizerresultmodel.h"
 
 // QtCore
 #include <QEventLoop>
@@ -67,8 +68,10 @@
 #include <QHBoxLayout>
 #include <QFrame>
 #include <QHeaderView>
+#include <QItemSelectionModel>
 #include <QMenu>
 #include <QSpinBox>
+#include <QTreeView>
 
 #include <KConfigCore/KSharedConfig>
 #include <KI18n/KLocalizedString>
@@ -1038,44 +1041,43 @@ static const char * const swap_sides_data[] = {
 
 
 
-class SynchronizerListView : public KrTreeWidget
+class SynchronizerListView : public QTreeView
 {
 private:
-    Synchronizer   *synchronizer;
-    bool            isLeft;
+    Synchronizer            *synchronizer;
+    SynchronizerResultModel *resultModel;
+    bool                     isLeft;
 
 public:
-    SynchronizerListView(Synchronizer * sync, QWidget * parent) : KrTreeWidget(parent), synchronizer(sync) {
+    SynchronizerListView(Synchronizer * sync, SynchronizerResultModel * model, QWidget * parent) :
+            QTreeView(parent), synchronizer(sync), resultModel(model) {
+        setModel(model);
     }
 
     void mouseMoveEvent(QMouseEvent * e) {
         isLeft = ((e->modifiers() & Qt::ShiftModifier) == 0);
-        KrTreeWidget::mouseMoveEvent(e);
+        QTreeView::mouseMoveEvent(e);
     }
 
     void startDrag(Qt::DropActions /* supportedActs */) {
         QList<QUrl> urls;
+        QSet<SynchronizerFileItem *> selected = resultModel->items(selectionModel()->selectedRows());
 
         unsigned              ndx = 0;
-        SynchronizerFileItem  *currentItem;
-
-        while ((currentItem = synchronizer->getItemAt(ndx++)) != 0) {
-            SynchronizerGUI::SyncViewItem *viewItem = (SynchronizerGUI::SyncViewItem *)currentItem->userData();
+        SynchronizerFileItem  *item;
 
-            if (!viewItem || !viewItem->isSelected() || viewItem->isHidden())
+        while ((item = synchronizer->getItemAt(ndx++)) != 0) {
+            if (!selected.contains(item))
                 continue;
 
-            SynchronizerFileItem *item = viewItem->synchronizerItemRef();
-            if (item) {
-                if (isLeft && item->existsInLeft()) {
-                    QString leftDirName = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
-                    QUrl leftURL = Synchronizer::fsUrl(synchronizer->leftBaseDirectory()  + leftDirName + item->leftName());
-                    urls.push_back(leftURL);
-                } else if (!isLeft && item->existsInRight()) {
-                    QString rightDirName = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
-                    QUrl rightURL = Synchronizer::fsUrl(synchronizer->rightBaseDirectory()  + rightDirName + item->rightName());
-                    urls.push_back(rightURL);
-                }
+            if (isLeft && item->existsInLeft()) {
+                QString leftDirName = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
+                QUrl leftURL = Synchronizer::fsUrl(synchronizer->leftBaseDirectory()  + leftDirName + item->leftName());
+                urls.push_back(leftURL);
+            } else if (!isLeft && item->existsInRight()) {
+                QString rightDirName = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
+                QUrl rightURL = Synchronizer::fsUrl(synchronizer->rightBaseDirectory()  + rightDirName + item->rightName());
+                urls.push_back(rightURL);
             }
         }
 
@@ -1125,8 +1127,8 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
     synchGrid->setSpacing(6);
     synchGrid->setContentsMargins(11, 11, 11, 11);
 
-    folderIcon =   QPixmap((const char**) folder_data);
-    fileIcon   =   QPixmap((const char**) file_data);
+    syncModel = new SynchronizerResultModel(&synchronizer, this);
+    syncModel->setIcons(QPixmap((const char**) file_data), QPixmap((const char**) folder_data));
 
     synchronizerTabs = new QTabWidget(this);
 
@@ -1336,7 +1338,7 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
     synchronizerGrid->addWidget(compareDirs, 0, 0);
 
     /* ========================= Synchronization list view ========================== */
-    syncList = new SynchronizerListView(&synchronizer, synchronizerTab);  // create the main container
+    syncList = new SynchronizerListView(&synchronizer, syncModel, synchronizerTab);  // create the main container
     syncList->setWhatsThis(i18n("The compare results of the synchronizer (Ctrl+M)."));
     syncList->setAutoFillBackground(true);
     syncList->installEventFilter(this);
@@ -1355,7 +1357,7 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
     labels << i18nc("@title:column", "Date");
     labels << i18nc("@title:column", "Size");
     labels << i18nc("@title:column file name", "Name");
-    syncList->setHeaderLabels(labels);
+    syncModel->setHeaderLabels(labels);
 
     syncList->header()->setSectionResizeMode(QHeaderView::Interactive);
 
@@ -1385,7 +1387,9 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
     syncList->header()->setSortIndicatorShown(false);
     syncList->setSortingEnabled(false);
     syncList->setRootIsDecorated(true);
+    syncList->setUniformRowHeights(true);  // the rows are laid out without asking every item
     syncList->setIndentation(10);
+    syncList->setContextMenuPolicy(Qt::CustomContextMenu);
     syncList->setDragEnabled(true);
     syncList->setAutoFillBackground(true);
 
@@ -1455,6 +1459,17 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
     ignoreHiddenFilesCB = new QCheckBox(i18n("Ignore hidden files"), optionsGroup);
     optionsLayout->addWidget(ignoreHiddenFilesCB, 4, 0, 1, 3);
 
+    cachedChecksumsCB = new QCheckBox(i18n("Remember the checksums of the compared files"), optionsGroup);
+    cachedChecksumsCB->setWhatsThis(i18n("When comparing by content, the checksums of the equal local files are stored. "
+                                         "Unchanged files are not read again at the next comparison."));
+    optionsLayout->addWidget(cachedChecksumsCB, 5, 0, 1, 3);
+
+    incrementalCB = new QCheckBox(i18n("Skip the folders unchanged since the last synchronization"), optionsGroup);
+    incrementalCB->setWhatsThis(i18n("The equal local folders are remembered after synchronizing. "
+                                     "The folders without added, removed or renamed entries since then are not compared again, "
+                                     "only the changes are shown. Files modified in place are not noticed in these folders."));
+    optionsLayout->addWidget(incrementalCB, 6, 0, 1, 3);
+
     generalFilter->middleLayout->addWidget(optionsGroup);
 
 
@@ -1526,10 +1541,12 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
 
     /* =============================== Connect table ================================ */
 
-    connect(syncList, SIGNAL(itemRightClicked(QTreeWidgetItem *, const QPoint &, int)),
-            this, SLOT(rightMouseClicked(QTreeWidgetItem *, const QPoint &)));
-    connect(syncList, SIGNAL(itemActivated(QTreeWidgetItem *, int)),
-            this, SLOT(doubleClicked(QTreeWidgetItem *)));
+    connect(syncList, SIGNAL(customContextMenuRequested(const QPoint &)),
+            this, SLOT(rightMouseClicked(const QPoint &)));
+    connect(syncList, SIGNAL(activated(const QModelIndex &)),
+            this, SLOT(doubleClicked(const QModelIndex &)));
+    connect(syncList, SIGNAL(expanded(const QModelIndex &)), this, SLOT(dirExpanded(const QModelIndex &)));
+    connect(syncList, SIGNAL(collapsed(const QModelIndex &)), this, SLOT(dirCollapsed(const QModelIndex &)));
 
     connect(profileManager, SIGNAL(loadFromProfile(QString)), this, SLOT(loadFromProfile(QString)));
     connect(profileManager, SIGNAL(saveToProfile(QString)), this, SLOT(saveToProfile(QString)));
@@ -1549,6 +1566,7 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
             SLOT(addFile(SynchronizerFileItem *)));
     connect(&synchronizer,     SIGNAL(markChanged(SynchronizerFileItem *, bool)), this,
             SLOT(markChanged(SynchronizerFileItem *, bool)));
+    connect(&synchronizer,     SIGNAL(markingRefreshed()), this, SLOT(markingRefreshed()));
     connect(&synchronizer,     SIGNAL(statusInfo(QString)), this, SLOT(statusInfo(QString)));
 
     connect(btnLeftToRight,    SIGNAL(toggled(bool)), this, SLOT(refresh()));
@@ -1603,6 +1621,7 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
         else
             backGrounds[ clr ] = gc.readEntry(bckgEntry, backgroundDefault);
     }
+    syncModel->setColors(foreGrounds, backGrounds);
     if (backGrounds[ TT_EQUALS ].isValid()) {
         QPalette pal = syncList->palette();
         pal.setColor(QPalette::Base, backGrounds[ TT_EQUALS ]);
@@ -1639,7 +1658,7 @@ void SynchronizerGUI::initGUI(QWidget* /* parent */, QString profileName, QUrl l
 
 SynchronizerGUI::~SynchronizerGUI()
 {
-    syncList->clear(); // for sanity: deletes the references to the synchronizer list
+    syncModel->clear(); // for sanity: deletes the references to the synchronizer list
 }
 
 void SynchronizerGUI::setPanelLabels()
@@ -1691,13 +1710,9 @@ void SynchronizerGUI::checkExcludeURLValidity(QString &text, QString &error)
     error = i18n("URL must be the descendant of either the left or the right base URL.");
 }
 
-void SynchronizerGUI::doubleClicked(QTreeWidgetItem *itemIn)
+void SynchronizerGUI::doubleClicked(const QModelIndex &index)
 {
-    if (!itemIn)
-        return;
-
-    SyncViewItem *syncItem = (SyncViewItem *)itemIn;
-    SynchronizerFileItem *item = syncItem->synchronizerItemRef();
+    SynchronizerFileItem *item = syncModel->item(index);
     if (item && item->existsInLeft() && item->existsInRight() && !item->isDir()) {
         QString leftDirName     = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
         QString rightDirName     = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
@@ -1706,11 +1721,12 @@ void SynchronizerGUI::doubleClicked(QTreeWidgetItem *itemIn)
 
         SLOTS->compareContent(leftURL, rightURL);
     } else if (item && item->isDir()) {
-        itemIn->setExpanded(!itemIn->isExpanded());
+        QModelIndex dirIndex = index.sibling(index.row(), 0);
+        syncList->setExpanded(dirIndex, !syncList->isExpanded(dirIndex));
     }
 }
 
-void SynchronizerGUI::rightMouseClicked(QTreeWidgetItem *itemIn, const QPoint &pos)
+void SynchronizerGUI::rightMouseClicked(const QPoint &viewportPos)
 {
     // these are the values that will exist in the menu
 #define EXCLUDE_ID          90
@@ -1729,15 +1745,17 @@ void SynchronizerGUI::rightMouseClicked(QTreeWidgetItem *itemIn, const QPoint &p
 #define COPY_CLPBD_LEFT_ID  103
 #define COPY_CLPBD_RIGHT_ID 104
     //////////////////////////////////////////////////////////
-    if (!itemIn)
-        return;
+    QModelIndex index = syncList->indexAt(viewportPos);
+    QPoint pos = syncList->viewport()->mapToGlobal(viewportPos);
+    if (!index.isValid()) {   // invoked by the keyboard
+        index = syncList->currentIndex();
+        pos = syncList->viewport()->mapToGlobal(syncList->visualRect(index).topLeft() + QPoint(5, 5));
+    }
 
-    SyncViewItem *syncItem = (SyncViewItem *)itemIn;
-    if (syncItem == 0)
+    SynchronizerFileItem *item = syncModel->item(index);
+    if (item == 0)
         return;
 
-    SynchronizerFileItem *item = syncItem->synchronizerItemRef();
-
     bool    isDuplicate = item->existsInLeft() && item->existsInRight();
     bool    isDir       = item->isDir();
 
@@ -1826,33 +1844,32 @@ void SynchronizerGUI::executeOperation(SynchronizerFileItem *item, int op)
     case COPY_TO_RIGHT_ID:
     case REVERSE_DIR_ID:
     case DELETE_ID: {
+        QSet<SynchronizerFileItem *> selected = selectedItems();
         unsigned              ndx = 0;
         SynchronizerFileItem  *currentItem;
 
         while ((currentItem = synchronizer.getItemAt(ndx++)) != 0) {
-            SyncViewItem *viewItem = (SyncViewItem *)currentItem->userData();
-
-            if (!viewItem || !viewItem->isSelected() || viewItem->isHidden())
+            if (!selected.contains(currentItem))
                 continue;
 
             switch (op) {
             case EXCLUDE_ID:
-                synchronizer.exclude(viewItem->synchronizerItemRef());
+                synchronizer.exclude(currentItem);
                 break;
             case RESTORE_ID:
-                synchronizer.restore(viewItem->synchronizerItemRef());
+                synchronizer.restore(currentItem);
                 break;
             case REVERSE_DIR_ID:
-                synchronizer.reverseDirection(viewItem->synchronizerItemRef());
+                synchronizer.reverseDirection(currentItem);
                 break;
             case COPY_TO_LEFT_ID:
-                synchronizer.copyToLeft(viewItem->synchronizerItemRef());
+                synchronizer.copyToLeft(currentItem);
                 break;
             case COPY_TO_RIGHT_ID:
-                synchronizer.copyToRight(viewItem->synchronizerItemRef());
+                synchronizer.copyToRight(currentItem);
                 break;
             case DELETE_ID:
-                synchronizer.deleteLeft(viewItem->synchronizerItemRef());
+                synchronizer.deleteLeft(currentItem);
                 break;
             }
         }
@@ -1876,35 +1893,30 @@ void SynchronizerGUI::executeOperation(SynchronizerFileItem *item, int op)
         if (query.isNull())
             break;
 
+        QItemSelection selection;
         unsigned              ndx = 0;
         SynchronizerFileItem  *currentItem;
 
         while ((currentItem = synchronizer.getItemAt(ndx++)) != 0) {
-            SyncViewItem *viewItem = (SyncViewItem *)currentItem->userData();
-
-            if (!viewItem || viewItem->isHidden())
+            if (!currentItem->isMarked())
                 continue;
 
             if (query.match(currentItem->leftName()) ||
-                    query.match(currentItem->rightName()))
-                viewItem->setSelected(op == SELECT_ITEMS_ID);
+                    query.match(currentItem->rightName())) {
+                QModelIndex index = syncModel->indexOf(currentItem);
+                if (index.isValid())
+                    selection.select(index, index);
+            }
         }
-    }
-    break;
-    case INVERT_SELECTION_ID: {
-        unsigned              ndx = 0;
-        SynchronizerFileItem  *currentItem;
-
-        while ((currentItem = synchronizer.getItemAt(ndx++)) != 0) {
-            SyncViewItem *viewItem = (SyncViewItem *)currentItem->userData();
-
-            if (!viewItem || viewItem->isHidden())
-                continue;
 
-            viewItem->setSelected(!viewItem->isSelected());
-        }
+        syncList->selectionModel()->select(selection, (op == SELECT_ITEMS_ID ? QItemSelectionModel::Select :
+                                           QItemSelectionModel::Deselect) | QItemSelectionModel::Rows);
     }
     break;
+    case INVERT_SELECTION_ID:
+        syncList->selectionModel()->select(syncModel->allRows(),
+                                           QItemSelectionModel::Toggle | QItemSelectionModel::Rows);
+        break;
     case SYNCH_WITH_KGET_ID:
         synchronizer.synchronizeWithKGet();
         closeDialog();
@@ -2016,8 +2028,8 @@ void SynchronizerGUI::compare()
     query.setNameFilter(fileFilter->currentText(), query.isCaseSensitive());
     synchronizerTabs->setCurrentIndex(0);
 
-    syncList->clear();
-    lastItem = 0;
+    syncModel->clear();
+    collapsedDirs.clear();
 
     leftLocation->addToHistory(leftLocation->currentText());
     rightLocation->addToHistory(rightLocation->currentText());
@@ -2043,7 +2055,8 @@ void SynchronizerGUI::compare()
                                          cbIgnoreCase->isChecked(), btnScrollResults->isChecked(), selectedFiles,
                                          convertToSeconds(equalitySpinBox->value(), equalityUnitCombo->currentIndex()),
                                          convertToSeconds(timeShiftSpinBox->value(), timeShiftUnitCombo->currentIndex()),
-                                         parallelThreadsSpinBox->value(), ignoreHiddenFilesCB->isChecked());
+                                         parallelThreadsSpinBox->value(), ignoreHiddenFilesCB->isChecked(),
+                                         cachedChecksumsCB->isChecked(), incrementalCB->isChecked());
     enableMarkButtons();
     btnStopComparing->setEnabled(isComparing = false);
     btnStopComparing->hide();
@@ -2071,7 +2084,7 @@ void SynchronizerGUI::stop()
 
 void SynchronizerGUI::feedToListBox()
 {
-    FeedToListBoxDialog listBox(this, &synchronizer, syncList, btnEquals->isChecked());
+    FeedToListBoxDialog listBox(this, &synchronizer, selectedItems(), btnEquals->isChecked());
     if (listBox.isAccepted())
         closeDialog();
 }
@@ -2083,89 +2096,46 @@ void SynchronizerGUI::reject()
 
 void SynchronizerGUI::addFile(SynchronizerFileItem *item)
 {
-    QString leftName = "", rightName = "", leftDate = "", rightDate = "", leftSize = "", rightSize = "";
-    bool    isDir = item->isDir();
-
-    QColor textColor = foreGrounds[ item->task()];
-    QColor baseColor = backGrounds[ item->task()];
+    markChanged(item, item->isMarked());
+}
 
-    if (item->existsInLeft()) {
-        leftName = item->leftName();
-        leftSize = isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(item->leftSize());
-        leftDate = SynchronizerGUI::convertTime(item->leftDate());
-    }
+void SynchronizerGUI::markChanged(SynchronizerFileItem *item, bool ensureVisible)
+{
+    syncModel->itemChanged(item);
+    if (!item->isMarked())
+        return;
 
-    if (item->existsInRight()) {
-        rightName = item->rightName();
-        rightSize = isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(item->rightSize());
-        rightDate = SynchronizerGUI::convertTime(item->rightDate());
+    if (item->parent()) {
+        QModelIndex dirIndex = syncModel->indexOf(item->parent());
+        if (dirIndex.isValid() && !collapsedDirs.contains(item->parent()))
+            syncList->expand(dirIndex);
     }
 
-    SyncViewItem *listItem = 0;
-    SyncViewItem *dirItem;
-
-    if (item->parent() == 0) {
-        listItem = new SyncViewItem(item, textColor, baseColor, syncList, lastItem, leftName, leftSize,
-                                    leftDate, Synchronizer::getTaskTypeName(item->task()), rightDate,
-                                    rightSize, rightName);
-        lastItem = listItem;
-    } else {
-        dirItem = (SyncViewItem *)item->parent()->userData();
-        if (dirItem) {
-            dirItem->setExpanded(true);
-            listItem = new SyncViewItem(item, textColor, baseColor, dirItem, dirItem->lastItem(), leftName,
-                                        leftSize, leftDate, Synchronizer::getTaskTypeName(item->task()),
-                                        rightDate, rightSize, rightName);
-
-            dirItem->setLastItem(listItem);
-        }
-    }
+    if (ensureVisible)
+        syncList->scrollTo(syncModel->indexOf(item));
+}
 
-    if (listItem) {
-        listItem->setIcon(0, isDir ? folderIcon : fileIcon);
-        if (!item->isMarked())
-            listItem->setHidden(true);
-        else
-            syncList->scrollTo(syncList->indexOf(listItem));
+void SynchronizerGUI::markingRefreshed()
+{
+    // changing the rows one by one would be much slower than creating them again
+    syncModel->reload();
+
+    syncList->expandAll();
+    foreach(SynchronizerFileItem *dir, collapsedDirs) {
+        QModelIndex dirIndex = syncModel->indexOf(dir);
+        if (dirIndex.isValid())
+            syncList->collapse(dirIndex);
     }
 }
 
-void SynchronizerGUI::markChanged(SynchronizerFileItem *item, bool ensureVisible)
+void SynchronizerGUI::dirExpanded(const QModelIndex &index)
 {
-    SyncViewItem *listItem = (SyncViewItem *)item->userData();
-    if (listItem) {
-        if (!item->isMarked()) {
-            listItem->setHidden(true);
-        } else {
-            QString leftName = "", rightName = "", leftDate = "", rightDate = "", leftSize = "", rightSize = "";
-            bool    isDir = item->isDir();
-
-            if (item->existsInLeft()) {
-                leftName = item->leftName();
-                leftSize = isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(item->leftSize());
-                leftDate = SynchronizerGUI::convertTime(item->leftDate());
-            }
-
-            if (item->existsInRight()) {
-                rightName = item->rightName();
-                rightSize = isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(item->rightSize());
-                rightDate = SynchronizerGUI::convertTime(item->rightDate());
-            }
+    collapsedDirs.remove(syncModel->item(index));
+}
 
-            listItem->setHidden(false);
-            listItem->setText(0, leftName);
-            listItem->setText(1, leftSize);
-            listItem->setText(2, leftDate);
-            listItem->setText(3, Synchronizer::getTaskTypeName(item->task()));
-            listItem->setText(4, rightDate);
-            listItem->setText(5, rightSize);
-            listItem->setText(6, rightName);
-            listItem->setColors(foreGrounds[ item->task()], backGrounds[ item->task()]);
-
-            if (ensureVisible)
-                syncList->scrollTo(syncList->indexOf(listItem));
-        }
-    }
+void SynchronizerGUI::dirCollapsed(const QModelIndex &index)
+{
+    collapsedDirs.insert(syncModel->item(index));
 }
 
 void SynchronizerGUI::subdirsChecked(bool isOn)
@@ -2195,15 +2165,6 @@ void SynchronizerGUI::enableMarkButtons()
     btnSingles->setEnabled(true);
 }
 
-QString SynchronizerGUI::convertTime(time_t time) const
-{
-    // convert the time_t to struct tm
-    struct tm* t = localtime((time_t *) & time);
-
-    QDateTime tmp(QDate(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday), QTime(t->tm_hour, t->tm_min));
-    return QLocale().toString(tmp, QLocale::ShortFormat);
-}
-
 void SynchronizerGUI::setMarkFlags()
 {
     synchronizer.setMarkFlags(btnRightToLeft->isChecked(), btnEquals->isChecked(), btnDifferents->isChecked(),
@@ -2306,13 +2267,12 @@ void SynchronizerGUI::keyPressEvent(QKeyEvent *e)
     case Qt::Key_F4 : {
         e->accept();
         syncList->setFocus();
-        QTreeWidgetItem *listItem =  syncList->currentItem();
-        if (listItem == 0)
+        SynchronizerFileItem *item = syncModel->item(syncList->currentIndex());
+        if (item == 0)
             break;
 
         bool isedit = e->key() == Qt::Key_F4;
 
-        SynchronizerFileItem *item = ((SyncViewItem *)listItem)->synchronizerItemRef();
         QString leftDirName = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
         QString rightDirName = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
 
@@ -2348,7 +2308,7 @@ void SynchronizerGUI::keyPressEvent(QKeyEvent *e)
             btnStopComparing->animateClick(); // just click the stop button
         } else {
             e->accept();
-            if (syncList->topLevelItemCount() != 0) {
+            if (synchronizer.getItemAt(0) != 0) {
                 int result = KMessageBox::warningYesNo(this, i18n("The synchronizer window contains data from a previous compare. If you exit, this data will be lost. Do you really want to exit?"),
                                                        i18n("Krusader::Synchronize Folders"),
                                                        KStandardGuiItem::yes(), KStandardGuiItem::no(), "syncGUIexit");
@@ -2404,19 +2364,13 @@ bool SynchronizerGUI::eventFilter(QObject * /* watched */, QEvent * e)
 
             ke->accept();
 
-            QTreeWidgetItem *listItem =  syncList->currentItem();
-            if (listItem == 0)
+            QModelIndex current = syncList->currentIndex();
+            SynchronizerFileItem *item = syncModel->item(current);
+            if (item == 0)
                 return true;
 
-            SynchronizerFileItem *item = ((SyncViewItem *)listItem)->synchronizerItemRef();
-
-            bool hasSelected = false;
-            QList<QTreeWidgetItem *> selected = syncList->selectedItems();
-            for (int i = 0; i != selected.count(); i++)
-                if (selected[ i ]->isSelected() && !selected[ i ]->isHidden())
-                    hasSelected = true;
-            if (!hasSelected)
-                listItem->setSelected(true);
+            if (!syncList->selectionModel()->hasSelection())
+                syncList->selectionModel()->select(current, QItemSelectionModel::Select | QItemSelectionModel::Rows);
 
             executeOperation(item, op);
             return true;
@@ -2428,7 +2382,7 @@ bool SynchronizerGUI::eventFilter(QObject * /* watched */, QEvent * e)
 
 void SynchronizerGUI::loadFromProfile(QString profile)
 {
-    syncList->clear();
+    syncModel->clear();
     synchronizer.reset();
     isComparing = wasClosed = false;
     btnSynchronize->setEnabled(false);
@@ -2477,6 +2431,9 @@ void SynchronizerGUI::loadFromProfile(QString profile)
     bool ignoreHidden = pg.readEntry("Ignore Hidden Files", false);
     ignoreHiddenFilesCB->setChecked(ignoreHidden);
 
+    cachedChecksumsCB->setChecked(pg.readEntry("Cached Checksums", false));
+    incrementalCB->setChecked(pg.readEntry("Incremental", false));
+
     refresh();
 }
 
@@ -2510,6 +2467,8 @@ void SynchronizerGUI::saveToProfile(QString profile)
     group.writeEntry("Parallel Threads", parallelThreadsSpinBox->value());
 
     group.writeEntry("Ignore Hidden Files", ignoreHiddenFilesCB->isChecked());
+    group.writeEntry("Cached Checksums", cachedChecksumsCB->isChecked());
+    group.writeEntry("Incremental", incrementalCB->isChecked());
 }
 
 void SynchronizerGUI::connectFilters(const QString &newString)
@@ -2565,27 +2524,23 @@ void SynchronizerGUI::convertFromSeconds(int &time, int &unit, int second)
 void SynchronizerGUI::copyToClipboard(bool isLeft)
 {
     QList<QUrl> urls;
+    QSet<SynchronizerFileItem *> selected = selectedItems();
 
     unsigned              ndx = 0;
-    SynchronizerFileItem  *currentItem;
+    SynchronizerFileItem  *item;
 
-    while ((currentItem = synchronizer.getItemAt(ndx++)) != 0) {
-        SynchronizerGUI::SyncViewItem *viewItem = (SynchronizerGUI::SyncViewItem *)currentItem->userData();
-
-        if (!viewItem || !viewItem->isSelected() || viewItem->isHidden())
+    while ((item = synchronizer.getItemAt(ndx++)) != 0) {
+        if (!selected.contains(item))
             continue;
 
-        SynchronizerFileItem *item = viewItem->synchronizerItemRef();
-        if (item) {
-            if (isLeft && item->existsInLeft()) {
-                QString leftDirName = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
-                QUrl leftURL = Synchronizer::fsUrl(synchronizer.leftBaseDirectory()  + leftDirName + item->leftName());
-                urls.push_back(leftURL);
-            } else if (!isLeft && item->existsInRight()) {
-                QString rightDirName = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
-                QUrl rightURL = Synchronizer::fsUrl(synchronizer.rightBaseDirectory()  + rightDirName + item->rightName());
-                urls.push_back(rightURL);
-            }
+        if (isLeft && item->existsInLeft()) {
+            QString leftDirName = item->leftDirectory().isEmpty() ? "" : item->leftDirectory() + '/';
+            QUrl leftURL = Synchronizer::fsUrl(synchronizer.leftBaseDirectory()  + leftDirName + item->leftName());
+            urls.push_back(leftURL);
+        } else if (!isLeft && item->existsInRight()) {
+            QString rightDirName = item->rightDirectory().isEmpty() ? "" : item->rightDirectory() + '/';
+            QUrl rightURL = Synchronizer::fsUrl(synchronizer.rightBaseDirectory()  + rightDirName + item->rightName());
+            urls.push_back(rightURL);
         }
     }
 
@@ -2599,11 +2554,7 @@ void SynchronizerGUI::copyToClipboard(bool isLeft)
     QApplication::clipboard()->setMimeData(mimeData, QClipboard::Clipboard);
 }
 
-QString SynchronizerGUI::dirLabel()
+QSet<SynchronizerFileItem *> SynchronizerGUI::selectedItems()
 {
-    //HACK add <> brackets AFTER translating - otherwise KUIT thinks it's a tag
-    static QString label = QString("<") +
-        i18nc("Show the string 'DIR' instead of file size in detailed view (for folders)", "DIR") + ">";
-    return label;
+    return syncModel->items(syncList->selectionModel()->selectedRows());
 }
-
@@ -33,6 +33,7 @@
 
 // QtCore
 #include <QMap>
+#include <QSet>
 // QtGui
 #include <QResizeEvent>
 #include <QKeyEvent>
@@ -47,95 +48,18 @@
 
 #include "synchronizer.h"
 #include "../GUI/profilemanager.h"
-#include "../GUI/krtreewidget.h"
 #include "../Filter/filtertabs.h"
 #include "../Filter/generalfilter.h"
 
+class QModelIndex;
 class QSpinBox;
+class QTreeView;
+class SynchronizerResultModel;
 
 class SynchronizerGUI : QDialog
 {
     Q_OBJECT
 
-public:
-    class SyncViewItem : public QTreeWidgetItem
-    {
-    private:
-        SynchronizerFileItem *syncItemRef;
-        SyncViewItem         *lastItemRef;
-
-    public:
-        SyncViewItem(SynchronizerFileItem *item, QColor txt, QColor base, QTreeWidget * parent, QTreeWidgetItem *after, QString label1,
-                     QString label2 = QString(), QString label3 = QString(), QString label4 = QString(),
-                     QString label5 = QString(), QString label6 = QString(),
-                     QString label7 = QString(), QString label8 = QString()) :
-                QTreeWidgetItem(parent, after), syncItemRef(item), lastItemRef(0) {
-            setText(0, label1);
-            setText(1, label2);
-            setText(2, label3);
-            setText(3, label4);
-            setText(4, label5);
-            setText(5, label6);
-            setText(6, label7);
-            setText(7, label8);
-
-            setTextAlignment(1, Qt::AlignRight);
-            setTextAlignment(3, Qt::AlignHCenter);
-            setTextAlignment(5, Qt::AlignRight);
-            item->setUserData((void *)this);
-
-            setColors(txt, base);
-        }
-
-        SyncViewItem(SynchronizerFileItem *item, QColor txt, QColor base, QTreeWidgetItem * parent, QTreeWidgetItem *after, QString label1,
-                     QString label2 = QString(), QString label3 = QString(), QString label4 = QString(),
-                     QString label5 = QString(), QString label6 = QString(),
-                     QString label7 = QString(), QString label8 = QString()) :
-                QTreeWidgetItem(parent, after), syncItemRef(item), lastItemRef(0) {
-            setText(0, label1);
-            setText(1, label2);
-            setText(2, label3);
-            setText(3, label4);
-            setText(4, label5);
-            setText(5, label6);
-            setText(6, label7);
-            setText(7, label8);
-
-            setTextAlignment(1, Qt::AlignRight);
-            setTextAlignment(3, Qt::AlignHCenter);
-            setTextAlignment(5, Qt::AlignRight);
-            item->setUserData((void *)this);
-
-            setColors(txt, base);
-        }
-
-        ~SyncViewItem() {
-            syncItemRef->setUserData(0);
-        }
-
-        inline SynchronizerFileItem * synchronizerItemRef()       {
-            return syncItemRef;
-        }
-        inline SyncViewItem         * lastItem()                  {
-            return lastItemRef;
-        }
-        inline void                   setLastItem(SyncViewItem*s) {
-            lastItemRef = s;
-        }
-
-        void setColors(QColor fore, QColor back) {
-            QBrush textColor(fore);
-            QBrush baseColor(back);
-
-            for (int i = 0; i != columnCount(); i++) {
-                if (back.isValid())
-                    setBackground(i, baseColor);
-                if (fore.isValid())
-                    setForeground(i, textColor);
-            }
-        }
-    };
-
 public:
     // if rightDirectory is null, leftDirectory is actually the profile name to load
     SynchronizerGUI(QWidget* parent,  QUrl leftDirectory, QUrl rightDirectory = QUrl(), QStringList selList = QStringList());
@@ -147,8 +71,8 @@ public:
     }
 
 public slots:
-    void rightMouseClicked(QTreeWidgetItem *, const QPoint &);
-    void doubleClicked(QTreeWidgetItem *);
+    void rightMouseClicked(const QPoint &);
+    void doubleClicked(const QModelIndex &);
     void compare();
     void synchronize();
     void stop();
@@ -163,6 +87,9 @@ protected slots:
     void reject();
     void addFile(SynchronizerFileItem *);
     void markChanged(SynchronizerFileItem *, bool);
+    void markingRefreshed();
+    void dirExpanded(const QModelIndex &);
+    void dirCollapsed(const QModelIndex &);
     void setScrolling(bool);
     void statusInfo(QString);
     void subdirsChecked(bool);
@@ -174,11 +101,11 @@ protected slots:
 private:
     void initGUI(QWidget* parent, QString profile, QUrl leftURL, QUrl rightURL, QStringList selList);
 
-    QString convertTime(time_t time) const;
     void    setMarkFlags();
     void    disableMarkButtons();
     void    enableMarkButtons();
     void    copyToClipboard(bool isLeft);
+    QSet<SynchronizerFileItem *> selectedItems();
 
     int     convertToSeconds(int time, int unit);
     void    convertFromSeconds(int &time, int &unit, int second);
@@ -200,7 +127,8 @@ protected:
     KHistoryComboBox *rightLocation;
     KHistoryComboBox *fileFilter;
 
-    KrTreeWidget  *syncList;
+    QTreeView     *syncList;
+    SynchronizerResultModel *syncModel;
     Synchronizer   synchronizer;
 
     QCheckBox     *cbSubdirs;
@@ -237,18 +165,16 @@ protected:
     QSpinBox      *timeShiftSpinBox;
     QComboBox     *timeShiftUnitCombo;
     QCheckBox     *ignoreHiddenFilesCB;
+    QCheckBox     *cachedChecksumsCB;
+    QCheckBox     *incrementalCB;
 
 private:
-    static QString dirLabel(); // returns translated '<DIR>'
-
-    QPixmap        fileIcon;
-    QPixmap        folderIcon;
     bool           isComparing;
     bool           wasClosed;
     bool           wasSync;
     bool           firstResize;
     bool           hasSelectedFiles;
-    SyncViewItem  *lastItem;
+    QSet<SynchronizerFileItem *> collapsedDirs; // restored when the rows are created again
 
     int            sizeX;
     int            sizeY;
@@ -0,0 +1,297 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "synchronizerresultmodel.h"
+#include "synchronizer.h"
+#include "../VFS/krpermhandler.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+// QtCore
+#include <QDateTime>
+#include <QLocale>
+// QtGui
+#include <QBrush>
+
+#include <KI18n/KLocalizedString>
+
+static bool positionLessThan(SynchronizerFileItem *item1, SynchronizerFileItem *item2)
+{
+    return item1->position() < item2->position();
+}
+
+SynchronizerResultModel::SynchronizerResultModel(Synchronizer *sync, QObject *parent) :
+        QAbstractItemModel(parent), synchronizer(sync)
+{
+}
+
+void SynchronizerResultModel::setHeaderLabels(const QStringList &labels)
+{
+    headerLabels = labels;
+    emit headerDataChanged(Qt::Horizontal, 0, COLUMN_COUNT - 1);
+}
+
+void SynchronizerResultModel::setColors(const QColor *foreground, const QColor *background)
+{
+    for (int i = 0; i != TT_MAX; i++) {
+        foreGrounds[ i ] = foreground[ i ];
+        backGrounds[ i ] = background[ i ];
+    }
+}
+
+void SynchronizerResultModel::setIcons(const QPixmap &file, const QPixmap &folder)
+{
+    fileIcon = file;
+    folderIcon = folder;
+}
+
+SynchronizerFileItem * SynchronizerResultModel::item(const QModelIndex &index) const
+{
+    return index.isValid() ? static_cast<SynchronizerFileItem *>(index.internalPointer()) : 0;
+}
+
+QSet<SynchronizerFileItem *> SynchronizerResultModel::items(const QModelIndexList &indexes) const
+{
+    QSet<SynchronizerFileItem *> result;
+    foreach(const QModelIndex &index, indexes)
+        result.insert(item(index));
+    result.remove(0);
+    return result;
+}
+
+QModelIndex SynchronizerResultModel::indexOf(SynchronizerFileItem *item) const
+{
+    int r = row(item);
+    return r < 0 ? QModelIndex() : createIndex(r, 0, item);
+}
+
+QItemSelection SynchronizerResultModel::allRows() const
+{
+    QItemSelection selection;
+
+    QHashIterator<SynchronizerFileItem *, Rows> it(children);
+    while (it.hasNext()) {
+        const Rows &rows = it.next().value();
+        if (!rows.isEmpty())
+            selection.append(QItemSelectionRange(createIndex(0, 0, rows.first()),
+                                                 createIndex(rows.count() - 1, COLUMN_COUNT - 1, rows.last())));
+    }
+    return selection;
+}
+
+void SynchronizerResultModel::clear()
+{
+    beginResetModel();
+    children.clear();
+    endResetModel();
+}
+
+void SynchronizerResultModel::reload()
+{
+    beginResetModel();
+    children.clear();
+
+    // the parents are always before their children in the result list
+    unsigned              ndx = 0;
+    SynchronizerFileItem  *item;
+
+    while ((item = synchronizer->getItemAt(ndx++)) != 0) {
+        if (item->isMarked() && (item->parent() == 0 || item->parent()->isMarked()))
+            children[ item->parent()].append(item);
+    }
+    endResetModel();
+}
+
+void SynchronizerResultModel::itemChanged(SynchronizerFileItem *item)
+{
+    SynchronizerFileItem *dir = item->parent();
+    int r = row(item);
+
+    if (item->isMarked()) {
+        if (r >= 0) {
+            emit dataChanged(createIndex(r, 0, item), createIndex(r, COLUMN_COUNT - 1, item));
+            return;
+        }
+
+        QModelIndex parentIndex;
+        if (dir) {
+            parentIndex = indexOf(dir);
+            if (!parentIndex.isValid())
+                return;
+        }
+
+        Rows &rows = children[ dir ];
+        int newRow = std::lower_bound(rows.begin(), rows.end(), item, positionLessThan) - rows.begin();
+
+        beginInsertRows(parentIndex, newRow, newRow);
+        rows.insert(newRow, item);
+        endInsertRows();
+    } else if (r >= 0) {
+        beginRemoveRows(dir ? indexOf(dir) : QModelIndex(), r, r);
+        children[ dir ].remove(r);
+        dropSubtree(item);
+        endRemoveRows();
+    }
+}
+
+int SynchronizerResultModel::row(SynchronizerFileItem *item) const
+{
+    QHash<SynchronizerFileItem *, Rows>::const_iterator it = children.constFind(item->parent());
+    if (it == children.constEnd())
+        return -1;
+
+    const Rows &rows = it.value();
+    Rows::const_iterator pos = std::lower_bound(rows.constBegin(), rows.constEnd(), item, positionLessThan);
+    return (pos != rows.constEnd() && *pos == item) ? pos - rows.constBegin() : -1;
+}
+
+void SynchronizerResultModel::dropSubtree(SynchronizerFileItem *dir)
+{
+    if (!dir->isDir())
+        return;
+
+    foreach(SynchronizerFileItem *child, children.take(dir))
+        dropSubtree(child);
+}
+
+QModelIndex SynchronizerResultModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (row < 0 || column < 0 || column >= COLUMN_COUNT)
+        return QModelIndex();
+
+    QHash<SynchronizerFileItem *, Rows>::const_iterator it = children.constFind(item(parent));
+    if (it == children.constEnd() || row >= it.value().count())
+        return QModelIndex();
+
+    return createIndex(row, column, it.value().at(row));
+}
+
+QModelIndex SynchronizerResultModel::parent(const QModelIndex &index) const
+{
+    SynchronizerFileItem *child = item(index);
+    if (child == 0 || child->parent() == 0)
+        return QModelIndex();
+
+    return indexOf(child->parent());
+}
+
+int SynchronizerResultModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+
+    QHash<SynchronizerFileItem *, Rows>::const_iterator it = children.constFind(item(parent));
+    return it == children.constEnd() ? 0 : it.value().count();
+}
+
+int SynchronizerResultModel::columnCount(const QModelIndex &) const
+{
+    return COLUMN_COUNT;
+}
+
+QVariant SynchronizerResultModel::data(const QModelIndex &index, int role) const
+{
+    SynchronizerFileItem *syncItem = item(index);
+    if (syncItem == 0)
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        bool isDir = syncItem->isDir();
+        bool isLeft = index.column() < 3;
+
+        if (index.column() == 3)
+            return Synchronizer::getTaskTypeName(syncItem->task());
+        if (isLeft ? !syncItem->existsInLeft() : !syncItem->existsInRight())
+            return QString();
+
+        switch (index.column()) {
+        case 0:
+            return syncItem->leftName();
+        case 1:
+            return isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(syncItem->leftSize());
+        case 2:
+            return convertTime(syncItem->leftDate());
+        case 4:
+            return convertTime(syncItem->rightDate());
+        case 5:
+            return isDir ? dirLabel() + ' ' : KRpermHandler::parseSize(syncItem->rightSize());
+        case 6:
+            return syncItem->rightName();
+        }
+        break;
+    }
+    case Qt::TextAlignmentRole:
+        if (index.column() == 1 || index.column() == 5)
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        if (index.column() == 3)
+            return int(Qt::AlignCenter);
+        break;
+    case Qt::DecorationRole:
+        if (index.column() == 0)
+            return syncItem->isDir() ? folderIcon : fileIcon;
+        break;
+    case Qt::ForegroundRole:
+        if (foreGrounds[ syncItem->task()].isValid())
+            return QBrush(foreGrounds[ syncItem->task()]);
+        break;
+    case Qt::BackgroundRole:
+        if (backGrounds[ syncItem->task()].isValid())
+            return QBrush(backGrounds[ syncItem->task()]);
+        break;
+    }
+    return QVariant();
+}
+
+QVariant SynchronizerResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < headerLabels.count())
+        return headerLabels[ section ];
+    return QVariant();
+}
+
+Qt::ItemFlags SynchronizerResultModel::flags(const QModelIndex &index) const
+{
+    SynchronizerFileItem *syncItem = item(index);
+    if (syncItem == 0)
+        return Qt::NoItemFlags;
+
+    Qt::ItemFlags result = Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+    if (!syncItem->isDir())
+        result |= Qt::ItemNeverHasChildren;
+    return result;
+}
+
+QString SynchronizerResultModel::convertTime(time_t time)
+{
+    // convert the time_t to struct tm
+    struct tm* t = localtime((time_t *) & time);
+
+    QDateTime tmp(QDate(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday), QTime(t->tm_hour, t->tm_min));
+    return QLocale().toString(tmp, QLocale::ShortFormat);
+}
+
+QString SynchronizerResultModel::dirLabel()
+{
+    //HACK add <> brackets AFTER translating - otherwise KUIT thinks it's a tag
+    static QString label = QString("<") +
+        i18nc("Show the string 'DIR' instead of file size in detailed view (for folders)", "DIR") + ">";
+    return label;
+}
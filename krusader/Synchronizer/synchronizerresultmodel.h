@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef SYNCHRONIZERRESULTMODEL_H
+#define SYNCHRONIZERRESULTMODEL_H
+
+// QtCore
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QItemSelection>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+// QtGui
+#include <QColor>
+#include <QPixmap>
+
+#include "synchronizerfileitem.h"
+
+class Synchronizer;
+
+/**
+ * The compare results of the synchronizer as a tree model.
+ *
+ * Only the marked items have rows. The model keeps just the list of the shown children of
+ * every directory, the texts, colors and icons are produced when the view asks for them, so
+ * only the visible rows cost anything. The rows of a directory are in the order of the
+ * synchronizer's result list, the index of a row is found by a binary search on it.
+ */
+class SynchronizerResultModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum { COLUMN_COUNT = 7 };
+
+    explicit SynchronizerResultModel(Synchronizer *sync, QObject *parent = 0);
+
+    void setHeaderLabels(const QStringList &labels);
+    /// the colors of the task types, arrays of TT_MAX elements
+    void setColors(const QColor *foreground, const QColor *background);
+    void setIcons(const QPixmap &file, const QPixmap &folder);
+
+    SynchronizerFileItem *item(const QModelIndex &index) const;
+    QSet<SynchronizerFileItem *> items(const QModelIndexList &indexes) const;
+    /// the index of the item in the first column, invalid if the item is not shown
+    QModelIndex indexOf(SynchronizerFileItem *item) const;
+    /// all rows of the model, also the ones in collapsed directories
+    QItemSelection allRows() const;
+
+    /// removes the rows, must be called before the synchronizer deletes its items
+    void clear();
+    /// creates the rows again from the marked items of the synchronizer
+    void reload();
+    /// adds, updates or removes the row of the item according to its mark
+    void itemChanged(SynchronizerFileItem *item);
+
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    virtual QModelIndex parent(const QModelIndex &index) const Q_DECL_OVERRIDE;
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    virtual QVariant headerData(int section, Qt::Orientation orientation,
+                                int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    virtual Qt::ItemFlags flags(const QModelIndex &index) const Q_DECL_OVERRIDE;
+
+private:
+    typedef QVector<SynchronizerFileItem *> Rows;
+
+    /// the row of the item among the shown children of its parent or -1
+    int row(SynchronizerFileItem *item) const;
+    /// drops the row lists of the subtree
+    void dropSubtree(SynchronizerFileItem *dir);
+
+    static QString convertTime(time_t time);
+    static QString dirLabel(); // returns translated '<DIR>'
+
+    Synchronizer                            *synchronizer;
+    QHash<SynchronizerFileItem *, Rows>      children;    // the shown children, 0 is the root
+    QStringList                              headerLabels;
+    QColor                                   foreGrounds[ TT_MAX ];
+    QColor                                   backGrounds[ TT_MAX ];
+    QPixmap                                  fileIcon;
+    QPixmap                                  folderIcon;
+};
+
+#endif /* SYNCHRONIZERRESULTMODEL_H */
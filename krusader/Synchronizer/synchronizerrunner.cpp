@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "synchronizerrunner.h"
+
+#include <stdio.h>
+
+// QtCore
+#include <QEventLoop>
+#include <QJsonDocument>
+// QtWidgets
+#include <QApplication>
+
+#include <KConfigCore/KConfigGroup>
+#include <KI18n/KLocalizedString>
+
+#include "synchronizertask.h"
+#include "../krglobal.h"
+#include "../defaults.h"
+#include "../Filter/filtersettings.h"
+#include "../GUI/profilemanager.h"
+#include "../VFS/krquery.h"
+
+#define PROGRESS_PERIOD 1000
+
+SynchronizerRunner::SynchronizerRunner(const QString &profileName) : QObject(),
+        profileName(profileName), finished(false)
+{
+    connect(&synchronizer, SIGNAL(statusInfo(QString)), this, SLOT(slotStatusInfo(QString)));
+    connect(&synchronizer, SIGNAL(processedSizes(int, KIO::filesize_t, int, KIO::filesize_t, int, KIO::filesize_t)),
+            this, SLOT(slotProcessedSizes(int, KIO::filesize_t, int, KIO::filesize_t, int, KIO::filesize_t)));
+    connect(&synchronizer, SIGNAL(synchronizationFinished()), this, SLOT(slotSynchronizationFinished()));
+}
+
+int SynchronizerRunner::run()
+{
+    runTimer.start();
+    progressTimer.start();
+    SynchronizerTask::setHeadless(true);
+
+    QString groupName = ProfileManager::profileGroup("SynchronizerProfile", profileName);
+    if (groupName.isNull()) {
+        printError(i18n("There is no synchronizer profile named %1.", profileName));
+        return 1;
+    }
+    KConfigGroup pg(krConfig, groupName);
+
+    FilterSettings filter;
+    filter.load(pg);
+    if (!filter.isValid()) {
+        printError(i18n("Could not load profile."));
+        return 1;
+    }
+    KRQuery query = filter.toQuery();
+    query.setNameFilter(pg.readEntry("Search For", QString()), query.isCaseSensitive());
+
+    QString leftLocation = pg.readEntry("Left Location", QString()).trimmed();
+    QString rightLocation = pg.readEntry("Right Location", QString()).trimmed();
+    if (leftLocation.isEmpty() || rightLocation.isEmpty()) {
+        printError(i18n("The target and the source folder must not be empty."));
+        return 1;
+    }
+
+    int parallelThreads = pg.readEntry("Parallel Threads", 1);
+    synchronizer.setMarkFlags(pg.readEntry("Show Right To Left", true), pg.readEntry("Show Equals", true),
+                              pg.readEntry("Show Differents", true), pg.readEntry("Show Left To Right", true),
+                              pg.readEntry("Show Duplicates", true), pg.readEntry("Show Singles", true),
+                              pg.readEntry("Show Deletable", true));
+
+    QJsonObject start;
+    start.insert("profile", profileName);
+    start.insert("left", leftLocation);
+    start.insert("right", rightLocation);
+    print("start", start);
+
+    QStringList selectedFiles;
+    QTime compareTimer;
+    compareTimer.start();
+    int fileCount = synchronizer.compare(leftLocation, rightLocation, &query,
+                                         pg.readEntry("Recurse Subdirectories", true),
+                                         pg.readEntry("Follow Symlinks", false), pg.readEntry("Ignore Date", false),
+                                         pg.readEntry("Asymmetric", false), pg.readEntry("Compare By Content", false),
+                                         pg.readEntry("Ignore Case", false), false, selectedFiles,
+                                         pg.readEntry("Equality Threshold", 0), pg.readEntry("Time Shift", 0),
+                                         parallelThreads, pg.readEntry("Ignore Hidden Files", false),
+                                         pg.readEntry("Cached Checksums", false), pg.readEntry("Incremental", false));
+    int compareTime = compareTimer.elapsed();
+
+    int leftNr, rightNr, deleteNr;
+    KIO::filesize_t leftSize, rightSize, deleteSize;
+    bool hasWork = synchronizer.totalSizes(&leftNr, &leftSize, &rightNr, &rightSize, &deleteNr, &deleteSize);
+
+    QJsonObject compared;
+    compared.insert("files", fileCount);
+    compared.insert("compareMs", compareTime);
+    compared.insert("copyToLeft", leftNr);
+    compared.insert("copyToLeftBytes", (double)leftSize);
+    compared.insert("copyToRight", rightNr);
+    compared.insert("copyToRightBytes", (double)rightSize);
+    compared.insert("delete", deleteNr);
+    compared.insert("deleteBytes", (double)deleteSize);
+    print("compared", compared);
+
+    int synchronizeTime = 0;
+    if (hasWork && SynchronizerTask::errorCount() == 0) {
+        KConfigGroup group(krConfig, "Synchronize");
+        QTime synchronizeTimer;
+        synchronizeTimer.start();
+
+        // nobody can confirm the overwrites, the profile was saved to update the other side
+        synchronizer.synchronize(0, leftNr != 0, rightNr != 0, deleteNr != 0, true, parallelThreads,
+                                 group.readEntry("Delta Copy", _DeltaCopy));
+        while (!finished)
+            qApp->processEvents(QEventLoop::WaitForMoreEvents);
+        synchronizeTime = synchronizeTimer.elapsed();
+    }
+
+    KIO::filesize_t totalSize = leftSize + rightSize;
+    QJsonObject done;
+    done.insert("compareMs", compareTime);
+    done.insert("synchronizeMs", synchronizeTime);
+    done.insert("copiedBytesPerSecond", synchronizeTime ? (double)totalSize * 1000 / synchronizeTime : 0.0);
+    done.insert("errors", SynchronizerTask::errorCount());
+    print("finished", done);
+
+    return SynchronizerTask::errorCount() ? 2 : 0;
+}
+
+void SynchronizerRunner::slotStatusInfo(QString info)
+{
+    if (progressTimer.elapsed() < PROGRESS_PERIOD)
+        return;
+    progressTimer.start();
+
+    QJsonObject status;
+    status.insert("message", info);
+    print("status", status);
+}
+
+void SynchronizerRunner::slotProcessedSizes(int leftNr, KIO::filesize_t leftSize, int rightNr,
+                                            KIO::filesize_t rightSize, int deleteNr, KIO::filesize_t deleteSize)
+{
+    if (progressTimer.elapsed() < PROGRESS_PERIOD)
+        return;
+    progressTimer.start();
+
+    QJsonObject progress;
+    progress.insert("copiedToLeft", leftNr);
+    progress.insert("copiedToLeftBytes", (double)leftSize);
+    progress.insert("copiedToRight", rightNr);
+    progress.insert("copiedToRightBytes", (double)rightSize);
+    progress.insert("deleted", deleteNr);
+    progress.insert("deletedBytes", (double)deleteSize);
+    print("progress", progress);
+}
+
+void SynchronizerRunner::slotSynchronizationFinished()
+{
+    finished = true;
+}
+
+void SynchronizerRunner::print(const QString &event, QJsonObject record)
+{
+    record.insert("event", event);
+    record.insert("elapsedMs", runTimer.elapsed());
+    fprintf(stdout, "%s\n", QJsonDocument(record).toJson(QJsonDocument::Compact).constData());
+    fflush(stdout);
+}
+
+void SynchronizerRunner::printError(const QString &message)
+{
+    fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
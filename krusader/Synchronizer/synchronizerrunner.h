@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef SYNCHRONIZERRUNNER_H
+#define SYNCHRONIZERRUNNER_H
+
+// QtCore
+#include <QJsonObject>
+#include <QObject>
+#include <QTime>
+
+#include <KIO/Global>
+
+#include "synchronizer.h"
+
+/**
+ * Runs a saved synchronizer profile without windows, e.g. for scheduled synchronizations.
+ *
+ * The folders of the profile are compared with its settings and the files marked by its
+ * filter buttons are synchronized in every direction, overwriting the changed files. The
+ * progress and the timings are written to the standard output as one JSON object per line,
+ * the errors to the standard error.
+ */
+class SynchronizerRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SynchronizerRunner(const QString &profileName);
+
+    /// compares and synchronizes the folders, returns the exit code of the process
+    int run();
+
+protected slots:
+    void slotStatusInfo(QString info);
+    void slotProcessedSizes(int leftNr, KIO::filesize_t leftSize, int rightNr, KIO::filesize_t rightSize,
+                            int deleteNr, KIO::filesize_t deleteSize);
+    void slotSynchronizationFinished();
+
+private:
+    void print(const QString &event, QJsonObject record = QJsonObject());
+    void printError(const QString &message);
+
+    Synchronizer synchronizer;
+    QString      profileName;
+    QTime        runTimer;        // the time since the start of the run
+    QTime        progressTimer;   // the progress is printed at most every PROGRESS_PERIOD ms
+    bool         finished;
+};
+
+#endif /* SYNCHRONIZERRUNNER_H */
@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "synchronizersnapshot.h"
+
+// QtCore
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <qplatformdefs.h>
+
+#define SNAPSHOT_MAGIC    0x4b525353  // "KRSS"
+#define SNAPSHOT_VERSION  2
+
+static QDataStream &operator<<(QDataStream &stream, const SynchronizerSnapshot::FolderState &state)
+{
+    return stream << state.device << state.inode << state.mtime << state.ctime << state.mode
+           << state.uid << state.gid;
+}
+
+static QDataStream &operator>>(QDataStream &stream, SynchronizerSnapshot::FolderState &state)
+{
+    return stream >> state.device >> state.inode >> state.mtime >> state.ctime >> state.mode
+           >> state.uid >> state.gid;
+}
+
+static QDataStream &operator<<(QDataStream &stream, const SynchronizerSnapshot::FileState &state)
+{
+    return stream << state.name << state.inode << state.size << state.mtime;
+}
+
+static QDataStream &operator>>(QDataStream &stream, SynchronizerSnapshot::FileState &state)
+{
+    return stream >> state.name >> state.inode >> state.size >> state.mtime;
+}
+
+void SynchronizerSnapshot::open(const QString &leftBase, const QString &rightBase, const QByteArray &settings)
+{
+    close();
+
+    QByteArray id = QCryptographicHash::hash((leftBase + '\n' + rightBase).toUtf8(), QCryptographicHash::Sha1);
+    fileName = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) +
+               QStringLiteral("/krusader/synchronizer-snapshots/") + QString::fromLatin1(id.toHex());
+    this->settings = settings;
+    load();
+}
+
+void SynchronizerSnapshot::close()
+{
+    fileName.clear();
+    settings.clear();
+    previous.clear();
+    current.clear();
+    different.clear();
+}
+
+void SynchronizerSnapshot::load()
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic, version, count;
+    QByteArray storedSettings;
+    stream >> magic >> version >> storedSettings >> count;
+    // the equality of the folders depends on the filter and the options
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || storedSettings != settings)
+        return;
+
+    previous.reserve(count);
+    for (quint32 i = 0; i != count && stream.status() == QDataStream::Ok; ++i) {
+        QString dir;
+        Folder folder;
+        stream >> dir >> folder.left >> folder.right >> folder.leftSubDirs >> folder.rightSubDirs
+               >> folder.leftFiles >> folder.rightFiles;
+        if (stream.status() == QDataStream::Ok)
+            previous.insert(dir, folder);
+    }
+}
+
+bool SynchronizerSnapshot::findUnchanged(const QString &dir, const FolderState &left,
+                                         const FolderState &right, Folder &folder) const
+{
+    QHash<QString, Folder>::const_iterator it = previous.constFind(dir);
+    if (it == previous.constEnd() || !it->left.isUnchanged(left) || !it->right.isUnchanged(right))
+        return false;
+    folder = *it;
+    return true;
+}
+
+void SynchronizerSnapshot::setEqual(const QString &dir, const Folder &folder)
+{
+    if (!different.contains(dir))
+        current.insert(dir, folder);
+}
+
+void SynchronizerSnapshot::setDifferent(const QString &dir)
+{
+    current.remove(dir);
+    different.insert(dir);
+}
+
+void SynchronizerSnapshot::save()
+{
+    if (fileName.isEmpty())
+        return;
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << (quint32)SNAPSHOT_MAGIC << (quint32)SNAPSHOT_VERSION << settings << (quint32)current.count();
+    for (QHash<QString, Folder>::const_iterator it = current.constBegin(); it != current.constEnd(); ++it)
+        stream << it.key() << it->left << it->right << it->leftSubDirs << it->rightSubDirs
+               << it->leftFiles << it->rightFiles;
+
+    if (file.commit())
+        previous = current;
+}
+
+bool SynchronizerSnapshot::folderState(const QString &path, FolderState &state)
+{
+    QT_STATBUF stat_p;
+    if (QT_STAT(QFile::encodeName(path).constData(), &stat_p) != 0)
+        return false;
+
+    state.device = stat_p.st_dev;
+    state.inode = stat_p.st_ino;
+#ifdef Q_OS_LINUX
+    state.mtime = (qint64)stat_p.st_mtim.tv_sec * 1000000000 + stat_p.st_mtim.tv_nsec;
+    state.ctime = (qint64)stat_p.st_ctim.tv_sec * 1000000000 + stat_p.st_ctim.tv_nsec;
+#else
+    state.mtime = (qint64)stat_p.st_mtime * 1000000000;
+    state.ctime = (qint64)stat_p.st_ctime * 1000000000;
+#endif
+    state.mode = stat_p.st_mode;
+    state.uid = stat_p.st_uid;
+    state.gid = stat_p.st_gid;
+    return true;
+}
+
+bool SynchronizerSnapshot::filesUnchanged(const QString &path, const QVector<FileState> &files)
+{
+    const QString dir = path.endsWith('/') ? path : path + '/';
+    for (const FileState &file : files) {
+        QT_STATBUF stat_p;
+        if (QT_LSTAT(QFile::encodeName(dir + file.name).constData(), &stat_p) != 0)
+            return false;
+#ifdef Q_OS_LINUX
+        const qint64 mtime = (qint64)stat_p.st_mtim.tv_sec * 1000000000 + stat_p.st_mtim.tv_nsec;
+#else
+        const qint64 mtime = (qint64)stat_p.st_mtime * 1000000000;
+#endif
+        if ((quint64)stat_p.st_ino != file.inode || (quint64)stat_p.st_size != file.size || mtime != file.mtime)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef SYNCHRONIZERSNAPSHOT_H
+#define SYNCHRONIZERSNAPSHOT_H
+
+// QtCore
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * The folder pairs found equal at the last synchronization of two local folders.
+ *
+ * The snapshot is taken after a successful synchronization. At the next comparison a folder
+ * pair is not listed again if neither of the folders changed since then: the modification
+ * and status change times of a folder change when an entry is created, removed or renamed in
+ * it. A file rewritten in place doesn't change its folder, so the inode, size and
+ * modification time of the compared files are kept too and checked before a pair is skipped.
+ * Only the subfolders of such a pair are compared, so the result shows only the changes.
+ *
+ * The snapshots are stored in the Krusader data folder, one for each pair of base folders.
+ */
+class SynchronizerSnapshot
+{
+public:
+    /// the stat data of a local folder
+    struct FolderState {
+        quint64 device;
+        quint64 inode;
+        qint64  mtime;
+        qint64  ctime;
+        quint32 mode;
+        quint32 uid;
+        quint32 gid;
+
+        bool isUnchanged(const FolderState &other) const {
+            return device == other.device && inode == other.inode && mtime == other.mtime &&
+                   ctime == other.ctime;
+        }
+    };
+
+    /// the stat data of a compared file
+    struct FileState {
+        QString name;
+        quint64 inode;
+        quint64 size;
+        qint64  mtime;
+    };
+
+    /// an equal folder pair with the names of its subfolder pairs and the states of its files
+    struct Folder {
+        FolderState        left;
+        FolderState        right;
+        QStringList        leftSubDirs;
+        QStringList        rightSubDirs;
+        QVector<FileState> leftFiles;
+        QVector<FileState> rightFiles;
+    };
+
+    SynchronizerSnapshot() {}
+
+    /// opens the snapshot of the base folders, it is dropped if the settings have changed
+    void open(const QString &leftBase, const QString &rightBase, const QByteArray &settings);
+    void close();
+    bool isOpen() const {
+        return !fileName.isEmpty();
+    }
+
+    /// returns the folder pair of the snapshot if neither of the folders changed since then
+    bool findUnchanged(const QString &dir, const FolderState &left, const FolderState &right,
+                       Folder &folder) const;
+    /// records an equal folder pair for the new snapshot
+    void setEqual(const QString &dir, const Folder &folder);
+    /// a difference was found in the folder pair, it is compared again next time
+    void setDifferent(const QString &dir);
+    bool hasDifferences() const {
+        return !different.isEmpty();
+    }
+
+    /// replaces the stored snapshot with the folder pairs recorded in this session
+    void save();
+
+    static bool folderState(const QString &path, FolderState &state);
+    /// true if none of the files in the local folder changed since their states were taken
+    static bool filesUnchanged(const QString &path, const QVector<FileState> &files);
+
+private:
+    void load();
+
+    QString                 fileName;
+    QByteArray              settings;   // the comparison settings the snapshot was taken with
+    QHash<QString, Folder>  previous;   // the stored snapshot
+    QHash<QString, Folder>  current;    // the equal folder pairs of this session
+    QSet<QString>           different;  // the folder pairs with differences
+};
+
+#endif /* SYNCHRONIZERSNAPSHOT_H */
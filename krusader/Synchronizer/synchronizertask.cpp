@@ -30,18 +30,218 @@
 
 #include "synchronizertask.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <qplatformdefs.h>
 // QtCore
-#include <QTimer>
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
 
 #include <KI18n/KLocalizedString>
 #include <KWidgetsAddons/KMessageBox>
 
 #include "synchronizer.h"
+#include "synchronizerchecksumcache.h"
 #include "synchronizerfileitem.h"
 #include "synchronizerdirlist.h"
 #include "../VFS/vfs.h"
 
+#define COMPARE_FIRST_BLOCK     65536     // a small first read finds most differences quickly
+#define COMPARE_BUFFER_SIZE     1048576
+#define COMPARE_BUFFER_ALIGN    4096
+
+QThreadPool *SynchronizerTask::workerPool()
+{
+    static QThreadPool *pool = 0;
+    if (!pool)
+        pool = new QThreadPool(QCoreApplication::instance());
+    return pool;
+}
+
+static bool headlessMode = false;
+static int  shownErrors = 0;
+
+void SynchronizerTask::setHeadless(bool headless)
+{
+    headlessMode = headless;
+}
+
+bool SynchronizerTask::isHeadless()
+{
+    return headlessMode;
+}
+
+void SynchronizerTask::showError(QWidget *parent, const QString &message)
+{
+    shownErrors++;
+    if (headlessMode)
+        fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+    else
+        KMessageBox::error(parent, message);
+}
+
+int SynchronizerTask::errorCount()
+{
+    return shownErrors;
+}
+
+/**
+ * Two local files compared by the worker pool. The state is shared between the worker and
+ * the task, which may be deleted before the worker is finished.
+ */
+struct CompareContentTask::LocalCompare
+{
+    enum Result { Equal, Different, LeftOpenError, RightOpenError };
+
+    QMutex                  mutex;
+    CompareContentTask     *owner;     // guarded by mutex, 0 if the task was deleted
+    QAtomicInt              cancelled;
+    QAtomicInteger<qint64>  received;
+    QString                 leftPath;
+    QString                 rightPath;
+    bool                    useChecksumCache;
+    int                     result;
+};
+
+namespace {
+class LocalCompareWorker : public QRunnable
+{
+public:
+    explicit LocalCompareWorker(const QSharedPointer<CompareContentTask::LocalCompare> &compare) :
+        compare(compare) {}
+
+    void run() Q_DECL_OVERRIDE {
+        int result = CompareContentTask::LocalCompare::Equal;
+        if (!compare->cancelled.load())
+            result = compareFiles();
+
+        QMutexLocker locker(&compare->mutex);
+        if (!compare->owner)
+            return;
+        compare->result = result;
+        QMetaObject::invokeMethod(compare->owner, "slotLocalCompareDone", Qt::QueuedConnection);
+    }
+
+private:
+    int compareFiles() {
+        int leftFd = QT_OPEN(QFile::encodeName(compare->leftPath).constData(), O_RDONLY);
+        if (leftFd < 0)
+            return CompareContentTask::LocalCompare::LeftOpenError;
+        int rightFd = QT_OPEN(QFile::encodeName(compare->rightPath).constData(), O_RDONLY);
+        if (rightFd < 0) {
+            QT_CLOSE(leftFd);
+            return CompareContentTask::LocalCompare::RightOpenError;
+        }
+
+        int result = compareFds(leftFd, rightFd);
+        QT_CLOSE(leftFd);
+        QT_CLOSE(rightFd);
+        return result;
+    }
+
+    int compareFds(int leftFd, int rightFd) {
+        QT_STATBUF leftStat, rightStat;
+        if (QT_FSTAT(leftFd, &leftStat) != 0 || QT_FSTAT(rightFd, &rightStat) != 0 ||
+                leftStat.st_size != rightStat.st_size)
+            return CompareContentTask::LocalCompare::Different;
+        if (leftStat.st_dev == rightStat.st_dev && leftStat.st_ino == rightStat.st_ino)
+            return CompareContentTask::LocalCompare::Equal;
+
+        SynchronizerChecksumCache::Key leftKey = checksumKey(leftStat);
+        SynchronizerChecksumCache::Key rightKey = checksumKey(rightStat);
+        if (compare->useChecksumCache) {
+            QByteArray leftSum = SynchronizerChecksumCache::instance()->find(leftKey);
+            QByteArray rightSum = SynchronizerChecksumCache::instance()->find(rightKey);
+            if (!leftSum.isEmpty() && !rightSum.isEmpty())
+                return leftSum == rightSum ? CompareContentTask::LocalCompare::Equal :
+                       CompareContentTask::LocalCompare::Different;
+        }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(leftFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(rightFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        char *leftBuffer = (char *)qMallocAligned(COMPARE_BUFFER_SIZE, COMPARE_BUFFER_ALIGN);
+        char *rightBuffer = (char *)qMallocAligned(COMPARE_BUFFER_SIZE, COMPARE_BUFFER_ALIGN);
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+
+        int result = CompareContentTask::LocalCompare::Different;
+        qint64 blockSize = COMPARE_FIRST_BLOCK;
+        while (leftBuffer && rightBuffer && !compare->cancelled.load()) {
+            qint64 leftBytes = readBlock(leftFd, leftBuffer, blockSize);
+            qint64 rightBytes = readBlock(rightFd, rightBuffer, blockSize);
+
+            if (leftBytes != rightBytes || leftBytes < 0)
+                break;
+            if (leftBytes == 0) {
+                result = CompareContentTask::LocalCompare::Equal;
+                break;
+            }
+            if (memcmp(leftBuffer, rightBuffer, leftBytes))
+                break;
+            if (compare->useChecksumCache)
+                hash.addData(leftBuffer, leftBytes);
+
+            compare->received.fetchAndAddRelaxed(leftBytes);
+            blockSize = COMPARE_BUFFER_SIZE;
+        }
+
+        qFreeAligned(leftBuffer);
+        qFreeAligned(rightBuffer);
+
+        // only the checksums of equal files are complete
+        if (result == CompareContentTask::LocalCompare::Equal && compare->useChecksumCache) {
+            const QByteArray checksum = hash.result();
+            SynchronizerChecksumCache::instance()->insert(leftKey, checksum);
+            SynchronizerChecksumCache::instance()->insert(rightKey, checksum);
+        }
+        return result;
+    }
+
+    static qint64 readBlock(int fd, char *buffer, qint64 size) {
+        qint64 done = 0;
+        while (done < size) {
+            qint64 bytes = QT_READ(fd, buffer + done, size - done);
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes < 0)
+                return -1;
+            if (bytes == 0)
+                break;
+            done += bytes;
+        }
+        return done;
+    }
+
+    static SynchronizerChecksumCache::Key checksumKey(const QT_STATBUF &stat) {
+        SynchronizerChecksumCache::Key key;
+        key.device = stat.st_dev;
+        key.inode = stat.st_ino;
+        key.size = stat.st_size;
+#ifdef Q_OS_LINUX
+        key.mtime = (qint64)stat.st_mtim.tv_sec * 1000000000 + stat.st_mtim.tv_nsec;
+        key.ctime = (qint64)stat.st_ctim.tv_sec * 1000000000 + stat.st_ctim.tv_nsec;
+#else
+        key.mtime = (qint64)stat.st_mtime * 1000000000;
+        key.ctime = (qint64)stat.st_ctime * 1000000000;
+#endif
+        return key;
+    }
+
+    QSharedPointer<CompareContentTask::LocalCompare> compare;
+};
+}
+
 CompareTask::CompareTask(SynchronizerFileItem *parentIn, const QString &leftURL,
                          const QString &rightURL, const QString &leftDir,
                          const QString &rightDir, bool hidden) : SynchronizerTask(),  m_parent(parentIn),
@@ -121,20 +321,22 @@ CompareContentTask::CompareContentTask(Synchronizer *syn, SynchronizerFileItem *
         leftURL(leftURLIn), rightURL(rightURLIn),
         size(sizeIn), errorPrinted(false), leftReadJob(0),
         rightReadJob(0), compareArray(), owner(-1), item(itemIn), timer(0),
-        leftFile(0), rightFile(0), received(0), sync(syn)
+        received(0), sync(syn)
 {
 }
 
 CompareContentTask::~CompareContentTask()
 {
+    if (localCompare) {
+        QMutexLocker locker(&localCompare->mutex);
+        localCompare->owner = 0;
+        localCompare->cancelled = 1;
+    }
+
     abortContentComparing();
 
     if (timer)
         delete timer;
-    if (leftFile)
-        delete leftFile;
-    if (rightFile)
-        delete rightFile;
 }
 
 void CompareContentTask::start()
@@ -142,26 +344,19 @@ void CompareContentTask::start()
     m_state = ST_STATE_PENDING;
 
     if (leftURL.isLocalFile() && rightURL.isLocalFile()) {
-        leftFile = new QFile(leftURL.path());
-        if (!leftFile->open(QIODevice::ReadOnly)) {
-            KMessageBox::error(parentWidget, i18n("Error at opening %1.", leftURL.path()));
-            m_state = ST_STATE_ERROR;
-            return;
-        }
-
-        rightFile = new QFile(rightURL.path());
-        if (!rightFile->open(QIODevice::ReadOnly)) {
-            KMessageBox::error(parentWidget, i18n("Error at opening %1.", rightURL.path()));
-            m_state = ST_STATE_ERROR;
-            return;
-        }
+        // the files are compared by a worker thread, the GUI thread only shows the progress
+        localCompare = QSharedPointer<LocalCompare>(new LocalCompare);
+        localCompare->owner = this;
+        localCompare->leftPath = leftURL.path();
+        localCompare->rightPath = rightURL.path();
+        localCompare->useChecksumCache = sync->useChecksumCache();
+        localCompare->result = LocalCompare::Different;
+        workerPool()->start(new LocalCompareWorker(localCompare));
 
         timer = new QTimer(this);
         connect(timer, SIGNAL(timeout()), this, SLOT(sendStatusMessage()));
         timer->setSingleShot(true);
         timer->start(1000);
-
-        localFileCompareCycle();
     } else {
         leftReadJob = KIO::get(leftURL, KIO::NoReload, KIO::HideProgressInfo);
         rightReadJob = KIO::get(rightURL, KIO::NoReload, KIO::HideProgressInfo);
@@ -184,58 +379,36 @@ void CompareContentTask::start()
     }
 }
 
-void CompareContentTask::localFileCompareCycle()
+void CompareContentTask::slotLocalCompareDone()
 {
+    if (!localCompare)
+        return;
 
-    bool different = false;
-
-    char leftBuffer[ 1440 ];
-    char rightBuffer[ 1440 ];
-
-    QTime timer;
-    timer.start();
-
-    int cnt = 0;
-
-    while (!leftFile->atEnd() && !rightFile->atEnd()) {
-        int leftBytes = leftFile->read(leftBuffer, sizeof(leftBuffer));
-        int rightBytes = rightFile->read(rightBuffer, sizeof(rightBuffer));
-
-        if (leftBytes != rightBytes) {
-            different = true;
-            break;
-        }
-
-        if (leftBytes <= 0)
-            break;
-
-        received += leftBytes;
-
-        if (memcmp(leftBuffer, rightBuffer, leftBytes)) {
-            different = true;
-            break;
-        }
-
-        if ((++cnt % 16) == 0 && timer.elapsed() >= 250)
-            break;
+    int result;
+    {
+        QMutexLocker locker(&localCompare->mutex);
+        localCompare->owner = 0;
+        result = localCompare->result;
     }
+    localCompare.clear();
+    if (timer)
+        timer->stop();
 
-    if (different) {
-        sync->compareContentResult(item, false);
-        m_state = ST_STATE_READY;
+    switch (result) {
+    case LocalCompare::LeftOpenError:
+        showError(parentWidget, i18n("Error at opening %1.", leftURL.path()));
+        m_state = ST_STATE_ERROR;
         return;
-    }
-
-    if (leftFile->atEnd() && rightFile->atEnd()) {
-        sync->compareContentResult(item, true);
-        m_state = ST_STATE_READY;
+    case LocalCompare::RightOpenError:
+        showError(parentWidget, i18n("Error at opening %1.", rightURL.path()));
+        m_state = ST_STATE_ERROR;
         return;
+    default:
+        sync->compareContentResult(item, result == LocalCompare::Equal);
+        m_state = ST_STATE_READY;
     }
-
-    QTimer::singleShot(0, this, SLOT(localFileCompareCycle()));
 }
 
-
 void CompareContentTask::slotDataReceived(KIO::Job *job, const QByteArray &data)
 {
     int jobowner = (job == leftReadJob) ? 1 : 0;
@@ -312,9 +485,9 @@ void CompareContentTask::slotFinished(KJob *job)
 
     if (job->error() && job->error() != KIO::ERR_USER_CANCELED && !errorPrinted) {
         errorPrinted = true;
-        KMessageBox::error(parentWidget, i18n("I/O error while comparing file %1 with %2.",
-                                              leftURL.toDisplayString(QUrl::PreferLocalFile),
-                                              rightURL.toDisplayString(QUrl::PreferLocalFile)));
+        showError(parentWidget, i18n("I/O error while comparing file %1 with %2.",
+                                     leftURL.toDisplayString(QUrl::PreferLocalFile),
+                                     rightURL.toDisplayString(QUrl::PreferLocalFile)));
     }
 
     if (leftReadJob == 0 && rightReadJob == 0) {
@@ -345,7 +518,8 @@ void CompareContentTask::abortContentComparing()
 
 void CompareContentTask::sendStatusMessage()
 {
-    double perc = (size == 0) ? 1. : (double)received / (double)size;
+    KIO::filesize_t done = localCompare ? (KIO::filesize_t)localCompare->received.load() : received;
+    double perc = (size == 0) ? 1. : (double)done / (double)size;
     int percent = (int)(perc * 10000. + 0.5);
     QString statstr = QString("%1.%2%3").arg(percent / 100).arg((percent / 10) % 10).arg(percent % 10) + '%';
     setStatusMessage(i18n("Comparing file %1 (%2)...", leftURL.fileName(), statstr));
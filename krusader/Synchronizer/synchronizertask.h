@@ -33,6 +33,7 @@
 
 // QtCore
 #include <QObject>
+#include <QSharedPointer>
 
 #include <KIO/Job>
 
@@ -40,7 +41,7 @@ class Synchronizer;
 class SynchronizerDirList;
 class SynchronizerFileItem;
 class QTimer;
-class QFile;
+class QThreadPool;
 
 #define ST_STATE_NEW      0
 #define ST_STATE_PENDING  1
@@ -78,6 +79,17 @@ public:
         return QString();
     }
 
+    /// the threads listing the local folders and comparing the local files
+    static QThreadPool *workerPool();
+
+    /// without windows the errors are printed instead of shown in message boxes
+    static void setHeadless(bool headless);
+    static bool isHeadless();
+    /// shows an error of the comparison or the synchronization
+    static void showError(QWidget *parent, const QString &message);
+    /// the number of the errors shown since the start of the program
+    static int errorCount();
+
 protected:
     virtual void start() {}
     int m_state;
@@ -164,6 +176,8 @@ public:
     CompareContentTask(Synchronizer *, SynchronizerFileItem *, const QUrl &, const QUrl &, KIO::filesize_t);
     virtual ~CompareContentTask();
 
+    struct LocalCompare;
+
 public slots:
     void    slotDataReceived(KIO::Job *job, const QByteArray &data);
     void    slotFinished(KJob *job);
@@ -173,7 +187,7 @@ protected:
     virtual void start();
 
 protected slots:
-    void    localFileCompareCycle();
+    void    slotLocalCompareDone();
 
 private:
     void    abortContentComparing();
@@ -190,8 +204,7 @@ private:
     SynchronizerFileItem  *item;           // the item for content compare
     QTimer                *timer;          // timer to show the process dialog at compare by content
 
-    QFile                 *leftFile;       // the left side local file
-    QFile                 *rightFile;      // the right side local file
+    QSharedPointer<LocalCompare> localCompare; // the local files compared by a worker thread
 
     KIO::filesize_t        received;       // the received size
     Synchronizer          *sync;
@@ -33,6 +33,7 @@
 // QtCore
 #include <QEventLoop>
 #include <QDir>
+#include <QFile>
 
 #include <KConfigCore/KSharedConfig>
 #include <KCoreAddons/KUrlMimeData>
@@ -51,6 +52,7 @@
 #include "../krservices.h"
 #include "../JobMan/jobman.h"
 #include "../JobMan/krjob.h"
+#include "krfileindex.h"
 
 default_vfs::default_vfs(): vfs(), _watcher()
 {
@@ -337,17 +339,35 @@ bool default_vfs::refreshLocal(const QUrl &directory) {
         return false;
     }
 
+    // keep the file index up to date with the directories the user visits
+    const bool feedIndex = KrFileIndex::isEnabled() && KrFileIndex::instance()->wantsListing(path);
+    const QByteArray indexPath = QFile::encodeName(QDir::cleanPath(path));
+    QList<KrFileIndexEntry> indexEntries;
+
     QT_DIRENT* dirEnt;
     QString name;
     const bool showHidden = showHiddenFiles();
     while ((dirEnt = QT_READDIR(dir)) != NULL) {
         name = QString::fromLocal8Bit(dirEnt->d_name);
 
-        // show hidden files?
-        if (!showHidden && name.left(1) == ".") continue ;
         // we don't need the "." and ".." entries
         if (name == "." || name == "..") continue;
 
+        // the index contains the hidden files too
+        if (feedIndex) {
+            KrFileIndexEntry entry;
+            entry.name = dirEnt->d_name;
+#ifdef DT_UNKNOWN
+            entry.flags = KrFileIndexBuilder::entryFlags(indexPath, dirEnt->d_name, dirEnt->d_type);
+#else
+            entry.flags = KrFileIndexBuilder::entryFlags(indexPath, dirEnt->d_name, 0);
+#endif
+            indexEntries.append(entry);
+        }
+
+        // show hidden files?
+        if (!showHidden && name.left(1) == ".") continue ;
+
         vfile* temp = createLocalVFile(name);
         addVfile(temp);
     }
@@ -366,6 +386,9 @@ bool default_vfs::refreshLocal(const QUrl &directory) {
     connect(_watcher.data(), &KDirWatch::deleted, this, &default_vfs::slotWatcherDeleted);
     _watcher->startScan(false);
 
+    if (feedIndex)
+        KrFileIndex::instance()->updateDirectory(path, indexEntries);
+
     return true;
 }
 
@@ -0,0 +1,811 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#include "krfileindex.h"
+
+#include <algorithm>
+
+// QtCore
+#include <QByteArrayMatcher>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <qplatformdefs.h>
+
+#include <KConfigCore/KConfigGroup>
+
+#include "../defaults.h"
+#include "../krglobal.h"
+
+#define INDEX_FILE          "krusader/fileindex"
+#define JOURNAL_FILE        "krusader/fileindex-pending"
+#define INDEX_MAGIC         "KRFI"
+#define INDEX_VERSION       1
+#define JOURNAL_MAGIC       0x4b52464a  // "KRFJ"
+// up to this many directories are replaced in place, more are merged in one pass
+#define MAX_REPLACED_DIRS   64
+
+const quint32 KrFileIndexData::NoParent;
+
+KrFileIndex * KrFileIndex::self = 0;
+int KrFileIndex::enabled = -1;
+
+static void writeNumber(QByteArray &buffer, quint32 value)
+{
+    while (value >= 0x80) {
+        buffer.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(char(value));
+}
+
+static bool readNumber(const uchar *&pos, const uchar *end, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; pos < end && shift < 32; shift += 7) {
+        const uchar byte = *pos++;
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static QByteArray childPath(const QByteArray &dir, const char *name, int len)
+{
+    QByteArray path = dir;
+    if (!path.endsWith('/'))
+        path += '/';
+    path.append(name, len);
+    return path;
+}
+
+static bool lessByName(const KrFileIndexEntry &a, const KrFileIndexEntry &b)
+{
+    return a.name < b.name;
+}
+
+static bool lessByLength(const QByteArray &a, const QByteArray &b)
+{
+    return a.length() < b.length();
+}
+
+static void foldCase(QByteArray &names)
+{
+    char *folded = names.data();
+    for (int i = 0; i < names.size(); ++i)
+        if (folded[i] >= 'A' && folded[i] <= 'Z')
+            folded[i] += 'a' - 'A';
+}
+
+template <typename T>
+static void replaceRange(QVector<T> &vector, int pos, int len, const QVector<T> &with)
+{
+    vector = vector.mid(0, pos) + with + vector.mid(pos + len);
+}
+
+// ------------------------------- KrFileIndexData -------------------------------
+
+quint32 KrFileIndexData::append(const char *name, int len, uchar entryFlags, quint32 parent)
+{
+    if (nameOffsets.isEmpty())
+        nameOffsets.append(0);
+
+    names.append(name, len);
+    names.append('\0');
+    nameOffsets.append(names.size());
+    parents.append(parent);
+    subtreeEnds.append(0);
+    flags.append(char(entryFlags));
+    return parents.count() - 1;
+}
+
+void KrFileIndexData::finalize()
+{
+    const int cnt = count();
+    for (int i = 0; i < cnt; ++i)
+        subtreeEnds[i] = i + 1;
+    // the subtree of an entry ends where the subtree of its last descendant ends
+    for (int i = cnt - 1; i >= 0; --i) {
+        const quint32 parent = parents[i];
+        if (parent != NoParent && subtreeEnds[parent] < subtreeEnds[i])
+            subtreeEnds[parent] = subtreeEnds[i];
+    }
+
+    foldedNames = names;
+    foldCase(foldedNames);
+}
+
+void KrFileIndexData::clear()
+{
+    names.clear();
+    foldedNames.clear();
+    nameOffsets.clear();
+    parents.clear();
+    subtreeEnds.clear();
+    flags.clear();
+}
+
+void KrFileIndexData::replaceChildren(quint32 dir, const QList<KrFileIndexEntry> &entries)
+{
+    const quint32 first = dir + 1;
+    const quint32 end = subtreeEnds[dir];
+
+    // build the new range [first, end) aside, both lists are sorted by name
+    QByteArray       newNames;
+    QVector<quint32> newOffsets;  // relative to the start of the range
+    QVector<quint32> newParents;
+    QVector<quint32> newEnds;
+    QByteArray       newFlags;
+
+    quint32 oldChild = first;
+    for (const KrFileIndexEntry &entry : entries) {
+        while (oldChild < end && qstrcmp(name(oldChild), entry.name.constData()) < 0)
+            oldChild = subtreeEnds[oldChild];
+
+        const int child = newParents.count();
+        newOffsets.append(newNames.size());
+        newNames.append(entry.name.constData(), entry.name.length() + 1);
+        newParents.append(dir);
+        newEnds.append(0);
+        newFlags.append(char(entry.flags));
+
+        if (oldChild < end && (entry.flags & IsDir) && (flags[oldChild] & IsDir) &&
+                qstrcmp(name(oldChild), entry.name.constData()) == 0) {
+            // the subfolder is still there: its subtree moves to the new id of the folder
+            const quint32 oldEnd = subtreeEnds[oldChild];
+            const qint64 shift = qint64(first + child) - oldChild;
+            const qint64 nameShift = qint64(newNames.size()) - nameOffsets[oldChild + 1];
+            for (quint32 id = oldChild + 1; id < oldEnd; ++id) {
+                newOffsets.append(quint32(nameOffsets[id] + nameShift));
+                newParents.append(quint32(parents[id] + shift));
+                newEnds.append(quint32(subtreeEnds[id] + shift));
+            }
+            newNames.append(names.constData() + nameOffsets[oldChild + 1], nameOffsets[oldEnd] - nameOffsets[oldChild + 1]);
+            newFlags.append(flags.constData() + oldChild + 1, oldEnd - oldChild - 1);
+        }
+        newEnds[child] = first + newParents.count();
+    }
+
+    const int oldCount = end - first;
+    const int delta = newParents.count() - oldCount;
+    const quint32 nameStart = nameOffsets[first];
+    const int oldNamesLen = nameOffsets[end] - nameStart;
+    const int nameDelta = newNames.size() - oldNamesLen;
+
+    // the ancestors grow, the entries after the range move
+    for (quint32 id = 0; id < first; ++id)
+        if (subtreeEnds[id] >= end)
+            subtreeEnds[id] += delta;
+    for (int id = end; id < count(); ++id) {
+        if (parents[id] != NoParent && parents[id] >= end)
+            parents[id] += delta;
+        subtreeEnds[id] += delta;
+    }
+    for (int i = end; i < nameOffsets.count(); ++i)
+        nameOffsets[i] += nameDelta;
+    for (int i = 0; i < newOffsets.count(); ++i)
+        newOffsets[i] += nameStart;
+
+    QByteArray newFoldedNames = newNames;
+    foldCase(newFoldedNames);
+
+    names.replace(nameStart, oldNamesLen, newNames);
+    foldedNames.replace(nameStart, oldNamesLen, newFoldedNames);
+    flags.replace(first, oldCount, newFlags);
+    replaceRange(nameOffsets, first, oldCount, newOffsets);
+    replaceRange(parents, first, oldCount, newParents);
+    replaceRange(subtreeEnds, first, oldCount, newEnds);
+}
+
+bool KrFileIndexData::sameChildren(quint32 dir, const QList<KrFileIndexEntry> &entries) const
+{
+    quint32 child = dir + 1;
+    for (const KrFileIndexEntry &entry : entries) {
+        if (child >= subtreeEnds[dir] || uchar(flags[child]) != entry.flags || nameLength(child) != entry.name.length() ||
+                memcmp(name(child), entry.name.constData(), entry.name.length()) != 0)
+            return false;
+        child = subtreeEnds[child];
+    }
+    return child == subtreeEnds[dir];
+}
+
+QByteArray KrFileIndexData::path(quint32 id) const
+{
+    QVector<quint32> chain;
+    for (quint32 i = id; i != NoParent; i = parents[i])
+        chain.append(i);
+
+    QByteArray result(name(chain.last()), nameLength(chain.last()));
+    for (int i = chain.count() - 2; i >= 0; --i)
+        result = childPath(result, name(chain[i]), nameLength(chain[i]));
+    return result;
+}
+
+quint32 KrFileIndexData::find(const QByteArray &path) const
+{
+    for (quint32 root = 0; root < (quint32)count(); root = subtreeEnds[root]) {
+        const QByteArray rootName(name(root), nameLength(root));
+        if (path == rootName)
+            return root;
+
+        QByteArray prefix = rootName;
+        if (!prefix.endsWith('/'))
+            prefix += '/';
+        if (!path.startsWith(prefix))
+            continue;
+
+        quint32 id = root;
+        const QList<QByteArray> components = path.mid(prefix.length()).split('/');
+        for (const QByteArray &component : components) {
+            if (component.isEmpty())
+                continue;
+            if ((id = findChild(id, component.constData(), component.length())) == NoParent)
+                break;
+        }
+        return id;
+    }
+    return NoParent;
+}
+
+quint32 KrFileIndexData::findChild(quint32 dir, const char *childName, int len) const
+{
+    for (quint32 id = dir + 1; id < subtreeEnds[dir]; id = subtreeEnds[id])
+        if (nameLength(id) == len && memcmp(name(id), childName, len) == 0)
+            return id;
+    return NoParent;
+}
+
+// ------------------------------- KrFileIndexBuilder -------------------------------
+
+QList<KrFileIndexEntry> KrFileIndexBuilder::readDirectory(const QByteArray &path)
+{
+    QList<KrFileIndexEntry> entries;
+
+    QT_DIR* dir = QT_OPENDIR(path.constData());
+    if (!dir)
+        return entries;
+
+    QT_DIRENT* dirEnt;
+    while ((dirEnt = QT_READDIR(dir)) != NULL) {
+        if (qstrcmp(dirEnt->d_name, ".") == 0 || qstrcmp(dirEnt->d_name, "..") == 0)
+            continue;
+
+        KrFileIndexEntry entry;
+        entry.name = dirEnt->d_name;
+#ifdef DT_UNKNOWN
+        entry.flags = entryFlags(path, dirEnt->d_name, dirEnt->d_type);
+#else
+        entry.flags = entryFlags(path, dirEnt->d_name, 0);
+#endif
+        entries.append(entry);
+    }
+    QT_CLOSEDIR(dir);
+
+    std::sort(entries.begin(), entries.end(), lessByName);
+    return entries;
+}
+
+uchar KrFileIndexBuilder::entryFlags(const QByteArray &dir, const char *name, uchar type)
+{
+#ifdef DT_UNKNOWN
+    if (type == DT_DIR)
+        return KrFileIndexData::IsDir;
+    if (type == DT_LNK)
+        return KrFileIndexData::IsLink;
+    if (type != DT_UNKNOWN)
+        return 0;
+#else
+    Q_UNUSED(type);
+#endif
+
+    // the file system does not report the type, stat is needed
+    QT_STATBUF stat_p;
+    if (QT_LSTAT(childPath(dir, name, qstrlen(name)).constData(), &stat_p) == 0) {
+        if (S_ISLNK(stat_p.st_mode))
+            return KrFileIndexData::IsLink;
+        if (S_ISDIR(stat_p.st_mode))
+            return KrFileIndexData::IsDir;
+    }
+    return 0;
+}
+
+void KrFileIndexBuilder::run()
+{
+    for (const QString &root : roots) {
+        const QByteArray rootPath = QFile::encodeName(root);
+
+        // missing folders are kept as empty roots, so that the index matches the settings
+        const quint32 id = data.append(rootPath.constData(), rootPath.length(), KrFileIndexData::IsDir,
+                                       KrFileIndexData::NoParent);
+
+        QT_STATBUF stat_p;
+        if (QT_STAT(rootPath.constData(), &stat_p) != 0 || !S_ISDIR(stat_p.st_mode))
+            continue;
+
+        scan(rootPath, id, stat_p.st_dev);
+        if (stopped)
+            return;
+    }
+    data.finalize();
+}
+
+void KrFileIndexBuilder::scan(const QByteArray &path, quint32 id, dev_t device)
+{
+    const QList<KrFileIndexEntry> entries = readDirectory(path);
+
+    for (const KrFileIndexEntry &entry : entries) {
+        if (stopped)
+            return;
+
+        const quint32 child = data.append(entry.name.constData(), entry.name.length(), entry.flags, id);
+        if (!(entry.flags & KrFileIndexData::IsDir))
+            continue;
+
+        // like updatedb, the other mounted file systems are not indexed
+        const QByteArray subDir = childPath(path, entry.name.constData(), entry.name.length());
+        QT_STATBUF stat_p;
+        if (QT_LSTAT(subDir.constData(), &stat_p) != 0 || stat_p.st_dev != device)
+            continue;
+
+        scan(subDir, child, device);
+    }
+}
+
+// ------------------------------- KrFileIndex -------------------------------
+
+KrFileIndex::KrFileIndex() : QObject(), loaded(false), modified(false), journalLoaded(false), builder(0)
+{
+    roots = configuredRoots();
+    indexExists = QFile::exists(indexFileName());
+}
+
+KrFileIndex::~KrFileIndex()
+{
+    if (builder) {
+        builder->stop();
+        builder->wait();
+        delete builder;
+    }
+
+    if (modified)
+        save();
+    // the listings are merged by the next session which queries the index
+    if (!loaded)
+        loadJournal();
+    saveJournal();
+}
+
+KrFileIndex *KrFileIndex::instance()
+{
+    if (!self)
+        self = new KrFileIndex();
+    return self;
+}
+
+void KrFileIndex::shutdown()
+{
+    delete self;
+    self = 0;
+}
+
+bool KrFileIndex::isEnabled()
+{
+    if (enabled < 0) {
+        KConfigGroup group(krConfig, "Locate");
+        enabled = group.readEntry("Use Index", _LocateUseIndex);
+    }
+    return enabled;
+}
+
+void KrFileIndex::reloadConfig()
+{
+    enabled = -1;
+}
+
+QString KrFileIndex::indexFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') + INDEX_FILE;
+}
+
+QString KrFileIndex::journalFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') + JOURNAL_FILE;
+}
+
+QStringList KrFileIndex::configuredRoots()
+{
+    KConfigGroup group(krConfig, "Locate");
+    QStringList result = group.readEntry("Index Folders", QStringList() << QDir::homePath());
+    for (int i = 0; i < result.count(); ++i)
+        result[i] = QDir::cleanPath(result[i]);
+    return result;
+}
+
+bool KrFileIndex::isEmpty()
+{
+    if (!loaded)
+        load();
+    return data.count() == 0;
+}
+
+bool KrFileIndex::covers(const QString &path) const
+{
+    const QString cleanPath = QDir::cleanPath(path);
+    for (const QString &root : roots) {
+        if (cleanPath == root || cleanPath.startsWith(root.endsWith('/') ? root : root + '/'))
+            return true;
+    }
+    return false;
+}
+
+void KrFileIndex::rebuild()
+{
+    if (builder)
+        return;
+
+    roots = configuredRoots();
+    builder = new KrFileIndexBuilder(roots);
+    connect(builder, &QThread::finished, this, &KrFileIndex::slotBuilderFinished);
+    builder->start(QThread::LowPriority);
+}
+
+void KrFileIndex::slotBuilderFinished()
+{
+    data = builder->result();
+    builder->deleteLater();
+    builder = 0;
+
+    // the scan is newer than the listings collected so far
+    pending.clear();
+    QFile::remove(journalFileName());
+    journalLoaded = true;
+    loaded = true;
+
+    save();
+    modified = false;
+
+    emit rebuildFinished();
+}
+
+void KrFileIndex::updateDirectory(const QString &dir, const QList<KrFileIndexEntry> &entries)
+{
+    if (!wantsListing(dir))
+        return;
+
+    QList<KrFileIndexEntry> sorted = entries;
+    std::sort(sorted.begin(), sorted.end(), lessByName);
+    const QByteArray path = QFile::encodeName(QDir::cleanPath(dir));
+
+    // most refreshes do not change anything, they need not be merged
+    if (loaded && !pending.contains(path)) {
+        const quint32 id = data.find(path);
+        if (id != KrFileIndexData::NoParent && (data.flags[id] & KrFileIndexData::IsDir) && data.sameChildren(id, sorted))
+            return;
+    }
+
+    pending.insert(path, sorted);
+}
+
+void KrFileIndex::applyPendingUpdates()
+{
+    if (!loaded)
+        load();
+    if (pending.isEmpty())
+        return;
+
+    if (pending.count() <= MAX_REPLACED_DIRS) {
+        // parents first, so that the subfolders they list are found
+        QList<QByteArray> dirs = pending.keys();
+        std::sort(dirs.begin(), dirs.end(), lessByLength);
+        for (const QByteArray &dir : dirs) {
+            const quint32 id = data.find(dir);
+            if (id != KrFileIndexData::NoParent && (data.flags[id] & KrFileIndexData::IsDir))
+                data.replaceChildren(id, pending.value(dir));
+        }
+        pending.clear();
+        modified = true;
+        return;
+    }
+
+    const KrFileIndexData old = data;
+    KrFileIndexData merged;
+    for (quint32 root = 0; root < (quint32)old.count(); root = old.subtreeEnds[root]) {
+        merge(old, root, old.name(root), old.nameLength(root), old.flags[root], KrFileIndexData::NoParent,
+              QByteArray(old.name(root), old.nameLength(root)), merged);
+    }
+    merged.finalize();
+
+    data = merged;
+    pending.clear();
+    modified = true;
+}
+
+void KrFileIndex::merge(const KrFileIndexData &old, quint32 oldId, const char *name, int len, uchar flags,
+                        quint32 parent, const QByteArray &path, KrFileIndexData &out)
+{
+    const quint32 id = out.append(name, len, flags, parent);
+    if (!(flags & KrFileIndexData::IsDir))
+        return;
+
+    QHash<QByteArray, QList<KrFileIndexEntry> >::const_iterator it = pending.constFind(path);
+    if (it == pending.constEnd()) {
+        // unchanged directory: copy the children of the old index
+        if (oldId == KrFileIndexData::NoParent)
+            return;
+        for (quint32 child = oldId + 1; child < old.subtreeEnds[oldId]; child = old.subtreeEnds[child]) {
+            const uchar childFlags = old.flags[child];
+            merge(old, child, old.name(child), old.nameLength(child), childFlags, id,
+                  (childFlags & KrFileIndexData::IsDir) ? childPath(path, old.name(child), old.nameLength(child)) : QByteArray(),
+                  out);
+        }
+        return;
+    }
+
+    // changed directory: both lists are sorted by name, join them to find the old subtrees
+    quint32 oldChild = (oldId == KrFileIndexData::NoParent) ? 0 : oldId + 1;
+    const quint32 oldEnd = (oldId == KrFileIndexData::NoParent) ? 0 : old.subtreeEnds[oldId];
+    for (const KrFileIndexEntry &entry : it.value()) {
+        while (oldChild < oldEnd && qstrcmp(old.name(oldChild), entry.name.constData()) < 0)
+            oldChild = old.subtreeEnds[oldChild];
+
+        quint32 match = KrFileIndexData::NoParent;
+        if (oldChild < oldEnd && qstrcmp(old.name(oldChild), entry.name.constData()) == 0 &&
+                (old.flags[oldChild] & KrFileIndexData::IsDir))
+            match = oldChild;
+
+        merge(old, match, entry.name.constData(), entry.name.length(), entry.flags, id,
+              (entry.flags & KrFileIndexData::IsDir) ? childPath(path, entry.name.constData(), entry.name.length()) : QByteArray(),
+              out);
+    }
+}
+
+QStringList KrFileIndex::locate(const QString &pattern, bool caseSensitive, bool nameOnly)
+{
+    applyPendingUpdates();
+
+    QStringList result;
+    const KrFileIndexData index = data;
+    const int cnt = index.count();
+    if (cnt == 0 || pattern.isEmpty())
+        return result;
+
+    const bool wildcard = pattern.contains(QRegExp("[*?\\[]"));
+
+    // the longest literal part of the pattern is searched in the names first
+    QString literal;
+    const QStringList parts = pattern.split(QRegExp(wildcard ? "[*?\\[\\]/]" : "/"), QString::SkipEmptyParts);
+    for (const QString &part : parts)
+        if (part.length() > literal.length())
+            literal = part;
+
+    QByteArray marks(cnt, 1);
+    bool asciiOnly = true;
+    for (const QChar &ch : literal)
+        if (ch.unicode() >= 0x80)
+            asciiOnly = false;
+
+    if (!literal.isEmpty() && (caseSensitive || asciiOnly)) {
+        marks.fill(0);
+        const QByteArray needle = caseSensitive ? QFile::encodeName(literal) : QFile::encodeName(literal.toLower());
+        const QByteArray &haystack = caseSensitive ? index.names : index.foldedNames;
+        QByteArrayMatcher matcher(needle);
+
+        int pos = 0;
+        while ((pos = matcher.indexIn(haystack, pos)) != -1) {
+            const int id = std::upper_bound(index.nameOffsets.constBegin(), index.nameOffsets.constEnd(), (quint32)pos)
+                           - index.nameOffsets.constBegin() - 1;
+            marks[id] = 1;
+            pos = index.nameOffsets[id + 1];
+        }
+
+        // without nameOnly the literal may be in any folder name of the path
+        if (!nameOnly) {
+            for (int i = 0; i < cnt; ++i)
+                if (!marks[i] && index.parents[i] != KrFileIndexData::NoParent && marks[index.parents[i]])
+                    marks[i] = 1;
+        }
+    }
+
+    const Qt::CaseSensitivity cs = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QRegExp regExp(pattern, cs, QRegExp::Wildcard);
+
+    for (int i = 0; i < cnt; ++i) {
+        if (!marks[i])
+            continue;
+
+        const QString path = QFile::decodeName(index.path(i));
+        const QString subject = nameOnly ? path.mid(path.lastIndexOf('/') + 1) : path;
+        if (wildcard ? regExp.exactMatch(subject) : subject.contains(pattern, cs))
+            result.append(path);
+    }
+    return result;
+}
+
+bool KrFileIndex::walk(const QString &dir, const Visitor &visitor)
+{
+    applyPendingUpdates();
+
+    // the visitor may process events, which can update the index: work on a copy
+    const KrFileIndexData index = data;
+    const quint32 top = index.find(QFile::encodeName(QDir::cleanPath(dir)));
+    if (top == KrFileIndexData::NoParent || !(index.flags[top] & KrFileIndexData::IsDir))
+        return false;
+
+    QVector<quint32> ends;
+    QStringList dirs;
+    ends.append(index.subtreeEnds[top]);
+    dirs.append(QFile::decodeName(index.path(top)));
+    if (!dirs.last().endsWith('/'))
+        dirs.last() += '/';
+
+    quint32 id = top + 1;
+    while (id < index.subtreeEnds[top]) {
+        while (id >= ends.last()) {
+            ends.removeLast();
+            dirs.removeLast();
+        }
+
+        const QString name = QFile::decodeName(QByteArray::fromRawData(index.name(id), index.nameLength(id)));
+        const uchar flags = index.flags[id];
+        const WalkAction action = visitor(dirs.last(), name, flags);
+        if (action == Stop)
+            break;
+
+        if ((flags & KrFileIndexData::IsDir) && index.subtreeEnds[id] > id + 1) {
+            if (action == SkipSubtree) {
+                id = index.subtreeEnds[id];
+                continue;
+            }
+            ends.append(index.subtreeEnds[id]);
+            dirs.append(dirs.last() + name + '/');
+        }
+        ++id;
+    }
+    return true;
+}
+
+void KrFileIndex::load()
+{
+    loaded = true;
+    data.clear();
+
+    QFile file(indexFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const QByteArray content = file.readAll();
+
+    const uchar *pos = reinterpret_cast<const uchar *>(content.constData());
+    const uchar *end = pos + content.size();
+    quint32 version, count;
+    if (!content.startsWith(INDEX_MAGIC))
+        return;
+    pos += qstrlen(INDEX_MAGIC);
+    if (!readNumber(pos, end, version) || version != INDEX_VERSION || !readNumber(pos, end, count))
+        return;
+
+    QStringList indexedRoots;
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 parentDistance, length;
+        if (!readNumber(pos, end, parentDistance) || pos >= end)
+            break;
+        const uchar flags = *pos++;
+        if (!readNumber(pos, end, length) || length > (quint32)(end - pos) || parentDistance > i)
+            break;
+
+        const quint32 parent = parentDistance ? i - parentDistance : KrFileIndexData::NoParent;
+        data.append(reinterpret_cast<const char *>(pos), length, flags, parent);
+        if (parent == KrFileIndexData::NoParent)
+            indexedRoots.append(QFile::decodeName(QByteArray(reinterpret_cast<const char *>(pos), length)));
+        pos += length;
+    }
+
+    // a damaged file or changed folder settings invalidate the index
+    if ((quint32)data.count() != count || indexedRoots != roots) {
+        data.clear();
+        return;
+    }
+    data.finalize();
+    loadJournal();
+}
+
+void KrFileIndex::save()
+{
+    // the entries are written in pre-order: distance to the parent, flags and name
+    QByteArray content(INDEX_MAGIC);
+    content.reserve(data.names.size() + data.count() * 3 + 16);
+    writeNumber(content, INDEX_VERSION);
+    writeNumber(content, data.count());
+    for (int i = 0; i < data.count(); ++i) {
+        const quint32 parent = data.parents[i];
+        writeNumber(content, parent == KrFileIndexData::NoParent ? 0 : i - parent);
+        content.append(data.flags[i]);
+        writeNumber(content, data.nameLength(i));
+        content.append(data.name(i), data.nameLength(i));
+    }
+
+    QDir().mkpath(QFileInfo(indexFileName()).absolutePath());
+    QSaveFile file(indexFileName());
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(content);
+        if (file.commit()) {
+            modified = false;
+            indexExists = true;
+        }
+    }
+}
+
+void KrFileIndex::loadJournal()
+{
+    if (journalLoaded)
+        return;
+    journalLoaded = true;
+
+    QFile file(journalFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if (magic != JOURNAL_MAGIC || version != INDEX_VERSION)
+        return;
+
+    for (quint32 i = 0; i != count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray dir;
+        quint32 entryCount;
+        stream >> dir >> entryCount;
+        QList<KrFileIndexEntry> entries;
+        for (quint32 j = 0; j != entryCount && stream.status() == QDataStream::Ok; ++j) {
+            KrFileIndexEntry entry;
+            quint8 flags;
+            stream >> entry.name >> flags;
+            entry.flags = flags;
+            entries.append(entry);
+        }
+        // the listings of this session are newer
+        if (stream.status() == QDataStream::Ok && !pending.contains(dir))
+            pending.insert(dir, entries);
+    }
+}
+
+void KrFileIndex::saveJournal()
+{
+    if (pending.isEmpty()) {
+        QFile::remove(journalFileName());
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(journalFileName()).absolutePath());
+    QSaveFile file(journalFileName());
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << (quint32)JOURNAL_MAGIC << (quint32)INDEX_VERSION << (quint32)pending.count();
+    for (QHash<QByteArray, QList<KrFileIndexEntry> >::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        stream << it.key() << (quint32)it->count();
+        for (const KrFileIndexEntry &entry : it.value())
+            stream << entry.name << (quint8)entry.flags;
+    }
+    file.commit();
+}
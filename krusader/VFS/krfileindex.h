@@ -0,0 +1,219 @@
+/*****************************************************************************
+ * Copyright (C) 2016 Krusader Krew                                          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This package is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this package; if not, write to the Free Software               *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA *
+ *****************************************************************************/
+
+#ifndef KRFILEINDEX_H
+#define KRFILEINDEX_H
+
+#include <sys/types.h>
+
+#include <functional>
+
+// QtCore
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+
+struct KrFileIndexEntry;
+
+/**
+ * The indexed file names, stored as a tree in pre-order.
+ *
+ * Every entry knows its parent and the end of its subtree, so the entries of a directory
+ * are always the contiguous range [id + 1, subtreeEnd[id]). Root entries have no parent and
+ * carry the full path of the indexed folder as name. The children of a directory are
+ * sorted by name, so the pre-order equals the sorted order of the full paths.
+ */
+class KrFileIndexData
+{
+public:
+    enum Flags { IsDir = 1, IsLink = 2 };
+    static const quint32 NoParent = 0xFFFFFFFF;
+
+    KrFileIndexData() {}
+
+    int count() const {
+        return parents.count();
+    }
+    const char *name(quint32 id) const {
+        return names.constData() + nameOffsets[id];
+    }
+    int nameLength(quint32 id) const {
+        return nameOffsets[id + 1] - nameOffsets[id] - 1;
+    }
+
+    quint32 append(const char *name, int len, uchar flags, quint32 parent);
+    /// computes the subtree ends and the case folded names after all entries were appended
+    void finalize();
+    void clear();
+    /// replaces the children of the directory, keeping the subtrees of the subfolders still listed
+    void replaceChildren(quint32 dir, const QList<KrFileIndexEntry> &entries);
+    /// true if the sorted entries equal the indexed children of the directory
+    bool sameChildren(quint32 dir, const QList<KrFileIndexEntry> &entries) const;
+
+    QByteArray path(quint32 id) const;
+    /// returns the entry of the given path or NoParent if it is not indexed
+    quint32 find(const QByteArray &path) const;
+    /// returns the child of the directory with the given name or NoParent
+    quint32 findChild(quint32 dir, const char *name, int len) const;
+
+    QByteArray       names;        // '\0' terminated names in pre-order
+    QByteArray       foldedNames;  // the same with ASCII letters in lower case
+    QVector<quint32> nameOffsets;  // count() + 1 offsets into names
+    QVector<quint32> parents;
+    QVector<quint32> subtreeEnds;
+    QByteArray       flags;
+};
+
+/**
+ * A directory entry fed into the index by the scanners.
+ */
+struct KrFileIndexEntry
+{
+    QByteArray name;
+    uchar flags;
+};
+
+class KrFileIndexBuilder;
+
+/**
+ * @brief Krusader's own persistent file name index
+ *
+ * Replaces the external locate database for the folders configured in the [Locate] group
+ * ("Index Folders", the home folder by default). The index is built by a background thread,
+ * stored in a compact file in the Krusader data folder and updated incrementally with the
+ * directory listings done by the local file system panels (refreshed by KDirWatch) and by
+ * the searcher.
+ *
+ * All methods must be called from the GUI thread.
+ */
+class KrFileIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum WalkAction { Continue, SkipSubtree, Stop };
+    /// visitor for walk(): directory path, file name and KrFileIndexData::Flags of the entry
+    typedef std::function<WalkAction(const QString &, const QString &, uchar)> Visitor;
+
+    static KrFileIndex *instance();
+    /// saves the pending changes and stops the builder thread, called on exit
+    static void shutdown();
+
+    /// true if the index is switched on in the configuration
+    static bool isEnabled();
+    /// reads the switch of the index again after the configuration changed
+    static void reloadConfig();
+
+    bool isBuilding() const {
+        return builder != 0;
+    }
+    bool isEmpty();
+    /// true if the path is inside one of the indexed folders
+    bool covers(const QString &path) const;
+    /// true if the listings of the path are worth feeding: it is covered and the index was built
+    bool wantsListing(const QString &path) const {
+        return indexExists && covers(path);
+    }
+
+    /// starts a full rebuild in the background, rebuildFinished() is emitted when done
+    void rebuild();
+
+    /// replaces the indexed content of a directory, merged when the index is queried next time
+    void updateDirectory(const QString &dir, const QList<KrFileIndexEntry> &entries);
+
+    /**
+     * Locate compatible query. Patterns without wildcards are searched as substrings,
+     * patterns with wildcards must match the whole path. With nameOnly only the file name
+     * is checked instead of the full path.
+     */
+    QStringList locate(const QString &pattern, bool caseSensitive, bool nameOnly);
+
+    /// visits the indexed entries below the directory in pre-order; false if it is not indexed
+    bool walk(const QString &dir, const Visitor &visitor);
+
+signals:
+    void rebuildFinished();
+
+private slots:
+    void slotBuilderFinished();
+
+private:
+    KrFileIndex();
+    ~KrFileIndex();
+
+    void load();
+    void save();
+    /// the listings not merged yet are kept in a journal, so exiting needn't load the index
+    void loadJournal();
+    void saveJournal();
+    void applyPendingUpdates();
+    void merge(const KrFileIndexData &old, quint32 oldId, const char *name, int len, uchar flags,
+               quint32 parent, const QByteArray &path, KrFileIndexData &out);
+
+    static QString indexFileName();
+    static QString journalFileName();
+    static QStringList configuredRoots();
+
+    KrFileIndexData                             data;
+    QStringList                                 roots;
+    QHash<QByteArray, QList<KrFileIndexEntry> > pending;  // directory listings not merged yet
+    bool                                        loaded;
+    bool                                        modified;     // the merged index is not saved yet
+    bool                                        journalLoaded;
+    bool                                        indexExists;
+    KrFileIndexBuilder                         *builder;
+
+    static KrFileIndex                         *self;
+    static int                                  enabled;      // -1 until the configuration is read
+};
+
+/**
+ * Scans the indexed folders in a separate thread.
+ */
+class KrFileIndexBuilder : public QThread
+{
+public:
+    explicit KrFileIndexBuilder(const QStringList &roots) : roots(roots) {}
+
+    void stop() {
+        stopped = 1;
+    }
+    KrFileIndexData &result() {
+        return data;
+    }
+
+    static QList<KrFileIndexEntry> readDirectory(const QByteArray &path);
+    /// the KrFileIndexData::Flags of a directory entry, type is its d_type or 0 if unknown
+    static uchar entryFlags(const QByteArray &dir, const char *name, uchar type);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void scan(const QByteArray &path, quint32 id, dev_t device);
+
+    const QStringList roots;
+    KrFileIndexData   data;
+    QAtomicInt        stopped;
+};
+
+#endif /* KRFILEINDEX_H */
@@ -319,15 +319,24 @@ time_t KRpermHandler::QString2time(QString date)
 }
 
 gid_t KRpermHandler::group2gid(QString group)
+{
+    return group2gid(group, getgid());
+}
+uid_t KRpermHandler::user2uid(QString user)
+{
+    return user2uid(user, getuid());
+}
+
+gid_t KRpermHandler::group2gid(QString group, gid_t unknown)
 {
     if (groupCache->find(group) == groupCache->end())
-        return getgid();
+        return unknown;
     return (*groupCache)[ group ];
 }
-uid_t KRpermHandler::user2uid(QString user)
+uid_t KRpermHandler::user2uid(QString user, uid_t unknown)
 {
     if (passwdCache->find(user) == passwdCache->end())
-        return getuid();
+        return unknown;
     return (*passwdCache)[ user ];
 }
 
@@ -54,6 +54,9 @@ public:
 
     static gid_t group2gid(QString group);
     static uid_t user2uid(QString user);
+    // unknown names give the fallback id, the ones above use the id of the current user
+    static gid_t group2gid(QString group, gid_t unknown);
+    static uid_t user2uid(QString user, uid_t unknown);
 
     static QString gid2group(gid_t groupId);
     static QString uid2user(uid_t userId);
@@ -55,7 +55,7 @@ KRQuery::KRQuery(): QObject(), matchesCaseSensitive(true), bNull(true),
         minSize(0), maxSize(0), newerThen(0), olderThen(0),
         owner(QString()), group(QString()), perm(QString()),
         type(QString()), inArchive(false), recurse(true),
-        followLinksP(true), receivedBuffer(0), receivedBufferLen(0), processEventsConnected(0),
+        followLinksP(true), typeCategory(TypeExact), receivedBuffer(0), receivedBufferLen(0), processEventsConnected(0),
         codec(QTextCodec::codecForLocale())
 {
     QChar ch = '\n';
@@ -72,7 +72,7 @@ KRQuery::KRQuery(const QString &name, bool matchCase) : QObject(),
         minSize(0), maxSize(0), newerThen(0), olderThen(0),
         owner(QString()), group(QString()), perm(QString()),
         type(QString()), inArchive(false), recurse(true),
-        followLinksP(true), receivedBuffer(0), receivedBufferLen(0), processEventsConnected(0),
+        followLinksP(true), typeCategory(TypeExact), receivedBuffer(0), receivedBufferLen(0), processEventsConnected(0),
         codec(QTextCodec::codecForLocale())
 {
     QChar ch = '\n';
@@ -123,6 +123,12 @@ KRQuery& KRQuery::operator=(const KRQuery & old)
     whereToSearch = old.whereToSearch;
     whereNotToSearch = old.whereNotToSearch;
     origFilter = old.origFilter;
+    matchesRx = old.matchesRx;
+    excludesRx = old.excludesRx;
+    includedDirsRx = old.includedDirsRx;
+    excludedDirsRx = old.excludedDirsRx;
+    containRx = old.containRx;
+    typeCategory = old.typeCategory;
 
     codec = old.codec;
 
@@ -176,6 +182,8 @@ void KRQuery::load(KConfigGroup cfg)
     encodedEnterLen = encodedEnterArray.size();
 #undef LOAD
 
+    compilePatterns();
+
     bNull = false;
 }
 
@@ -230,37 +238,39 @@ void KRQuery::disconnectNotify(const QMetaMethod &signal)
         processEventsConnected--;
 }
 
-bool KRQuery::checkPerm(QString filePerm) const
+bool KRQuery::checkPerm(const QString &filePerm) const
 {
     for (int i = 0; i < 9; ++i)
         if (perm[ i ] != '?' && perm[ i ] != filePerm[ i + 1 ]) return false;
     return true;
 }
 
-bool KRQuery::checkType(QString mime) const
+bool KRQuery::checkType(const QString &mime) const
 {
     if (type == mime) return true;
-    if (type == i18n("Archives")) return KRarcHandler::arcSupported(mime);
-    if (type == i18n("Folders")) return mime.contains("directory");
-    if (type == i18n("Image Files")) return mime.contains("image/");
-    if (type == i18n("Text Files")) return mime.contains("text/");
-    if (type == i18n("Video Files")) return mime.contains("video/");
-    if (type == i18n("Audio Files")) return mime.contains("audio/");
-    if (type == i18n("Custom")) return customType.contains(mime);
-    return false;
+    switch (typeCategory) {
+    case TypeArchives: return KRarcHandler::arcSupported(mime);
+    case TypeFolders: return mime.contains("directory");
+    case TypeImages: return mime.contains("image/");
+    case TypeText: return mime.contains("text/");
+    case TypeVideo: return mime.contains("video/");
+    case TypeAudio: return mime.contains("audio/");
+    case TypeCustom: return customType.contains(mime);
+    default: return false;
+    }
 }
 
 bool KRQuery::match(const QString & name) const
 {
-    return matchCommon(name, matches, excludes);
+    return matchCommon(name, matchesRx, excludesRx);
 }
 
 bool KRQuery::matchDirName(const QString & name) const
 {
-    return matchCommon(name, includedDirs, excludedDirs);
+    return matchCommon(name, includedDirsRx, excludedDirsRx);
 }
 
-bool KRQuery::matchCommon(const QString &nameIn, const QStringList &matchList, const QStringList &excludeList) const
+bool KRQuery::matchCommon(const QString &nameIn, const QList<QRegExp> &matchList, const QList<QRegExp> &excludeList) const
 {
     if (excludeList.count() == 0 && matchList.count() == 0)  /* true if there's no match condition */
         return true;
@@ -271,7 +281,7 @@ bool KRQuery::matchCommon(const QString &nameIn, const QStringList &matchList, c
         name = nameIn.mid(ndx + 1);
 
     for (int i = 0; i < excludeList.count(); ++i) {
-        if (QRegExp(excludeList[ i ], matchesCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard).exactMatch(name))
+        if (excludeList[ i ].exactMatch(name))
             return false;
     }
 
@@ -279,33 +289,60 @@ bool KRQuery::matchCommon(const QString &nameIn, const QStringList &matchList, c
         return true;
 
     for (int i = 0; i < matchList.count(); ++i) {
-        if (QRegExp(matchList[ i ], matchesCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard).exactMatch(name))
+        if (matchList[ i ].exactMatch(name))
             return true;
     }
     return false;
 }
 
+QList<QRegExp> KRQuery::compileWildcards(const QStringList &patterns) const
+{
+    QList<QRegExp> compiled;
+    for (int i = 0; i < patterns.count(); ++i)
+        compiled.append(QRegExp(patterns[ i ], matchesCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::Wildcard));
+    return compiled;
+}
+
+void KRQuery::compilePatterns()
+{
+    matchesRx = compileWildcards(matches);
+    excludesRx = compileWildcards(excludes);
+    includedDirsRx = compileWildcards(includedDirs);
+    excludedDirsRx = compileWildcards(excludedDirs);
+
+    if (containRegExp)
+        containRx = QRegExp(contain, containCaseSensetive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::RegExp);
+    else
+        containRx = QRegExp();
+
+    if (type == i18n("Archives")) typeCategory = TypeArchives;
+    else if (type == i18n("Folders")) typeCategory = TypeFolders;
+    else if (type == i18n("Image Files")) typeCategory = TypeImages;
+    else if (type == i18n("Text Files")) typeCategory = TypeText;
+    else if (type == i18n("Video Files")) typeCategory = TypeVideo;
+    else if (type == i18n("Audio Files")) typeCategory = TypeAudio;
+    else if (type == i18n("Custom")) typeCategory = TypeCustom;
+    else typeCategory = TypeExact;
+}
+
 bool KRQuery::match(vfile *vf) const
 {
-    if (vf->vfile_isDir() && !matchDirName(vf->vfile_getName())) return false;
-    // see if the name matches
-    if (!match(vf->vfile_getName())) return false;
-    // checking the mime
-    if (!type.isEmpty() && !checkType(vf->vfile_getMime())) return false;
-    // check that the size fit
-    KIO::filesize_t size = vf->vfile_getSize();
-    if (minSize && size < minSize) return false;
-    if (maxSize && size > maxSize) return false;
-    // check the time frame
-    time_t mtime = vf->vfile_getTime_t();
-    if (olderThen && mtime > olderThen) return false;
-    if (newerThen && mtime < newerThen) return false;
+    // the conditions are evaluated from the cheapest to the most expensive one:
+    // stat data and the precompiled name matchers first, then the permissions, the
+    // owner/group lookups, the mime detection and finally the content search
+    if (!matchStat(vf->vfile_getName(), vf->vfile_isDir(), vf->vfile_getSize(), vf->vfile_getTime_t()))
+        return false;
+
+    //check permission
+    if (!perm.isEmpty() && !checkPerm(vf->vfile_getPerm())) return false;
+
     // check owner name
     if (!owner.isEmpty() && vf->vfile_getOwner() != owner) return false;
     // check group name
     if (!group.isEmpty() && vf->vfile_getGroup() != group) return false;
-    //check permission
-    if (!perm.isEmpty() && !checkPerm(vf->vfile_getPerm())) return false;
+
+    // checking the mime
+    if (!type.isEmpty() && !checkType(vf->vfile_getMime())) return false;
 
     if (!contain.isEmpty()) {
         if ((totalBytes = vf->vfile_getSize()) == 0)
@@ -333,6 +370,20 @@ bool KRQuery::match(vfile *vf) const
     return true;
 }
 
+bool KRQuery::matchStat(const QString &name, bool isDir, KIO::filesize_t size, time_t mtime) const
+{
+    // check that the size fit
+    if (minSize && size < minSize) return false;
+    if (maxSize && size > maxSize) return false;
+    // check the time frame
+    if (olderThen && mtime > olderThen) return false;
+    if (newerThen && mtime < newerThen) return false;
+
+    if (isDir && !matchDirName(name)) return false;
+    // see if the name matches
+    return match(name);
+}
+
 bool KRQuery::match(KFileItem *kfi) const
 {
     mode_t mode = kfi->mode() | kfi->permissions();
@@ -419,7 +470,7 @@ bool KRQuery::checkBuffer(const char * data, int len) const
 bool KRQuery::checkLine(const QString & line, bool backwards) const
 {
     if (containRegExp) {
-        QRegExp rexp(contain, containCaseSensetive ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::RegExp);
+        const QRegExp &rexp = containRx;
         int ndx = backwards ? rexp.lastIndexIn(line) : rexp.indexIn(line);
         bool result = ndx >= 0;
         if (result)
@@ -646,6 +697,8 @@ void KRQuery::setNameFilter(const QString &text, bool cs)
 
         i++;
     }
+
+    compilePatterns();
 }
 
 void KRQuery::setContent(const QString &content, bool cs, bool wholeWord, QString encoding, bool regExp)
@@ -656,6 +709,8 @@ void KRQuery::setContent(const QString &content, bool cs, bool wholeWord, QStrin
     containWholeWord = wholeWord;
     containRegExp = regExp;
 
+    compilePatterns();
+
     if (encoding.isEmpty())
         codec = QTextCodec::codecForLocale();
     else {
@@ -718,6 +773,8 @@ void KRQuery::setMimeType(const QString &typeIn, QStringList customList)
     bNull = false;
     type = typeIn;
     customType = customList;
+
+    compilePatterns();
 }
 
 bool KRQuery::isExcluded(const QUrl &url)
@@ -34,6 +34,7 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QUrl>
+#include <QRegExp>
 
 #include <KIO/Job>
 #include <KConfigCore/KConfigGroup>
@@ -77,6 +78,12 @@ public:
     bool match(const QString &name) const;  // matching the filename only
     // matching the name of the directory
     bool matchDirName(const QString &name) const;
+    // matching the name, the size and the date only, for listings without vfile objects
+    bool matchStat(const QString &name, bool isDir, KIO::filesize_t size, time_t mtime) const;
+    // true if the query has conditions which can be checked on a vfile object only
+    bool needsFileDetails() const {
+        return !perm.isEmpty() || !owner.isEmpty() || !group.isEmpty() || !type.isEmpty() || !contain.isEmpty();
+    }
 
     // sets the text for name filtering
     void setNameFilter(const QString &text, bool cs = true);
@@ -230,9 +237,12 @@ signals:
     void processEvents(bool & stopped);
 
 private:
-    bool matchCommon(const QString &, const QStringList &, const QStringList &) const;
-    bool checkPerm(QString perm) const;
-    bool checkType(QString mime) const;
+    bool matchCommon(const QString &, const QList<QRegExp> &, const QList<QRegExp> &) const;
+    // builds the precompiled matchers from the pattern lists, must be called whenever they change
+    void compilePatterns();
+    QList<QRegExp> compileWildcards(const QStringList &) const;
+    bool checkPerm(const QString &perm) const;
+    bool checkType(const QString &mime) const;
     bool containsContent(QString file) const;
     bool containsContent(QUrl url) const;
     bool checkBuffer(const char * data, int len) const;
@@ -245,6 +255,15 @@ private slots:
 
 private:
     QString                  origFilter;
+    // precompiled counterparts of matches, excludes, includedDirs, excludedDirs and contain
+    QList<QRegExp>           matchesRx;
+    QList<QRegExp>           excludesRx;
+    QList<QRegExp>           includedDirsRx;
+    QList<QRegExp>           excludedDirsRx;
+    QRegExp                  containRx;
+    // the mime type category resolved from 'type', so that no i18n lookup happens per file
+    enum TypeCategory { TypeExact, TypeArchives, TypeFolders, TypeImages, TypeText, TypeVideo, TypeAudio, TypeCustom };
+    TypeCategory             typeCategory;
     mutable bool             busy;
     mutable bool             containsContentResult;
     mutable char *           receivedBuffer;
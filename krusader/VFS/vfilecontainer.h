@@ -47,6 +47,8 @@ signals:
     void cleared();
 
     void addedVfile(vfile *vf);
+    /// Emitted when many vfiles were added at once, the view appends them without sorting.
+    void addedVfiles(const QList<vfile *> &vfiles);
     void updatedVfile(vfile *vf);
 };
 
@@ -250,6 +250,17 @@
 // holds an index of saved searches
 // Confirm Feed to Listbox ///// (costum-name on feed ti listbox)
 #define _ConfirmFeedToListbox   true
+// Use the file index for the indexed local folders /////
+#define _SearchUseIndex         false
+// Archive Listers ///// (archives listed at the same time when searching in archives)
+#define _SearchArchiveListers   4
+
+/////////////////////// [Locate]
+// Use Krusader's file index instead of the locate command /////
+#define _LocateUseIndex         true
+// Index Folders ///// the folders in the file index, the home folder by default
+// Max Results ///// the result list stops locate at this number of results, 0 for no limit
+#define _LocateMaxResults       100000
 
 
 /////////// here are additional variables used internally by Krusader ////////////
@@ -267,6 +278,10 @@
 /////////////////////// [Synchronize directories]
 // Don't overwrite automatically /////////////
 #define  _ConfirmOverWrites   false
+// Update the changed local files in place, writing only the changed blocks /////////////
+#define  _DeltaCopy          false
+// The minimum file size for the in place update in MiB /////////////
+#define  _DeltaCopyMinSize   64
 // Recursive search in the subdirectories /////////////
 #define  _RecurseSubdirs    true
 // The searcher follows symlinks /////////////
@@ -295,6 +310,8 @@
 #define  _BtnDuplicates     true
 // The singles button is turned on /////////////
 #define  _BtnSingles        true
+// The maximum number of copy jobs to the same host /////////////
+#define  _TransfersPerHost  4
 
 /////////////////////// [Custom Selection Mode]
 // QT Selection
@@ -75,6 +75,7 @@
 #include "GUI/syncbrowsebutton.h"
 #include "GUI/mediabutton.h"
 #include "GUI/dirhistorybutton.h"
+#include "VFS/krfileindex.h"
 #include "VFS/krquery.h"
 #include "Search/krsearchmod.h"
 #include "Search/krsearchdialog.h"
@@ -318,6 +319,7 @@ void KRslots::runKonfigurator(bool firstTime)
 void KRslots::configChanged(bool isGUIRestartNeeded)
 {
     krConfig->sync();
+    KrFileIndex::reloadConfig();
 
     if (isGUIRestartNeeded) {
         krApp->setUpdatesEnabled(false);
@@ -388,7 +390,7 @@ void KRslots::search()
 
 void KRslots::locate()
 {
-    if (!KrServices::cmdExist("locate")) {
+    if (!KrFileIndex::isEnabled() && !KrServices::cmdExist("locate")) {
         KMessageBox::error(krApp, i18n("Cannot find the 'locate' command. Please install the "
                                        "findutils-locate package of GNU, or set its dependencies in "
                                        "Konfigurator"));
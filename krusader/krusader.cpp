@@ -93,6 +93,7 @@ YP   YD 88   YD ~Y8888P' `8888Y' YP   YP Y8888D' Y88888P 88   YD
 #include "GUI/krusaderstatus.h"
 #include "VFS/vfile.h"
 #include "VFS/krpermhandler.h"
+#include "VFS/krfileindex.h"
 #include "MountMan/kmountman.h"
 #include "Konfigurator/kgprotocols.h"
 #include "BookMan/krbookmarkhandler.h"
@@ -322,6 +323,7 @@ Krusader::Krusader(const QCommandLineParser &parser) : KParts::MainWindow(0,
 Krusader::~Krusader()
 {
     KrTrashHandler::stopWatcher();
+    KrFileIndex::shutdown();
     if (!isExiting)    // save the settings if it was not saved (SIGTERM)
         saveSettings();
 
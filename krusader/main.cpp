@@ -56,6 +56,7 @@
 #include "../Archive/krarchandler.h"
 
 #include "krusader.h"
+#include "krglobal.h"
 #include "krusaderview.h"
 #include "panelmanager.h"
 #include "krusaderversion.h"
@@ -63,6 +64,11 @@
 #include "defaults.h"
 #include "Panel/krviewfactory.h"
 
+#ifdef SYNCHRONIZER_ENABLED
+#include "Synchronizer/synchronizerrunner.h"
+#include "VFS/krpermhandler.h"
+#endif
+
 static const char *description = I18N_NOOP("Krusader\nTwin-Panel File Manager for KDE");
 
 static void sigterm_handler(int i)
@@ -97,6 +103,20 @@ void openTabsRemote(QStringList tabs, bool left, QString appName)
 //! An object that manages archives in several parts of the source code.
 KRarcHandler arcHandler;
 
+#ifdef SYNCHRONIZER_ENABLED
+//! True if a synchronizer profile is run without windows, checked before the application exists.
+static bool isHeadlessSynchronize(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--") == 0)
+            break;
+        if (qstrcmp(argv[i], "--synchronize") == 0 || qstrncmp(argv[i], "--synchronize=", 14) == 0)
+            return true;
+    }
+    return false;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 // ============ begin icon-stuff ===========
@@ -135,6 +155,12 @@ int main(int argc, char *argv[])
     // prevent qt5-webengine crashing
     QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 
+#ifdef SYNCHRONIZER_ENABLED
+    // scheduled synchronizations run from cron or systemd timers, where no display is available
+    if (isHeadlessSynchronize(argc, argv) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+
     // create the application and set application domain so that calls to i18n get strings from right place.
     QApplication app(argc, argv);
     KLocalizedString::setApplicationDomain("krusader");
@@ -237,12 +263,25 @@ int main(int argc, char *argv[])
     parser.addOption(QCommandLineOption(QStringList() << QLatin1String("left"), i18n("Start left panel at <path>"), QLatin1String("path")));
     parser.addOption(QCommandLineOption(QStringList() << QLatin1String("right"), i18n("Start right panel at <path>"), QLatin1String("path")));
     parser.addOption(QCommandLineOption(QStringList() << QLatin1String("profile"), i18n("Load this profile on startup"), QLatin1String("panel-profile")));
+#ifdef SYNCHRONIZER_ENABLED
+    parser.addOption(QCommandLineOption(QStringList() << QLatin1String("synchronize"), i18n("Run this synchronizer profile without windows and exit"), QLatin1String("sync-profile")));
+#endif
     parser.addPositionalArgument(QLatin1String("url"), i18n("URL to open"));
 
     // check for command line arguments
     parser.process(app);
     aboutData.processCommandLine(&parser);
 
+#ifdef SYNCHRONIZER_ENABLED
+    if (parser.isSet("synchronize")) {
+        // a scheduled synchronization needs neither the main window nor a running instance
+        krConfig = KSharedConfig::openConfig().data();
+        KRpermHandler::init();
+        SynchronizerRunner runner(parser.value("synchronize"));
+        return runner.run();
+    }
+#endif
+
     KConfigGroup cfg(KSharedConfig::openConfig(), QStringLiteral("Look&Feel"));
     bool singleInstanceMode = cfg.readEntry("Single Instance Mode", _SingleInstanceMode);
 